@@ -0,0 +1,84 @@
+#!/usr/bin/env python
+
+# Measure how fast mpv can decode and output audio, reported as throughput of
+# the decoded PCM data. With a cheap codec and many channels at a high sample
+# rate, this is dominated by copying audio between the decoder, the filter
+# chain and the AO, so it's useful to check the memory bandwidth used by the
+# audio path.
+#
+# usage:
+#   TOOLS/audio_bench.py [--mpv ./mpv] [--runs N] [--af FILTERS] FILE
+#   TOOLS/audio_bench.py --generate [--channels 8] [--rate 192000] FILE
+#
+# --generate creates FILE first, using ffmpeg: 60 seconds of noise stored as
+# planar 32 bit PCM (use a .nut file name), which libavcodec decodes almost for
+# free. Audio is written to /dev/null with ao_pcm, which doesn't wait for
+# realtime playback.
+
+import subprocess
+import sys
+import time
+from optparse import OptionParser
+
+parser = OptionParser()
+parser.add_option("--mpv", dest="mpv", default="mpv",
+                  help="mpv binary to run")
+parser.add_option("--runs", dest="runs", type="int", default=3,
+                  help="number of runs (the fastest one is reported)")
+parser.add_option("--af", dest="af", default=None,
+                  help="audio filters to insert (--af)")
+parser.add_option("--generate", dest="generate", action="store_true",
+                  default=False, help="create FILE with ffmpeg first")
+parser.add_option("--channels", dest="channels", type="int", default=8)
+parser.add_option("--rate", dest="rate", type="int", default=192000)
+parser.add_option("--length", dest="length", type="int", default=60,
+                  help="length of the generated file in seconds")
+parser.add_option("--codec", dest="codec", default="pcm_s32le_planar",
+                  help="codec for the generated file")
+(options, args) = parser.parse_args()
+if len(args) != 1:
+    parser.error("expected a file name")
+filename = args[0]
+
+if options.generate:
+    subprocess.check_call(["ffmpeg", "-v", "error", "-y", "-f", "lavfi", "-i",
+                           "anoisesrc=r=%d:d=%d" % (options.rate,
+                                                    options.length),
+                           "-af", "pan=%dc|%s" % (options.channels, "|".join(
+                               "c%d=c0" % n for n in range(options.channels))),
+                           "-c:a", options.codec, filename])
+
+cmd = [options.mpv, "--no-config", "--really-quiet", "--no-video",
+       "--ao=pcm:nowaveheader:file=/dev/null", "--identify"]
+if options.af:
+    cmd += ["--af=" + options.af]
+cmd += [filename]
+
+best = None
+info = {}
+for run in range(options.runs):
+    start = time.time()
+    proc = subprocess.Popen(cmd, stdout=subprocess.PIPE)
+    out = proc.communicate()[0].decode("utf-8", "replace")
+    elapsed = time.time() - start
+    if proc.returncode != 0:
+        sys.stderr.write("mpv exited with status %d\n" % proc.returncode)
+        sys.exit(1)
+    for line in out.splitlines():
+        if "=" in line:
+            key, value = line.split("=", 1)
+            info[key] = value
+    if best is None or elapsed < best:
+        best = elapsed
+
+rate = int(info.get("ID_AUDIO_RATE", "0"))
+channels = int(info.get("ID_AUDIO_NCH", "0"))
+length = float(info.get("ID_LENGTH", "0"))
+# assumes 32 bit samples, like float or the generated file
+size = rate * channels * 4 * length
+print("%s: %d Hz, %d channels, %.1f s" % (filename, rate, channels, length))
+if size:
+    print("best of %d runs: %.3f s, %.1f MB/s decoded audio, %.0fx realtime"
+          % (options.runs, best, size / best / 1e6, length / best))
+else:
+    print("best of %d runs: %.3f s" % (options.runs, best))
@@ -0,0 +1,57 @@
+#!/usr/bin/env python
+
+# Measure how smoothly video follows the audio clock. A file is played with
+# the null video and audio outputs, and the A/V difference after each video
+# frame is collected from the status line. ao_null can simulate the clock
+# drift and the rough delay reports of real audio hardware, see the
+# speed/jitter suboptions.
+#
+# usage:
+#   TOOLS/avsync_check.py [--mpv ./mpv] [--speed 1.001] [--jitter 0.02] FILE
+#
+# The standard deviation of the A/V difference shows how much the video timing
+# jitters, the mean shows whether a clock drift is followed.
+
+import math
+import re
+import subprocess
+import sys
+from optparse import OptionParser
+
+parser = OptionParser()
+parser.add_option("--mpv", dest="mpv", default="mpv",
+                  help="mpv binary to run")
+parser.add_option("--speed", dest="speed", default="1",
+                  help="ao_null clock speed (simulated drift)")
+parser.add_option("--jitter", dest="jitter", default="0",
+                  help="ao_null delay report error in seconds")
+parser.add_option("--length", dest="length", default="30",
+                  help="seconds to play")
+parser.add_option("--skip", dest="skip", type="float", default=0.1,
+                  help="fraction of the measurements to ignore at the start")
+(options, args) = parser.parse_args()
+if len(args) != 1:
+    parser.error("expected a file name")
+
+cmd = [options.mpv, "--no-config", "--vo=null",
+       "--ao=null:speed=%s:jitter=%s" % (options.speed, options.jitter),
+       "--length=" + options.length, "--status-msg=AVSYNC ${avsync}\\n",
+       args[0]]
+proc = subprocess.Popen(cmd, stdout=subprocess.PIPE, stderr=subprocess.STDOUT)
+out = proc.communicate()[0].decode("utf-8", "replace")
+if proc.returncode != 0:
+    sys.stderr.write("mpv exited with status %d\n" % proc.returncode)
+    sys.exit(1)
+
+values = [float(v) for v in re.findall(r"AVSYNC (-?[0-9.]+)", out)]
+values = values[int(len(values) * options.skip):]
+if len(values) < 2:
+    sys.stderr.write("no A/V sync values found (does the file have audio "
+                     "and video?)\n")
+    sys.exit(1)
+
+mean = sum(values) / len(values)
+dev = math.sqrt(sum((v - mean) ** 2 for v in values) / (len(values) - 1))
+print("%d frames: A-V mean %+.2f ms, std. deviation %.2f ms, max %.2f ms"
+      % (len(values), mean * 1000, dev * 1000,
+         max(abs(v) for v in values) * 1000))
@@ -0,0 +1,106 @@
+#!/usr/bin/env python
+
+# Serve files over HTTP/1.1 with Range and keep-alive support, and log every
+# connection and request. Useful to check how many connections the player
+# opens while seeking in a network stream.
+#
+# usage:
+#   TOOLS/http_range_server.py [--port 8080] [--delay MS] [--close] DIR
+#   mpv mp_http://localhost:8080/file.mkv
+#
+# --delay adds latency to each response, --close makes the server close the
+# connection after each response like an HTTP/1.0 server.
+
+import os
+import re
+import sys
+import time
+from optparse import OptionParser
+
+try:
+    from http.server import BaseHTTPRequestHandler, HTTPServer
+    from socketserver import ThreadingMixIn
+except ImportError:
+    from BaseHTTPServer import BaseHTTPRequestHandler, HTTPServer
+    from SocketServer import ThreadingMixIn
+
+parser = OptionParser()
+parser.add_option("--port", dest="port", type="int", default=8080)
+parser.add_option("--delay", dest="delay", type="int", default=0,
+                  help="milliseconds to wait before each response")
+parser.add_option("--close", dest="close", action="store_true", default=False,
+                  help="don't keep connections open")
+(options, args) = parser.parse_args()
+root = os.path.abspath(args[0] if args else ".")
+
+stats = {"connections": 0, "requests": 0}
+
+
+class Handler(BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.0" if options.close else "HTTP/1.1"
+
+    def setup(self):
+        BaseHTTPRequestHandler.setup(self)
+        stats["connections"] += 1
+        self.conn_id = stats["connections"]
+        self.conn_requests = 0
+
+    def log_message(self, fmt, *args):
+        sys.stderr.write("[conn %d] %s\n" % (self.conn_id, fmt % args))
+
+    def do_GET(self):
+        stats["requests"] += 1
+        self.conn_requests += 1
+        path = os.path.join(root, self.path.lstrip("/"))
+        if not os.path.isfile(path):
+            self.send_error(404)
+            return
+        size = os.path.getsize(path)
+        start, end = 0, size - 1
+        m = re.match(r"bytes=(\d+)-(\d*)", self.headers.get("Range", ""))
+        if m:
+            start = int(m.group(1))
+            if m.group(2):
+                end = min(int(m.group(2)), size - 1)
+            if start >= size:
+                self.send_error(416)
+                return
+        if options.delay:
+            time.sleep(options.delay / 1000.0)
+        self.send_response(206 if m else 200)
+        self.send_header("Accept-Ranges", "bytes")
+        self.send_header("Content-Length", str(end - start + 1))
+        if m:
+            self.send_header("Content-Range",
+                             "bytes %d-%d/%d" % (start, end, size))
+        if options.close:
+            self.send_header("Connection", "close")
+        self.end_headers()
+        with open(path, "rb") as f:
+            f.seek(start)
+            left = end - start + 1
+            try:
+                while left > 0:
+                    data = f.read(min(left, 65536))
+                    if not data:
+                        break
+                    self.wfile.write(data)
+                    left -= len(data)
+            except (IOError, OSError):
+                # client closed the connection in the middle of the body
+                self.close_connection = True
+        self.log_message("%s: %d connections, %d requests total",
+                         self.headers.get("Range", "full"),
+                         stats["connections"], stats["requests"])
+
+
+class Server(ThreadingMixIn, HTTPServer):
+    daemon_threads = True
+
+
+server = Server(("", options.port), Handler)
+sys.stderr.write("serving %s on port %d\n" % (root, options.port))
+try:
+    server.serve_forever()
+except KeyboardInterrupt:
+    pass
@@ -0,0 +1,49 @@
+#!/usr/bin/env python
+
+# Measure how many commands per second mpv accepts on its command input.
+#
+# usage:
+#   TOOLS/input_bench.py [--mpv ./mpv] [--count N] [--batch N]
+#
+# Starts mpv in idle mode reading commands from a pipe, writes N no-op
+# commands to it (in writes of --batch lines), and then asks mpv to quit.
+# The reported rate is the number of commands divided by the time until the
+# player exited.
+
+import subprocess
+import sys
+import time
+from optparse import OptionParser
+
+parser = OptionParser()
+parser.add_option("--mpv", dest="mpv", default="mpv",
+                  help="mpv binary to run")
+parser.add_option("--count", dest="count", type="int", default=200000,
+                  help="number of commands to send")
+parser.add_option("--batch", dest="batch", type="int", default=100,
+                  help="number of commands per write")
+parser.add_option("--cmd", dest="cmd", default="ignore",
+                  help="command to send")
+(options, args) = parser.parse_args()
+
+proc = subprocess.Popen([options.mpv, "--no-config", "--idle", "--really-quiet",
+                         "--input-file=/dev/stdin"],
+                        stdin=subprocess.PIPE)
+
+chunk = ((options.cmd + "\n") * options.batch).encode()
+sent = 0
+start = time.time()
+while sent < options.count:
+    proc.stdin.write(chunk)
+    sent += options.batch
+proc.stdin.write(b"quit\n")
+proc.stdin.flush()
+proc.wait()
+elapsed = time.time() - start
+
+if proc.returncode != 0:
+    sys.stderr.write("mpv exited with status %d\n" % proc.returncode)
+    sys.exit(1)
+
+print("%d commands in %.3f s: %.0f commands/s" % (sent, elapsed,
+                                                  sent / elapsed))
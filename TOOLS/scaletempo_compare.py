@@ -0,0 +1,78 @@
+#!/usr/bin/env python
+
+# Check that the FFT and the direct overlap search of af_scaletempo produce
+# the same audio. Both are run on the same file, and the output is compared
+# sample by sample. Differences are expected only in the rare strides where
+# two overlap positions correlate almost equally well, and rounding decides
+# between them.
+#
+# usage:
+#   TOOLS/scaletempo_compare.py [--mpv ./mpv] [--scale 2] [--options OPTS] FILE
+#
+# --options adds more scaletempo suboptions, e.g. "search=30:stride=30".
+
+import math
+import os
+import struct
+import subprocess
+import sys
+import tempfile
+import wave
+from optparse import OptionParser
+
+parser = OptionParser()
+parser.add_option("--mpv", dest="mpv", default="mpv",
+                  help="mpv binary to run")
+parser.add_option("--scale", dest="scale", default="2",
+                  help="tempo scale")
+parser.add_option("--options", dest="options", default="",
+                  help="extra scaletempo suboptions")
+parser.add_option("--length", dest="length", default="60",
+                  help="seconds of audio to compare")
+parser.add_option("--max-diff", dest="max_diff", type="float", default=1.0,
+                  help="maximum percentage of differing samples")
+(options, args) = parser.parse_args()
+if len(args) != 1:
+    parser.error("expected a file name")
+
+
+def render(fft, out):
+    af = "format=floatne,scaletempo=scale=%s:fft=%s" % (options.scale, fft)
+    if options.options:
+        af += ":" + options.options
+    subprocess.check_call([options.mpv, "--no-config", "--really-quiet",
+                           "--no-video", "--length=" + options.length,
+                           "--af=" + af, "--format=s16le",
+                           "--ao=pcm:file=" + out, args[0]])
+    w = wave.open(out, "rb")
+    data = w.readframes(w.getnframes())
+    channels = w.getnchannels()
+    w.close()
+    return struct.unpack("<%dh" % (len(data) // 2), data), channels
+
+
+tmp = tempfile.mkdtemp()
+try:
+    ref, channels = render("no", os.path.join(tmp, "direct.wav"))
+    new, _ = render("yes", os.path.join(tmp, "fft.wav"))
+finally:
+    for name in os.listdir(tmp):
+        os.remove(os.path.join(tmp, name))
+    os.rmdir(tmp)
+
+if len(ref) != len(new):
+    print("length differs: %d vs. %d samples" % (len(ref), len(new)))
+    sys.exit(1)
+
+# allow rounding differences of 1 in the s16 conversion
+diff = sum(1 for a, b in zip(ref, new) if abs(a - b) > 1)
+signal = sum(float(a) * a for a in ref)
+noise = sum(float(a - b) * (a - b) for a, b in zip(ref, new))
+percent = 100.0 * diff / max(len(ref), 1)
+print("%d channels, %d samples, %d differ (%.3f%%)"
+      % (channels, len(ref), diff, percent))
+if noise:
+    print("SNR: %.1f dB" % (10 * math.log10(signal / noise)))
+else:
+    print("identical")
+sys.exit(0 if percent <= options.max_diff else 1)
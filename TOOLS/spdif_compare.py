@@ -0,0 +1,77 @@
+#!/usr/bin/env python
+
+# Check that the spdif passthrough decoder produces the same IEC 61937 stream
+# as the libavformat spdif muxer. Each file is passed through by mpv into a raw
+# PCM file, and muxed with "ffmpeg -c:a copy -f spdif"; both outputs are
+# compared byte by byte.
+#
+# usage:
+#   TOOLS/spdif_compare.py [--mpv ./mpv] [--ffmpeg ffmpeg] [--dtshd] FILE...
+#
+# Use files with AC3, DTS, E-AC3, TrueHD, AAC (ADTS) or MP3 audio. With
+# --dtshd, DTS is compared in DTS-HD mode (--dtshd and -dtshd_rate 768000).
+
+import os
+import subprocess
+import sys
+import tempfile
+from optparse import OptionParser
+
+parser = OptionParser()
+parser.add_option("--mpv", dest="mpv", default="mpv",
+                  help="mpv binary to run")
+parser.add_option("--ffmpeg", dest="ffmpeg", default="ffmpeg",
+                  help="ffmpeg binary to run")
+parser.add_option("--dtshd", dest="dtshd", action="store_true", default=False,
+                  help="compare DTS-HD output")
+(options, args) = parser.parse_args()
+if not args:
+    parser.error("expected file names")
+
+
+def run(cmd):
+    with open(os.devnull, "w") as null:
+        return subprocess.call(cmd, stdout=null, stderr=null) == 0
+
+
+def compare(filename, tmpdir):
+    mpv_out = os.path.join(tmpdir, "mpv.spdif")
+    lavf_out = os.path.join(tmpdir, "lavf.spdif")
+    mpv_cmd = [options.mpv, "--no-config", "--no-video", "--ad=spdif:*",
+               "--ao=pcm:nowaveheader:file=" + mpv_out, filename]
+    lavf_cmd = [options.ffmpeg, "-y", "-i", filename, "-vn", "-sn",
+                "-c:a", "copy", "-f", "spdif", lavf_out]
+    if options.dtshd:
+        mpv_cmd.insert(1, "--dtshd")
+        lavf_cmd[-1:-1] = ["-dtshd_rate", "768000"]
+    if not run(mpv_cmd):
+        return "mpv failed"
+    if not run(lavf_cmd):
+        return "ffmpeg failed"
+    with open(mpv_out, "rb") as f:
+        a = f.read()
+    with open(lavf_out, "rb") as f:
+        b = f.read()
+    if a == b:
+        return "identical, %d bytes" % len(a)
+    for pos in range(min(len(a), len(b))):
+        if a[pos] != b[pos]:
+            break
+    else:
+        pos = min(len(a), len(b))
+    return "DIFFERENT at byte %d (sizes: mpv %d, lavf %d)" % (pos, len(a),
+                                                              len(b))
+
+
+tmpdir = tempfile.mkdtemp()
+failed = False
+try:
+    for filename in args:
+        res = compare(filename, tmpdir)
+        failed |= not res.startswith("identical")
+        print("%s: %s" % (filename, res))
+finally:
+    for name in os.listdir(tmpdir):
+        os.remove(os.path.join(tmpdir, name))
+    os.rmdir(tmpdir)
+sys.exit(1 if failed else 0)
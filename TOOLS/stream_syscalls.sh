@@ -0,0 +1,24 @@
+#!/bin/sh
+
+# Count the system calls mpv makes while reading a file.
+#
+# usage:
+#   TOOLS/stream_syscalls.sh file [extra mpv options]
+#
+# Plays the first 30 seconds of the file without audio/video output under
+# strace, and prints the syscall summary for the calls related to file I/O.
+# Compare e.g. the default mode against --file-mmap.
+
+MPV=${MPV:-mpv}
+
+if [ -z "$1" ]; then
+    echo "usage: $0 file [mpv options]" >&2
+    exit 1
+fi
+
+file=$1
+shift
+
+strace -f -c -e trace=read,pread64,lseek,mmap,munmap,fadvise64,madvise \
+    "$MPV" --no-config --really-quiet --vo=null --ao=null --length=30 \
+    "$@" "$file" 2>&1 >/dev/null
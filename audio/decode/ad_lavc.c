@@ -47,7 +47,8 @@ struct priv {
     AVCodecContext *avctx;
     AVFrame *avframe;
     uint8_t *output;
-    uint8_t *output_packed; // used by deplanarize to store packed audio samples
+    uint8_t **planes;       // next samples of each channel, for planar frames
+    bool planar;
     int output_left;
     int unitsize;
     int previous_data_left;  // input demuxer packet data
@@ -352,25 +353,6 @@ static int control(sh_audio_t *sh, int cmd, void *arg)
     return CONTROL_UNKNOWN;
 }
 
-static av_always_inline void deplanarize(struct sh_audio *sh)
-{
-    struct priv *priv = sh->context;
-
-    uint8_t **planes  = priv->avframe->extended_data;
-    size_t bps        = av_get_bytes_per_sample(priv->avctx->sample_fmt);
-    size_t nb_samples = priv->avframe->nb_samples;
-    size_t channels   = priv->avctx->channels;
-    size_t size       = bps * nb_samples * channels;
-
-    if (talloc_get_size(priv->output_packed) != size)
-        priv->output_packed =
-            talloc_realloc_size(priv, priv->output_packed, size);
-
-    reorder_to_packed(priv->output_packed, planes, bps, channels, nb_samples);
-
-    priv->output = priv->output_packed;
-}
-
 static int decode_new_packet(struct sh_audio *sh)
 {
     struct priv *priv = sh->context;
@@ -433,8 +415,15 @@ static int decode_new_packet(struct sh_audio *sh)
     if (output_left > 500000000)
         abort();
     priv->output_left = output_left;
-    if (av_sample_fmt_is_planar(avctx->sample_fmt) && avctx->channels > 1) {
-        deplanarize(sh);
+    // Planar frames are interleaved by decode_audio() straight into the
+    // decoder output buffer, instead of being repacked and copied again.
+    priv->planar = av_sample_fmt_is_planar(avctx->sample_fmt)
+                   && avctx->channels > 1;
+    if (priv->planar) {
+        priv->planes = talloc_realloc(priv, priv->planes, uint8_t *,
+                                      avctx->channels);
+        for (int n = 0; n < avctx->channels; n++)
+            priv->planes[n] = priv->avframe->extended_data[n];
     } else {
         priv->output = priv->avframe->data[0];
     }
@@ -464,8 +453,17 @@ static int decode_audio(sh_audio_t *sh_audio, unsigned char *buf, int minlen,
         size = FFMIN(size, priv->output_left);
         if (size > maxlen)
             abort();
-        memcpy(buf, priv->output, size);
-        priv->output += size;
+        if (priv->planar) {
+            int channels = avctx->channels;
+            size_t bps = priv->unitsize / channels;
+            size_t samples = size / priv->unitsize;
+            reorder_to_packed(buf, priv->planes, bps, channels, samples);
+            for (int n = 0; n < channels; n++)
+                priv->planes[n] += samples * bps;
+        } else {
+            memcpy(buf, priv->output, size);
+            priv->output += size;
+        }
         priv->output_left -= size;
         if (len < 0)
             len = size;
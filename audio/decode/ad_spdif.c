@@ -20,52 +20,23 @@
 
 #include <string.h>
 
-#include <libavformat/avformat.h>
 #include <libavcodec/avcodec.h>
-#include <libavutil/opt.h>
 
+#include "talloc.h"
 #include "config.h"
 #include "core/mp_msg.h"
 #include "core/av_common.h"
 #include "core/options.h"
 #include "ad_internal.h"
+#include "iec61937.h"
 
 LIBAD_EXTERN(spdif)
 
-#define FILENAME_SPDIFENC "spdif"
-#define OUTBUF_SIZE 65536
 struct spdifContext {
-    AVFormatContext *lavf_ctx;
+    struct iec61937 *framer;
     int              iec61937_packet_size;
-    int              out_buffer_len;
-    int              out_buffer_size;
-    uint8_t         *out_buffer;
-    uint8_t          pb_buffer[OUTBUF_SIZE];
 };
 
-static int read_packet(void *p, uint8_t *buf, int buf_size)
-{
-    // spdifenc does not use read callback.
-    return 0;
-}
-
-static int write_packet(void *p, uint8_t *buf, int buf_size)
-{
-    int len;
-    struct spdifContext *ctx = p;
-
-    len = FFMIN(buf_size, ctx->out_buffer_size -ctx->out_buffer_len);
-    memcpy(&ctx->out_buffer[ctx->out_buffer_len], buf, len);
-    ctx->out_buffer_len += len;
-    return len;
-}
-
-static int64_t seek(void *p, int64_t offset, int whence)
-{
-    // spdifenc does not use seek callback.
-    return 0;
-}
-
 static int preinit(sh_audio_t *sh)
 {
     sh->samplesize = 2;
@@ -84,44 +55,19 @@ static int codecs[] = {
 
 static int init(sh_audio_t *sh, const char *decoder)
 {
-    int x, in_size, srate, bps, *dtshd_rate;
+    int x, in_size, srate, bps;
     unsigned char *start;
     double pts;
-    AVFormatContext     *lavf_ctx  = NULL;
-    AVStream            *stream    = NULL;
-    const AVOption      *opt       = NULL;
-    struct spdifContext *spdif_ctx = NULL;
-
-    spdif_ctx = av_mallocz(sizeof(*spdif_ctx));
-    if (!spdif_ctx)
-        goto fail;
-    spdif_ctx->lavf_ctx = avformat_alloc_context();
-    if (!spdif_ctx->lavf_ctx)
-        goto fail;
+    struct spdifContext *spdif_ctx = talloc_zero(NULL, struct spdifContext);
+    int codec_id = mp_codec_to_av_codec_id(decoder);
 
     sh->context = spdif_ctx;
-    lavf_ctx    = spdif_ctx->lavf_ctx;
-
-    lavf_ctx->oformat = av_guess_format(FILENAME_SPDIFENC, NULL, NULL);
-    if (!lavf_ctx->oformat)
-        goto fail;
-    lavf_ctx->priv_data = av_mallocz(lavf_ctx->oformat->priv_data_size);
-    if (!lavf_ctx->priv_data)
-        goto fail;
-    lavf_ctx->pb = avio_alloc_context(spdif_ctx->pb_buffer, OUTBUF_SIZE, 1, spdif_ctx,
-                            read_packet, write_packet, seek);
-    if (!lavf_ctx->pb)
-        goto fail;
-    stream = avformat_new_stream(lavf_ctx, 0);
-    if (!stream)
-        goto fail;
-    lavf_ctx->duration   = AV_NOPTS_VALUE;
-    lavf_ctx->start_time = AV_NOPTS_VALUE;
-    lavf_ctx->streams[0]->codec->codec_id = mp_codec_to_av_codec_id(decoder);
-    lavf_ctx->raw_packet_buffer_remaining_size = RAW_PACKET_BUFFER_SIZE;
-    if (AVERROR_PATCHWELCOME == lavf_ctx->oformat->write_header(lavf_ctx)) {
+    // DTS-HD is sent at 4 times the 192 kHz IEC 60958 rate (8 channels)
+    spdif_ctx->framer = iec61937_create(spdif_ctx, codec_id,
+                                        sh->opts->dtshd ? 192000 * 4 : 0);
+    if (!spdif_ctx->framer) {
         mp_msg(MSGT_DECAUDIO,MSGL_INFO,
-               "This codec is not supported by spdifenc.\n");
+               "This codec is not supported by spdif passthrough.\n");
         goto fail;
     }
 
@@ -149,7 +95,7 @@ static int init(sh_audio_t *sh, const char *decoder)
     sh->ds->buffer_pos -= in_size;
 
     int num_channels = 0;
-    switch (lavf_ctx->streams[0]->codec->codec_id) {
+    switch (codec_id) {
     case AV_CODEC_ID_AAC:
         spdif_ctx->iec61937_packet_size = 16384;
         sh->sample_format               = AF_FORMAT_IEC61937_LE;
@@ -166,13 +112,6 @@ static int init(sh_audio_t *sh, const char *decoder)
         break;
     case AV_CODEC_ID_DTS:
         if(sh->opts->dtshd) {
-            opt = av_opt_find(&lavf_ctx->oformat->priv_class,
-                              "dtshd_rate", NULL, 0, 0);
-            if (!opt)
-                goto fail;
-            dtshd_rate                      = (int*)(((uint8_t*)lavf_ctx->priv_data) +
-                                              opt->offset);
-            *dtshd_rate                     = 192000*4;
             spdif_ctx->iec61937_packet_size = 32768;
             sh->sample_format               = AF_FORMAT_IEC61937_LE;
             sh->samplerate                  = 192000; // DTS core require 48000
@@ -224,17 +163,13 @@ static int decode_audio(sh_audio_t *sh, unsigned char *buf,
                         int minlen, int maxlen)
 {
     struct spdifContext *spdif_ctx = sh->context;
-    AVFormatContext     *lavf_ctx  = spdif_ctx->lavf_ctx;
-    AVPacket            pkt;
     double              pts;
     int                 ret, in_size, consumed, x;
+    int                 len = 0;
     unsigned char       *start = NULL;
 
-    consumed = spdif_ctx->out_buffer_len  = 0;
-    spdif_ctx->out_buffer_size = maxlen;
-    spdif_ctx->out_buffer      = buf;
-    while (spdif_ctx->out_buffer_len + spdif_ctx->iec61937_packet_size < maxlen
-           && spdif_ctx->out_buffer_len < minlen) {
+    consumed = 0;
+    while (len + spdif_ctx->iec61937_packet_size < maxlen && len < minlen) {
         if (sh->ds->eof)
             break;
         x = ds_get_packet_pts(sh->ds, &start, &pts);
@@ -255,22 +190,22 @@ static int decode_audio(sh_audio_t *sh, unsigned char *buf,
             }
             sh->ds->buffer_pos -= in_size - consumed;
         }
-        av_init_packet(&pkt);
-        pkt.data = start;
-        pkt.size = x;
         mp_msg(MSGT_DECAUDIO,MSGL_V,
-               "start[%p] pkt.size[%d] in_size[%d] consumed[%d] x[%d].\n",
-               start, pkt.size, in_size, consumed, x);
+               "start[%p] pkt.size[%d] in_size[%d] consumed[%d].\n",
+               start, x, in_size, consumed);
         if (pts != MP_NOPTS_VALUE) {
             sh->pts       = pts;
             sh->pts_bytes = 0;
         }
-        ret = lavf_ctx->oformat->write_packet(lavf_ctx, &pkt);
+        // The burst is written directly into the decoder output buffer
+        ret = iec61937_frame(spdif_ctx->framer, start, x, buf + len,
+                             maxlen - len);
         if (ret < 0)
             break;
+        len += ret;
     }
-    sh->pts_bytes += spdif_ctx->out_buffer_len;
-    return spdif_ctx->out_buffer_len;
+    sh->pts_bytes += len;
+    return len;
 }
 
 static int control(sh_audio_t *sh, int cmd, void *arg)
@@ -289,23 +224,8 @@ static int control(sh_audio_t *sh, int cmd, void *arg)
 
 static void uninit(sh_audio_t *sh)
 {
-    struct spdifContext *spdif_ctx = sh->context;
-    AVFormatContext     *lavf_ctx  = spdif_ctx->lavf_ctx;
-
-    if (lavf_ctx) {
-        if (lavf_ctx->oformat)
-            lavf_ctx->oformat->write_trailer(lavf_ctx);
-        av_freep(&lavf_ctx->pb);
-        if (lavf_ctx->streams) {
-            av_freep(&lavf_ctx->streams[0]->codec);
-            av_freep(&lavf_ctx->streams[0]->info);
-            av_freep(&lavf_ctx->streams[0]);
-        }
-        av_freep(&lavf_ctx->streams);
-        av_freep(&lavf_ctx->priv_data);
-    }
-    av_freep(&lavf_ctx);
-    av_freep(&spdif_ctx);
+    talloc_free(sh->context);
+    sh->context = NULL;
 }
 
 static void add_decoders(struct mp_decoder_list *list)
@@ -314,7 +234,7 @@ static void add_decoders(struct mp_decoder_list *list)
         const char *format = mp_codec_from_av_codec_id(codecs[n]);
         if (format) {
             mp_add_decoder(list, "spdif", format, format,
-                           "libavformat/spdifenc audio pass-through decoder");
+                           "IEC 61937 audio pass-through decoder");
         }
     }
 }
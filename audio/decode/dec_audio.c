@@ -20,6 +20,9 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <assert.h>
+#include <math.h>
+
+#include <libavutil/common.h>
 
 #include "demux/codec_tags.h"
 
@@ -250,8 +253,49 @@ static void set_min_out_buffer_size(struct bstr *outbuf, int len)
     }
 }
 
+/* Like filter_n_bytes(), but for an empty filter chain: the decoder writes
+ * directly into outbuf, which saves copying all audio through a_buffer.
+ */
+static int decode_n_bytes_direct(sh_audio_t *sh, struct bstr *outbuf, int len)
+{
+    int error = 0;
+
+    set_min_out_buffer_size(outbuf, outbuf->len + sh->a_buffer_len + len
+                                    + sh->audio_out_minsize);
+    int size = talloc_get_size(outbuf->start);
+
+    // Data still buffered from earlier calls comes first
+    memcpy(outbuf->start + outbuf->len, sh->a_buffer, sh->a_buffer_len);
+    int got = sh->a_buffer_len;
+    sh->a_buffer_len = 0;
+
+    int old_samplerate = sh->samplerate;
+    struct mp_chmap old_channels = sh->channels;
+    int old_sample_format = sh->sample_format;
+    while (got < len) {
+        unsigned char *buf = outbuf->start + outbuf->len + got;
+        int maxlen = size - outbuf->len - got;
+        int ret = sh->ad_driver->decode_audio(sh, buf, len - got, maxlen);
+        int format_change = sh->samplerate != old_samplerate
+                            || !mp_chmap_equals(&sh->channels, &old_channels)
+                            || sh->sample_format != old_sample_format;
+        if (ret <= 0 || format_change) {
+            // samples from format-changing call get discarded
+            error = format_change ? -2 : -1;
+            break;
+        }
+        got += ret;
+    }
+    outbuf->len += got;
+
+    return error;
+}
+
 static int filter_n_bytes(sh_audio_t *sh, struct bstr *outbuf, int len)
 {
+    if (af_is_passthrough(sh->afilter))
+        return decode_n_bytes_direct(sh, outbuf, len);
+
     assert(len - 1 + sh->audio_out_minsize <= sh->a_buffer_size);
 
     int error = 0;
@@ -365,6 +409,47 @@ void decode_audio_prepend_bytes(struct bstr *outbuf, int count, int byte)
     outbuf->len += count;
 }
 
+/* Discard duration seconds (rounded up to whole samples) of decoded audio
+ * before it reaches the filter chain, e.g. to cut the audio at the exact
+ * position after seeking without filtering audio that is thrown away anyway.
+ * Returns with some decoded audio buffered, so that the timestamp of the
+ * decoder output is known (duration can be 0 to only do that).
+ * Return value is the same as with decode_audio().
+ */
+int decode_audio_skip(sh_audio_t *sh, double duration)
+{
+    int framesize = sh->channels.num * sh->samplesize;
+    if (!framesize)
+        return -1;
+    int64_t frames = ceil(duration * sh->samplerate - 1e-6);
+
+    int old_samplerate = sh->samplerate;
+    struct mp_chmap old_channels = sh->channels;
+    int old_sample_format = sh->sample_format;
+    while (1) {
+        int n = FFMIN(FFMAX(frames, 0), sh->a_buffer_len / framesize);
+        sh->a_buffer_len -= n * framesize;
+        memmove(sh->a_buffer, sh->a_buffer + n * framesize,
+                sh->a_buffer_len);
+        frames -= n;
+        if (frames <= 0 && sh->a_buffer_len)
+            return 0;
+
+        // The buffer is empty here
+        int minlen = FFMAX(frames, 1) * framesize;
+        int maxlen = sh->a_buffer_size;
+        minlen = FFMIN(minlen, maxlen - sh->audio_out_minsize + 1);
+        int ret = sh->ad_driver->decode_audio(sh, sh->a_buffer, minlen,
+                                              maxlen);
+        int format_change = sh->samplerate != old_samplerate
+                            || !mp_chmap_equals(&sh->channels, &old_channels)
+                            || sh->sample_format != old_sample_format;
+        if (ret <= 0 || format_change)
+            return format_change ? -2 : -1;
+        sh->a_buffer_len = ret;
+    }
+}
+
 
 void resync_audio_stream(sh_audio_t *sh_audio)
 {
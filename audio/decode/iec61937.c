@@ -0,0 +1,570 @@
+/*
+ * IEC 61937 framing, following libavformat/spdifenc.c.
+ *
+ * This file is part of mpv.
+ *
+ * mpv is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * mpv is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with mpv.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdbool.h>
+#include <string.h>
+
+#include <libavcodec/avcodec.h>
+#include <libavutil/common.h>
+#include <libavutil/intreadwrite.h>
+
+#include "talloc.h"
+#include "core/mp_msg.h"
+#include "iec61937.h"
+
+#define SYNCWORD1 0xF872
+#define SYNCWORD2 0x4E1F
+#define BURST_HEADER_SIZE 8
+
+// Burst info: data type of the payload (IEC 61937-2)
+enum {
+    IEC61937_AC3                = 0x01,
+    IEC61937_MPEG1_LAYER1       = 0x04,
+    IEC61937_MPEG1_LAYER23      = 0x05,
+    IEC61937_MPEG2_EXT          = 0x06,
+    IEC61937_MPEG2_AAC          = 0x07,
+    IEC61937_MPEG2_LAYER1_LSF   = 0x08,
+    IEC61937_MPEG2_LAYER2_LSF   = 0x09,
+    IEC61937_MPEG2_LAYER3_LSF   = 0x0A,
+    IEC61937_DTS1               = 0x0B,
+    IEC61937_DTS2               = 0x0C,
+    IEC61937_DTS3               = 0x0D,
+    IEC61937_DTSHD              = 0x11,
+    IEC61937_MPEG2_AAC_LSF_2048 = 0x13,
+    IEC61937_MPEG2_AAC_LSF_4096 = 0x13 | 0x20,
+    IEC61937_EAC3               = 0x15,
+    IEC61937_TRUEHD             = 0x16,
+};
+
+#define DCA_MARKER_RAW_BE 0x7FFE8001
+#define DCA_MARKER_RAW_LE 0xFE7F0180
+#define DCA_MARKER_14B_BE 0x1FFFE800
+#define DCA_MARKER_14B_LE 0xFF1F00E8
+#define DCA_HD_MARKER     0x64582025
+
+// Seconds to send the DTS core only after a DTS-HD frame didn't fit
+#define DTSHD_FALLBACK 60
+
+/* TrueHD frames are sent in MAT frames, with MAT codes at fixed positions.
+ * Frames are placed according to their input timing, and the space between
+ * them is padded to achieve a constant rate.
+ */
+#define MAT_PKT_OFFSET          61440
+#define MAT_FRAME_SIZE          61424
+
+static const uint8_t mat_start_code[20] = {
+    0x07, 0x9E, 0x00, 0x03, 0x84, 0x01, 0x01, 0x01, 0x80, 0x00,
+    0x56, 0xA5, 0x3B, 0xF4, 0x81, 0x83, 0x49, 0x80, 0x77, 0xE0
+};
+static const uint8_t mat_middle_code[12] = {
+    0xC3, 0xC1, 0x42, 0x49, 0x3B, 0xFA, 0x82, 0x83, 0x49, 0x80, 0x77, 0xE0
+};
+static const uint8_t mat_end_code[16] = {
+    0xC3, 0xC2, 0xC0, 0xC4, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x97, 0x11
+};
+
+static const struct {
+    int pos;
+    const uint8_t *code;
+    int len;
+} mat_codes[] = {
+    { 0,                                             mat_start_code,
+      sizeof(mat_start_code) },
+    { 30708,                                         mat_middle_code,
+      sizeof(mat_middle_code) },
+    { MAT_FRAME_SIZE - (int)sizeof(mat_end_code),   mat_end_code,
+      sizeof(mat_end_code) },
+};
+
+struct iec61937 {
+    int (*header_info)(struct iec61937 *f, const uint8_t *data, int size);
+    int dtshd_rate;
+    int dtshd_skip;         // DTS-HD frames left to send as core only
+
+    // Burst being written, set by header_info
+    int data_type;
+    int length_code;        // in bits or bytes, depending on data_type
+    int pkt_offset;         // repetition period in bytes, 0: nothing to send
+    const uint8_t *prefix;  // sent before the payload (DTS-HD header)
+    int prefix_bytes;
+    const uint8_t *out_buf; // payload
+    int out_bytes;
+    bool use_preamble;
+    bool extra_bswap;       // payload is little endian already
+
+    uint8_t *hd_buf;        // E-AC3/TrueHD frames collected for one burst
+    int hd_buf_count;
+    int hd_buf_filled;
+    // TrueHD: the MAT frame being sent is kept while the next one is filled
+    uint8_t *mat_buf[2];
+    int mat_buf_idx;
+    int truehd_samples_per_frame;
+    int truehd_prev_size;   // frame size, including MAT codes
+    uint16_t truehd_prev_time;
+    uint8_t dtshd_header[12];
+};
+
+static int header_ac3(struct iec61937 *f, const uint8_t *data, int size)
+{
+    if (size < 6)
+        return -1;
+    int bitstream_mode = data[5] & 0x7;
+    f->data_type = IEC61937_AC3 | (bitstream_mode << 8);
+    f->pkt_offset = 1536 * 4;
+    return 0;
+}
+
+static int header_eac3(struct iec61937 *f, const uint8_t *data, int size)
+{
+    static const uint8_t eac3_repeat[4] = {6, 3, 2, 1};
+    if (size < 5)
+        return -1;
+    int repeat = 1;
+    if ((data[4] & 0xc0) != 0xc0) // fscod
+        repeat = eac3_repeat[(data[4] & 0x30) >> 4]; // numblkscod
+
+    if (talloc_get_size(f->hd_buf) < f->hd_buf_filled + size)
+        f->hd_buf = talloc_realloc_size(f, f->hd_buf, f->hd_buf_filled + size);
+    memcpy(f->hd_buf + f->hd_buf_filled, data, size);
+    f->hd_buf_filled += size;
+    if (++f->hd_buf_count < repeat) {
+        f->pkt_offset = 0;
+        return 0;
+    }
+    f->data_type   = IEC61937_EAC3;
+    f->pkt_offset  = 24576;
+    f->out_buf     = f->hd_buf;
+    f->out_bytes   = f->hd_buf_filled;
+    f->length_code = f->hd_buf_filled;
+
+    f->hd_buf_count  = 0;
+    f->hd_buf_filled = 0;
+    return 0;
+}
+
+/* DTS type IV (DTS-HD) can be sent with various repetition periods (in
+ * IEC 60958 frames of 4 bytes); longer periods allow larger frames, but need
+ * a higher IEC 60958 rate.
+ */
+static int dts4_subtype(int period)
+{
+    switch (period) {
+    case 512:   return 0x0;
+    case 1024:  return 0x1;
+    case 2048:  return 0x2;
+    case 4096:  return 0x3;
+    case 8192:  return 0x4;
+    case 16384: return 0x5;
+    }
+    return -1;
+}
+
+static int header_dts4(struct iec61937 *f, int size, int core_size,
+                       int sample_rate, int blocks)
+{
+    static const uint8_t dtshd_start_code[10] =
+        { 0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xfe, 0xfe };
+
+    if (!core_size) {
+        mp_msg(MSGT_DECAUDIO, MSGL_ERR, "[spdif] HD mode not supported for "
+               "this DTS format.\n");
+        return -1;
+    }
+    if (!sample_rate) {
+        mp_msg(MSGT_DECAUDIO, MSGL_ERR, "[spdif] Unknown DTS sample rate "
+               "for HD.\n");
+        return -1;
+    }
+    int period = f->dtshd_rate * (blocks << 5) / sample_rate;
+    int subtype = dts4_subtype(period);
+    if (subtype < 0) {
+        mp_msg(MSGT_DECAUDIO, MSGL_ERR, "[spdif] HD rate of %d Hz would "
+               "require an impossible repetition period of %d for the "
+               "current DTS stream (blocks = %d, sample rate = %d).\n",
+               f->dtshd_rate, period, blocks << 5, sample_rate);
+        return -1;
+    }
+    f->pkt_offset = period * 4;
+    f->data_type = IEC61937_DTSHD | subtype << 8;
+
+    /* If the frame is too large for the repetition period, strip DTS-HD
+     * until a good amount of consecutive frames have been sent. This
+     * generally only happens if a Master Audio stream is crammed into
+     * 192 kHz IEC 60958.
+     */
+    int pkt_size = size;
+    if ((int)sizeof(f->dtshd_header) + pkt_size
+            > f->pkt_offset - BURST_HEADER_SIZE)
+    {
+        if (!f->dtshd_skip)
+            mp_msg(MSGT_DECAUDIO, MSGL_WARN, "[spdif] DTS-HD bitrate too "
+                   "high, temporarily sending core only.\n");
+        f->dtshd_skip = sample_rate * DTSHD_FALLBACK / (blocks << 5);
+    }
+    if (f->dtshd_skip) {
+        pkt_size = core_size;
+        f->dtshd_skip--;
+    }
+
+    memcpy(f->dtshd_header, dtshd_start_code, sizeof(dtshd_start_code));
+    AV_WB16(f->dtshd_header + sizeof(dtshd_start_code), pkt_size);
+    f->prefix = f->dtshd_header;
+    f->prefix_bytes = sizeof(f->dtshd_header);
+    f->out_bytes = pkt_size;
+    // Align so that (length_code & 0xf) == 0x8, reportedly needed by some
+    // receivers.
+    f->length_code = FFALIGN(f->prefix_bytes + pkt_size + 0x8, 0x10) - 0x8;
+    return 0;
+}
+
+static int header_dts(struct iec61937 *f, const uint8_t *data, int size)
+{
+    static const int dca_sample_rates[16] = {
+        0, 8000, 16000, 32000, 0, 0, 11025, 22050, 44100, 0, 0,
+        12000, 24000, 48000, 96000, 192000
+    };
+    int blocks;
+    int sample_rate = 0;
+    int core_size = 0;
+
+    if (size < 9)
+        return -1;
+    uint32_t syncword = AV_RB32(data);
+    switch (syncword) {
+    case DCA_MARKER_RAW_BE:
+        blocks = (AV_RB16(data + 4) >> 2) & 0x7f;
+        core_size = ((AV_RB24(data + 5) >> 4) & 0x3fff) + 1;
+        sample_rate = dca_sample_rates[(data[8] >> 2) & 0x0f];
+        break;
+    case DCA_MARKER_RAW_LE:
+        blocks = (AV_RL16(data + 4) >> 2) & 0x7f;
+        f->extra_bswap = true;
+        break;
+    case DCA_MARKER_14B_BE:
+        blocks = ((data[5] & 0x07) << 4) | ((data[6] & 0x3f) >> 2);
+        break;
+    case DCA_MARKER_14B_LE:
+        blocks = ((data[4] & 0x07) << 4) | ((data[7] & 0x3f) >> 2);
+        f->extra_bswap = true;
+        break;
+    case DCA_HD_MARKER:
+        // HD frames are only handled together with the core. Some streams
+        // start with a stray HD frame.
+        mp_msg(MSGT_DECAUDIO, MSGL_V, "[spdif] Stray DTS-HD frame.\n");
+        return -1;
+    default:
+        mp_msg(MSGT_DECAUDIO, MSGL_ERR, "[spdif] Bad DTS syncword 0x%x.\n",
+               (unsigned)syncword);
+        return -1;
+    }
+    blocks++;
+
+    if (f->dtshd_rate)
+        return header_dts4(f, size, core_size, sample_rate, blocks);
+
+    switch (blocks) {
+    case 512 >> 5:  f->data_type = IEC61937_DTS1; break;
+    case 1024 >> 5: f->data_type = IEC61937_DTS2; break;
+    case 2048 >> 5: f->data_type = IEC61937_DTS3; break;
+    default:
+        mp_msg(MSGT_DECAUDIO, MSGL_ERR, "[spdif] %d samples in DTS frame "
+               "not supported.\n", blocks << 5);
+        return -1;
+    }
+
+    // Discard extraneous data (DTS-HD extensions)
+    if (core_size && core_size < size) {
+        f->out_bytes = core_size;
+        f->length_code = core_size << 3;
+    }
+
+    f->pkt_offset = blocks << 7;
+    // DTS discs and DTS-in-WAV fill the period exactly, without preamble
+    if (f->out_bytes == f->pkt_offset)
+        f->use_preamble = false;
+    return 0;
+}
+
+static int header_mpeg(struct iec61937 *f, const uint8_t *data, int size)
+{
+    static const uint8_t mpeg_data_type[2][3] = {
+        // LAYER1                    LAYER2                      LAYER3
+        { IEC61937_MPEG2_LAYER1_LSF, IEC61937_MPEG2_LAYER2_LSF,
+          IEC61937_MPEG2_LAYER3_LSF }, // MPEG2 LSF
+        { IEC61937_MPEG1_LAYER1, IEC61937_MPEG1_LAYER23,
+          IEC61937_MPEG1_LAYER23 },    // MPEG1
+    };
+    static const uint16_t mpeg_pkt_offset[2][3] = {
+        // LAYER1  LAYER2  LAYER3
+        { 3072,    9216,   4608 }, // MPEG2 LSF
+        { 1536,    4608,   4608 }, // MPEG1
+    };
+    if (size < 3)
+        return -1;
+    int version   = (data[1] >> 3) & 3;
+    int layer     = 3 - ((data[1] >> 1) & 3);
+    int extension = data[2] & 1;
+    if (layer == 3 || version == 1) {
+        mp_msg(MSGT_DECAUDIO, MSGL_ERR, "[spdif] Wrong MPEG file format.\n");
+        return -1;
+    }
+    if (version == 2 && extension) {
+        f->data_type  = IEC61937_MPEG2_EXT;
+        f->pkt_offset = 4608;
+    } else {
+        f->data_type  = mpeg_data_type[version & 1][layer];
+        f->pkt_offset = mpeg_pkt_offset[version & 1][layer];
+    }
+    return 0;
+}
+
+static int header_aac(struct iec61937 *f, const uint8_t *data, int size)
+{
+    // ADTS header: syncword, sampling_frequency_index, frame_length and
+    // number_of_raw_data_blocks_in_frame are needed
+    if (size < 7 || AV_RB16(data) >> 4 != 0xfff ||
+        ((data[2] >> 2) & 0xf) > 12 ||
+        ((AV_RB32(data + 2) >> 5) & 0x1fff) < 7)
+    {
+        mp_msg(MSGT_DECAUDIO, MSGL_ERR, "[spdif] Wrong AAC file format.\n");
+        return -1;
+    }
+    int num_frames = (data[6] & 0x3) + 1;
+    f->pkt_offset = num_frames * 1024 * 4;
+    switch (num_frames) {
+    case 1: f->data_type = IEC61937_MPEG2_AAC; break;
+    case 2: f->data_type = IEC61937_MPEG2_AAC_LSF_2048; break;
+    case 4: f->data_type = IEC61937_MPEG2_AAC_LSF_4096; break;
+    default:
+        mp_msg(MSGT_DECAUDIO, MSGL_ERR, "[spdif] %d samples in AAC frame "
+               "not supported.\n", num_frames * 1024);
+        return -1;
+    }
+    return 0;
+}
+
+static int header_truehd(struct iec61937 *f, const uint8_t *data, int size)
+{
+    uint8_t *hd_buf = f->mat_buf[f->mat_buf_idx];
+    int padding_remaining = 0;
+    int total_frame_size = size;
+    bool have_pkt = false;
+
+    if (size < 10)
+        return -1;
+
+    if (AV_RB24(data + 4) == 0xf8726f) {
+        // Major sync unit: fetch the sample rate
+        int ratebits;
+        if (data[7] == 0xba)
+            ratebits = data[8] >> 4;
+        else if (data[7] == 0xbb)
+            ratebits = data[9] >> 4;
+        else
+            return -1;
+        f->truehd_samples_per_frame = 40 << (ratebits & 3);
+    }
+    if (!f->truehd_samples_per_frame)
+        return -1;
+
+    uint16_t input_timing = AV_RB16(data + 2);
+    if (f->truehd_prev_size) {
+        /* A frame of a multiple of 48 kHz is 1/1200 s, which is 2560 bytes at
+         * the IEC 61937 rate of 768 kHz (likewise for 44.1 kHz and 705.6 kHz).
+         */
+        uint16_t delta_samples = input_timing - f->truehd_prev_time;
+        int delta_bytes = delta_samples * 2560 / f->truehd_samples_per_frame;
+        padding_remaining = delta_bytes - f->truehd_prev_size;
+        if (padding_remaining < 0 || padding_remaining >= MAT_FRAME_SIZE / 2) {
+            mp_msg(MSGT_DECAUDIO, MSGL_V, "[spdif] Unusual TrueHD frame "
+                   "timing: %d => %d, %d samples/frame.\n",
+                   f->truehd_prev_time, input_timing,
+                   f->truehd_samples_per_frame);
+            padding_remaining = 0;
+        }
+    }
+
+    int next_code = 0;
+    while (f->hd_buf_filled > mat_codes[next_code].pos)
+        next_code++;
+
+    /* Everything written is bounded by the position of the next MAT code,
+     * which is inserted once the buffer reaches it.
+     */
+    while (padding_remaining || size || f->hd_buf_filled ==
+                                        mat_codes[next_code].pos)
+    {
+        if (f->hd_buf_filled == mat_codes[next_code].pos) {
+            int code_len = mat_codes[next_code].len;
+            int code_len_remaining = code_len;
+            memcpy(hd_buf + f->hd_buf_filled, mat_codes[next_code].code,
+                   code_len);
+            f->hd_buf_filled += code_len;
+            next_code++;
+            if (next_code == FF_ARRAY_ELEMS(mat_codes)) {
+                // MAT frame complete: send it, and start the next one
+                next_code = 0;
+                have_pkt = true;
+                f->out_buf = hd_buf;
+                f->mat_buf_idx ^= 1;
+                hd_buf = f->mat_buf[f->mat_buf_idx];
+                f->hd_buf_filled = 0;
+                // The gap up to the next payload (padding and burst header)
+                // counts as well
+                code_len_remaining += MAT_PKT_OFFSET - MAT_FRAME_SIZE;
+            }
+            // MAT codes count as padding, the rest as part of the frame
+            int as_padding = FFMIN(padding_remaining, code_len_remaining);
+            padding_remaining -= as_padding;
+            total_frame_size += code_len_remaining - as_padding;
+        }
+
+        if (padding_remaining) {
+            int bytes = FFMIN(mat_codes[next_code].pos - f->hd_buf_filled,
+                              padding_remaining);
+            memset(hd_buf + f->hd_buf_filled, 0, bytes);
+            f->hd_buf_filled += bytes;
+            padding_remaining -= bytes;
+            if (padding_remaining)
+                continue;
+        }
+
+        if (size) {
+            int bytes = FFMIN(mat_codes[next_code].pos - f->hd_buf_filled,
+                              size);
+            memcpy(hd_buf + f->hd_buf_filled, data, bytes);
+            f->hd_buf_filled += bytes;
+            data += bytes;
+            size -= bytes;
+        }
+    }
+
+    f->truehd_prev_size = total_frame_size;
+    f->truehd_prev_time = input_timing;
+
+    if (!have_pkt) {
+        f->pkt_offset = 0;
+        return 0;
+    }
+    f->data_type   = IEC61937_TRUEHD;
+    f->pkt_offset  = MAT_PKT_OFFSET;
+    f->out_bytes   = MAT_FRAME_SIZE;
+    f->length_code = MAT_FRAME_SIZE;
+    return 0;
+}
+
+struct iec61937 *iec61937_create(void *talloc_ctx, int codec, int dtshd_rate)
+{
+    struct iec61937 *f = talloc_zero(talloc_ctx, struct iec61937);
+    f->dtshd_rate = dtshd_rate;
+    switch (codec) {
+    case AV_CODEC_ID_AC3:
+        f->header_info = header_ac3;
+        break;
+    case AV_CODEC_ID_EAC3:
+        f->header_info = header_eac3;
+        break;
+    case AV_CODEC_ID_MP1:
+    case AV_CODEC_ID_MP2:
+    case AV_CODEC_ID_MP3:
+        f->header_info = header_mpeg;
+        break;
+    case AV_CODEC_ID_DTS:
+        f->header_info = header_dts;
+        break;
+    case AV_CODEC_ID_AAC:
+        f->header_info = header_aac;
+        break;
+    case AV_CODEC_ID_TRUEHD:
+        f->header_info = header_truehd;
+        for (int n = 0; n < 2; n++)
+            f->mat_buf[n] = talloc_size(f, MAT_FRAME_SIZE);
+        break;
+    default:
+        talloc_free(f);
+        return NULL;
+    }
+    return f;
+}
+
+// Write the payload as 16 bit little endian words. The data is big endian
+// words, unless extra_bswap is set.
+static uint8_t *put_payload(struct iec61937 *f, uint8_t *dst,
+                            const uint8_t *src, int bytes)
+{
+    int words = bytes >> 1;
+    if (f->extra_bswap) {
+        memcpy(dst, src, words * 2);
+    } else {
+        for (int n = 0; n < words; n++) {
+            dst[2 * n]     = src[2 * n + 1];
+            dst[2 * n + 1] = src[2 * n];
+        }
+    }
+    dst += words * 2;
+    // A final lone byte has to be MSB aligned
+    if (bytes & 1) {
+        AV_WL16(dst, src[bytes - 1] << 8);
+        dst += 2;
+    }
+    return dst;
+}
+
+int iec61937_frame(struct iec61937 *f, const uint8_t *data, int size,
+                   uint8_t *out, int out_size)
+{
+    f->out_buf = data;
+    f->out_bytes = size;
+    f->prefix_bytes = 0;
+    f->length_code = FFALIGN(size, 2) << 3;
+    f->use_preamble = true;
+    f->extra_bswap = false;
+
+    if (f->header_info(f, data, size) < 0)
+        return -1;
+    if (!f->pkt_offset)
+        return 0;
+
+    // The burst is always exactly pkt_offset bytes
+    int payload = f->prefix_bytes + f->out_bytes;
+    int padding = (f->pkt_offset - f->use_preamble * BURST_HEADER_SIZE
+                   - payload) & ~1;
+    if (padding < 0) {
+        mp_msg(MSGT_DECAUDIO, MSGL_ERR, "[spdif] Bitrate is too high.\n");
+        return -1;
+    }
+    if (f->pkt_offset > out_size)
+        return -1;
+
+    uint8_t *dst = out;
+    if (f->use_preamble) {
+        AV_WL16(dst + 0, SYNCWORD1);
+        AV_WL16(dst + 2, SYNCWORD2);
+        AV_WL16(dst + 4, f->data_type);
+        AV_WL16(dst + 6, f->length_code);
+        dst += BURST_HEADER_SIZE;
+    }
+    // The prefix has an even size, so swapping it separately is the same
+    if (f->prefix_bytes)
+        dst = put_payload(f, dst, f->prefix, f->prefix_bytes);
+    dst = put_payload(f, dst, f->out_buf, f->out_bytes);
+    memset(dst, 0, padding);
+    return dst + padding - out;
+}
@@ -0,0 +1,49 @@
+/*
+ * This file is part of mpv.
+ *
+ * mpv is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * mpv is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with mpv.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MPLAYER_IEC61937_H
+#define MPLAYER_IEC61937_H
+
+#include <stdint.h>
+
+/* IEC 61937 framing of compressed audio for S/PDIF and HDMI passthrough.
+ *
+ * Each packet (one parsed audio frame) is wrapped into a data burst: a burst
+ * preamble, the payload as 16 bit little endian words, and zero padding up to
+ * the repetition period of the format. E-AC3 and TrueHD frames are collected
+ * into larger bursts first. The output is the same as libavformat's "spdif"
+ * muxer with default options (plus dtshd_rate), but written directly into the
+ * caller's buffer.
+ *
+ * Supported codecs: AC3, E-AC3, DTS (core, or DTS-HD with dtshd_rate), TrueHD,
+ * AAC (ADTS) and MPEG audio layer 1-3.
+ */
+
+struct iec61937;
+
+// codec is an enum AVCodecID. dtshd_rate is the IEC 60958 rate used for
+// DTS-HD (type IV) output, 0 to output the DTS core only.
+// Returns NULL if the codec is not supported.
+struct iec61937 *iec61937_create(void *talloc_ctx, int codec, int dtshd_rate);
+
+// Frame one packet into out. Returns the number of bytes written (the burst
+// size, or 0 if the packet was buffered to be sent with the next ones), or -1
+// on error (invalid packet, or out_size too small for the burst).
+int iec61937_frame(struct iec61937 *f, const uint8_t *data, int size,
+                   uint8_t *out, int out_size);
+
+#endif /* MPLAYER_IEC61937_H */
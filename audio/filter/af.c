@@ -37,11 +37,13 @@ extern struct af_info af_info_surround;
 extern struct af_info af_info_sub;
 extern struct af_info af_info_export;
 extern struct af_info af_info_drc;
+extern struct af_info af_info_loudnorm;
 extern struct af_info af_info_extrastereo;
 extern struct af_info af_info_lavcac3enc;
 extern struct af_info af_info_lavrresample;
 extern struct af_info af_info_sweep;
 extern struct af_info af_info_hrtf;
+extern struct af_info af_info_convolve;
 extern struct af_info af_info_ladspa;
 extern struct af_info af_info_center;
 extern struct af_info af_info_sinesuppress;
@@ -64,11 +66,13 @@ static struct af_info* filter_list[] = {
     &af_info_export,
 #endif
     &af_info_drc,
+    &af_info_loudnorm,
     &af_info_extrastereo,
     &af_info_lavcac3enc,
     &af_info_lavrresample,
     &af_info_sweep,
     &af_info_hrtf,
+    &af_info_convolve,
 #ifdef CONFIG_LADSPA
     &af_info_ladspa,
 #endif
@@ -684,6 +688,11 @@ double af_calc_filter_multiplier(struct af_stream *s)
     return mul;
 }
 
+bool af_is_passthrough(struct af_stream *s)
+{
+    return s->first->next == s->last;
+}
+
 /* Calculate the total delay [bytes output] caused by the filters */
 double af_calc_delay(struct af_stream *s)
 {
@@ -194,6 +194,12 @@ struct af_instance *af_control_any_rev(struct af_stream *s, int cmd, void *arg);
  */
 double af_calc_filter_multiplier(struct af_stream *s);
 
+/**
+ * \brief check whether the chain contains no filters
+ * \return true if af_play() returns its input unchanged
+ */
+bool af_is_passthrough(struct af_stream *s);
+
 /**
  * \brief Calculate the total delay caused by the filters
  * \return delay in bytes of "missing" output
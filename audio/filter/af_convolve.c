@@ -0,0 +1,280 @@
+/*
+ * Convolution with an impulse response loaded from a WAV file (e.g. room
+ * reverb or measured headphone HRIRs).
+ *
+ * This file is part of mpv.
+ *
+ * mpv is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * mpv is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with mpv.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+
+#include <libavutil/common.h>
+#include <libavutil/intfloat.h>
+#include <libavutil/intreadwrite.h>
+
+#include "talloc.h"
+#include "af.h"
+#include "fftconv.h"
+#include "core/subopt-helper.h"
+
+// Longest accepted impulse response, in samples
+#define MAX_IR_LEN (1 << 22)
+
+struct af_convolve {
+    char *file;
+    float gain;         // dB
+    int block;          // block size of the convolution, 0 for automatic
+    float **ir;         // [ir_nch][ir_len]
+    int ir_nch, ir_len, ir_rate;
+    struct fftconv *conv;
+};
+
+/* Read a RIFF WAVE file with 16/24/32 bit integer or 32 bit float PCM into
+ * planar float arrays (allocated with talloc as children of the returned
+ * array). Returns NULL on error.
+ */
+static float **load_wav(const char *filename, int *out_nch, int *out_len,
+                        int *out_rate)
+{
+    FILE *f = fopen(filename, "rb");
+    if (!f) {
+        mp_msg(MSGT_AFILTER, MSGL_ERR, "[convolve] Can't open %s\n", filename);
+        return NULL;
+    }
+    float **res = NULL;
+    uint8_t *data = NULL;
+    uint8_t hdr[12];
+    int tag = 0, nch = 0, rate = 0, bits = 0;
+    uint32_t data_size;
+    if (fread(hdr, 12, 1, f) != 1 || memcmp(hdr, "RIFF", 4) ||
+        memcmp(hdr + 8, "WAVE", 4))
+        goto error;
+    while (1) {
+        uint8_t chunk[8];
+        if (fread(chunk, 8, 1, f) != 1)
+            goto error;
+        uint32_t size = AV_RL32(chunk + 4);
+        if (!memcmp(chunk, "fmt ", 4)) {
+            uint8_t fmt[40] = {0};
+            if (size < 16 || fread(fmt, FFMIN(size, 40), 1, f) != 1)
+                goto error;
+            tag  = AV_RL16(fmt);
+            nch  = AV_RL16(fmt + 2);
+            rate = AV_RL32(fmt + 4);
+            bits = AV_RL16(fmt + 14);
+            // WAVE_FORMAT_EXTENSIBLE: the format tag starts the sub format
+            if (tag == 0xFFFE && size >= 40)
+                tag = AV_RL16(fmt + 24);
+            if (size > 40)
+                fseek(f, size - 40, SEEK_CUR);
+            if (size & 1)
+                fseek(f, 1, SEEK_CUR);
+        } else if (!memcmp(chunk, "data", 4)) {
+            data_size = size;
+            break;
+        } else {
+            fseek(f, size + (size & 1), SEEK_CUR);
+        }
+    }
+    int bps = bits / 8;
+    if (nch < 1 || rate < 1 || !((tag == 1 && bps >= 2 && bps <= 4) ||
+                                 (tag == 3 && bps == 4)))
+    {
+        mp_msg(MSGT_AFILTER, MSGL_ERR, "[convolve] %s: unsupported format "
+               "(only 16/24/32 bit PCM and 32 bit float are supported)\n",
+               filename);
+        goto done;
+    }
+    // Read up to the end of the file if the data chunk size is bogus
+    long pos = ftell(f);
+    fseek(f, 0, SEEK_END);
+    long left = ftell(f) - pos;
+    fseek(f, pos, SEEK_SET);
+    if (left < 0)
+        goto error;
+    if (!data_size || data_size > left)
+        data_size = left;
+    int len = FFMIN(data_size / (bps * nch), MAX_IR_LEN);
+    if (len < 1)
+        goto error;
+    data = malloc((size_t)len * bps * nch);
+    if (!data || fread(data, (size_t)len * bps * nch, 1, f) != 1)
+        goto error;
+
+    res = talloc_array(NULL, float *, nch);
+    for (int c = 0; c < nch; c++) {
+        res[c] = talloc_array(res, float, len);
+        for (int n = 0; n < len; n++) {
+            uint8_t *p = data + ((size_t)n * nch + c) * bps;
+            float v;
+            if (tag == 3) {
+                v = av_int2float(AV_RL32(p));
+            } else if (bps == 2) {
+                v = (int16_t)AV_RL16(p) / (float)(1 << 15);
+            } else if (bps == 3) {
+                v = ((int32_t)(AV_RL24(p) << 8) >> 8) / (float)(1 << 23);
+            } else {
+                v = (int32_t)AV_RL32(p) / (float)(1U << 31);
+            }
+            res[c][n] = v;
+        }
+    }
+    *out_nch = nch;
+    *out_len = len;
+    *out_rate = rate;
+    goto done;
+
+error:
+    mp_msg(MSGT_AFILTER, MSGL_ERR, "[convolve] %s: not a valid WAV file\n",
+           filename);
+done:
+    free(data);
+    fclose(f);
+    return res;
+}
+
+// Initialization and runtime control
+static int control(struct af_instance *af, int cmd, void *arg)
+{
+    struct af_convolve *s = af->setup;
+    switch (cmd) {
+    case AF_CONTROL_REINIT: {
+        struct mp_audio *in = arg;
+        mp_audio_copy_config(af->data, in);
+        mp_audio_set_format(af->data, AF_FORMAT_FLOAT_NE);
+        int nch = af->data->nch;
+
+        if (s->ir_nch != 1 && s->ir_nch != nch && s->ir_nch != nch * nch) {
+            mp_msg(MSGT_AFILTER, MSGL_ERR, "[convolve] The impulse response "
+                   "has %d channels, which doesn't match %d channel audio.\n",
+                   s->ir_nch, nch);
+            return AF_ERROR;
+        }
+        if (s->ir_rate != af->data->rate) {
+            mp_msg(MSGT_AFILTER, MSGL_WARN, "[convolve] The impulse response "
+                   "has %d Hz, but the audio has %d Hz.\n", s->ir_rate,
+                   af->data->rate);
+        }
+
+        int block = s->block;
+        if (!block) {
+            // Trade latency for fewer partitions with long responses
+            block = 64;
+            while (block < 4096 && block * 8 < s->ir_len)
+                block *= 2;
+        }
+        fftconv_destroy(s->conv);
+        s->conv = fftconv_create(block, nch, nch, s->ir_len);
+        if (!s->conv)
+            return AF_ERROR;
+        float gain = pow(10.0, s->gain / 20.0);
+        for (int i = 0; i < nch; i++) {
+            for (int o = 0; o < nch; o++) {
+                const float *ir = NULL;
+                if (s->ir_nch == nch * nch)
+                    ir = s->ir[i * nch + o];
+                else if (i == o)
+                    ir = s->ir[s->ir_nch == 1 ? 0 : i];
+                if (ir && fftconv_add_ir(s->conv, i, o, ir, s->ir_len, gain))
+                    return AF_ERROR;
+            }
+        }
+        af->delay = fftconv_latency(s->conv) * nch * af->data->bps;
+        mp_msg(MSGT_AFILTER, MSGL_V, "[convolve] %d samples, %d channels, "
+               "block size %d\n", s->ir_len, s->ir_nch, block);
+        return af_test_output(af, in);
+    }
+    case AF_CONTROL_COMMAND_LINE: {
+        const opt_t subopts[] = {
+            {"file",    OPT_ARG_MSTRZ, &s->file,   NULL},
+            {"gain",    OPT_ARG_FLOAT, &s->gain,   NULL},
+            {"block",   OPT_ARG_INT,   &s->block,  NULL},
+            {NULL}
+        };
+        if (subopt_parse(arg, subopts) != 0) {
+            mp_msg(MSGT_AFILTER, MSGL_ERR, "[convolve] Invalid option "
+                   "specified.\n");
+            return AF_ERROR;
+        }
+        if (s->block && (s->block < 8 || s->block > 32768 ||
+                         (s->block & (s->block - 1))))
+        {
+            mp_msg(MSGT_AFILTER, MSGL_ERR, "[convolve] block must be a power "
+                   "of 2 between 8 and 32768.\n");
+            return AF_ERROR;
+        }
+        if (!s->file) {
+            mp_msg(MSGT_AFILTER, MSGL_ERR, "[convolve] No file given.\n");
+            return AF_ERROR;
+        }
+        talloc_free(s->ir);
+        s->ir = load_wav(s->file, &s->ir_nch, &s->ir_len, &s->ir_rate);
+        return s->ir ? AF_OK : AF_ERROR;
+    }
+    }
+    return AF_UNKNOWN;
+}
+
+// Deallocate memory
+static void uninit(struct af_instance *af)
+{
+    struct af_convolve *s = af->setup;
+    if (s) {
+        fftconv_destroy(s->conv);
+        talloc_free(s->ir);
+        free(s->file);
+    }
+    free(af->setup);
+    free(af->data);
+}
+
+// Filter data through filter
+static struct mp_audio *play(struct af_instance *af, struct mp_audio *data)
+{
+    struct af_convolve *s = af->setup;
+    int nch = data->nch;
+    float *audio = data->audio;
+    fftconv_process(s->conv, audio, nch, audio, nch,
+                    data->len / (nch * sizeof(float)));
+    return data;
+}
+
+// Allocate memory and set function pointers
+static int af_open(struct af_instance *af)
+{
+    af->control = control;
+    af->uninit = uninit;
+    af->play = play;
+    af->mul = 1;
+    af->data = calloc(1, sizeof(struct mp_audio));
+    af->setup = calloc(1, sizeof(struct af_convolve));
+    if (af->data == NULL || af->setup == NULL)
+        return AF_ERROR;
+    return AF_OK;
+}
+
+// Description of this filter
+struct af_info af_info_convolve = {
+    "Convolution with an impulse response",
+    "convolve",
+    "",
+    "",
+    AF_FLAGS_REENTRANT,
+    af_open
+};
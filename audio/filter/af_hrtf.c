@@ -30,6 +30,7 @@
 
 #include "af.h"
 #include "dsp.h"
+#include "fftconv.h"
 
 /* HRTF filter coefficients and adjustable parameters */
 #include "af_hrtf.h"
@@ -69,27 +70,18 @@ typedef struct af_hrtf_s {
     /* Cyclic position on the ring buffer */
     int cyc_pos;
     int print_flag;
+    /* FFT convolution of the decoded channels (CONV_IN_*) into L, R */
+    struct fftconv *conv;
+    float *conv_in, *conv_out;
+    int conv_frames;
 } af_hrtf_t;
 
-/* Convolution on a ring buffer
- *    nx:	length of the ring buffer
- *    nk:	length of the convolution kernel
- *    sx:	ring buffer
- *    sk:	convolution kernel
- *    offset:	offset on the ring buffer, can be
- */
-static float conv(const int nx, const int nk, const float *sx, const float *sk,
-		  const int offset)
-{
-    /* k = reminder of offset / nx */
-    int k = offset >= 0 ? offset % nx : nx + (offset % nx);
-
-    if(nk + k <= nx)
-	return af_filter_fir(nk, sx + k, sk);
-    else
-	return af_filter_fir(nk + k - nx, sx, sk + nx - k) +
-	    af_filter_fir(nx - k, sx + k, sk);
-}
+/* Inputs of the convolution, one frame per sample */
+enum {
+    CONV_IN_LF, CONV_IN_RF, CONV_IN_LR, CONV_IN_RR, CONV_IN_CF, CONV_IN_CR,
+    CONV_IN_BA_L, CONV_IN_BA_R, CONV_IN_LFE,
+    CONV_NUM_IN
+};
 
 /* Detect when the impulse response starts (significantly) */
 static int pulse_detect(const float *sx)
@@ -281,6 +273,69 @@ static inline void update_ch(af_hrtf_t *s, short *in, const int k)
     s->ba_r[k] = in[4] + in[1] + in[3];
 }
 
+/* Add a HRTF to the convolution: the same side response from in_l to L and
+   in_r to R, or the opposite side response from in_l to R and in_r to L.
+   As with the reference (128 samples long) impulse response, the part
+   before offset is skipped, which delays the filter by offset samples. */
+static int add_hrtf(af_hrtf_t *s, int in_l, int in_r, int opposite,
+		    const float *filt, int offset, float gain)
+{
+    float ir[128] = {0};
+
+    memcpy(ir + offset, filt + offset, s->hrflen * sizeof(float));
+    gain *= AMPLNORM;
+    if(fftconv_add_ir(s->conv, in_l, opposite, ir, offset + s->hrflen, gain) ||
+       fftconv_add_ir(s->conv, in_r, !opposite, ir, offset + s->hrflen, gain))
+	return -1;
+    return 0;
+}
+
+/* Set up the convolution for the current decoding mode. All of the mixing
+   into L, R is linear, so it's done by the convolution: the HRTF mixer
+   filter matrix, the bass compensation and the LFE channel, including the
+   amplitude renormalization. */
+static int init_conv(af_hrtf_t *s)
+{
+    const float rear_gain = s->matrix_mode ? M1_76DB : 1;
+    const float lfe_ir = M3_01DB;
+    int err = 0;
+
+    fftconv_destroy(s->conv);
+    s->conv = fftconv_create(HRTFCONVBLOCK, CONV_NUM_IN, 2,
+			     FFMAX(128, s->basslen));
+    if(!s->conv)
+	return -1;
+
+    err |= add_hrtf(s, CONV_IN_LF, CONV_IN_RF, 0, af_filt, s->af_o, 1);
+    err |= add_hrtf(s, CONV_IN_LF, CONV_IN_RF, 1, of_filt, s->of_o, 1);
+    if(s->decode_mode != HRTF_MIX_STEREO) {
+	err |= add_hrtf(s, CONV_IN_LR, CONV_IN_RR, 0, ar_filt, s->ar_o,
+			rear_gain);
+	err |= add_hrtf(s, CONV_IN_LR, CONV_IN_RR, 1, or_filt, s->or_o,
+			rear_gain);
+	/* The center channels are mixed into both sides */
+	err |= add_hrtf(s, CONV_IN_CF, CONV_IN_CF, 0, cf_filt, s->cf_o, 1);
+	if(s->matrix_mode)
+	    err |= add_hrtf(s, CONV_IN_CR, CONV_IN_CR, 0, cr_filt, s->cr_o,
+			    M1_76DB);
+    }
+
+    /* Bass compensation, with cross talk between L and R */
+    err |= fftconv_add_ir(s->conv, CONV_IN_BA_L, 0, s->ba_ir, s->basslen,
+			  (1 - BASSCROSS) * AMPLNORM);
+    err |= fftconv_add_ir(s->conv, CONV_IN_BA_R, 0, s->ba_ir, s->basslen,
+			  BASSCROSS * AMPLNORM);
+    err |= fftconv_add_ir(s->conv, CONV_IN_BA_R, 1, s->ba_ir, s->basslen,
+			  (1 - BASSCROSS) * AMPLNORM);
+    err |= fftconv_add_ir(s->conv, CONV_IN_BA_L, 1, s->ba_ir, s->basslen,
+			  BASSCROSS * AMPLNORM);
+
+    err |= fftconv_add_ir(s->conv, CONV_IN_LFE, 0, &lfe_ir, 1, AMPLNORM);
+    err |= fftconv_add_ir(s->conv, CONV_IN_LFE, 1, &lfe_ir, 1, AMPLNORM);
+
+    return err ? -1 : 0;
+}
+
 /* Initialization and runtime control */
 static int control(struct af_instance *af, int cmd, void* arg)
 {
@@ -312,6 +367,13 @@ static int control(struct af_instance *af, int cmd, void* arg)
         mp_audio_set_format(af->data, AF_FORMAT_S16_NE);
 	test_output_res = af_test_output(af, (struct mp_audio*)arg);
 	af->mul = 2.0 / af->data->nch;
+	if(init_conv(s) < 0) {
+	    mp_msg(MSGT_AFILTER, MSGL_ERR, "[hrtf] Unable to set up the "
+		   "convolution.\n");
+	    return AF_ERROR;
+	}
+	/* The convolution delays the output by a block */
+	af->delay = fftconv_latency(s->conv) * af->data->nch * af->data->bps;
 	// after testing input set the real output format
         mp_audio_set_num_channels(af->data, 2);
 	s->print_flag = 1;
@@ -362,6 +424,9 @@ static void uninit(struct af_instance *af)
 	free(s->fwrbuf_r);
 	free(s->fwrbuf_lr);
 	free(s->fwrbuf_rr);
+	free(s->conv_in);
+	free(s->conv_out);
+	fftconv_destroy(s->conv);
 	free(af->setup);
     }
     if(af->data)
@@ -386,8 +451,10 @@ static struct mp_audio* play(struct af_instance *af, struct mp_audio *data)
     short *in = data->audio; // Input audio data
     short *out = NULL; // Output audio data
     short *end = in + data->len / sizeof(short); // Loop end
-    float common, left, right, diff, left_b, right_b;
-    const int dblen = s->dlbuflen, hlen = s->hrflen, blen = s->basslen;
+    int frames = data->len / data->nch / sizeof(short);
+    float *conv_in;
+    float left, right, diff;
+    int i;
 
     if(AF_OK != RESIZE_LOCAL_BUFFER(af, data))
 	return NULL;
@@ -425,6 +492,21 @@ static struct mp_audio* play(struct af_instance *af, struct mp_audio *data)
 
     out = af->data->audio;
 
+    if(frames > s->conv_frames) {
+	float *conv_in = realloc(s->conv_in,
+				 frames * CONV_NUM_IN * sizeof(float));
+	float *conv_out = realloc(s->conv_out, frames * 2 * sizeof(float));
+	if(conv_in)
+	    s->conv_in = conv_in;
+	if(conv_out)
+	    s->conv_out = conv_out;
+	if(!conv_in || !conv_out) {
+	    mp_msg(MSGT_AFILTER, MSGL_FATAL, "[hrtf] Out of memory\n");
+	    return NULL;
+	}
+	s->conv_frames = frames;
+    }
+
     /* MPlayer's 5 channel layout (notation for the variable):
      *
      * 0: L (LF), 1: R (RF), 2: Ls (LR), 3: Rs (RR), 4: C (CF), matrix
@@ -443,6 +525,9 @@ static struct mp_audio* play(struct af_instance *af, struct mp_audio *data)
      * or: C = center, A = same side, O = opposite, F = front, R = rear
      */
 
+    /* Decode the input channels. The mixer filter matrix (see init_conv())
+       is applied to all of them at once afterwards. */
+    conv_in = s->conv_in;
     while(in < end) {
 	const int k = s->cyc_pos;
 
@@ -455,84 +540,49 @@ static struct mp_audio* play(struct af_instance *af, struct mp_audio *data)
 	s->lf[k] += CFECHOAMPL * s->cf[(k + CFECHODELAY) % s->dlbuflen];
 	s->rf[k] += CFECHOAMPL * s->cf[(k + CFECHODELAY) % s->dlbuflen];
 
-	switch (s->decode_mode) {
-	case HRTF_MIX_51:
-	case HRTF_MIX_MATRIX2CH:
-	   /* Mixer filter matrix */
-	   common = conv(dblen, hlen, s->cf, s->cf_ir, k + s->cf_o);
-	   if(s->matrix_mode) {
-	      /* In matrix decoding mode, the rear channel gain must be
-		 renormalized, as there is an additional channel. */
-	      matrix_decode(in, k, 2, 3, 0, s->dlbuflen,
-			    s->lr_fwr, s->rr_fwr,
-			    s->lrprr_fwr, s->lrmrr_fwr,
-			    &(s->adapt_lr_gain), &(s->adapt_rr_gain),
-			    &(s->adapt_lrprr_gain), &(s->adapt_lrmrr_gain),
-			    s->lr, s->rr, NULL, NULL, s->cr);
-	      common +=
-		 conv(dblen, hlen, s->cr, s->cr_ir, k + s->cr_o) *
-		 M1_76DB;
-	      left    =
-		 ( conv(dblen, hlen, s->lf, s->af_ir, k + s->af_o) +
-		   conv(dblen, hlen, s->rf, s->of_ir, k + s->of_o) +
-		   (conv(dblen, hlen, s->lr, s->ar_ir, k + s->ar_o) +
-		    conv(dblen, hlen, s->rr, s->or_ir, k + s->or_o)) *
-		   M1_76DB + common);
-	      right   =
-		 ( conv(dblen, hlen, s->rf, s->af_ir, k + s->af_o) +
-		   conv(dblen, hlen, s->lf, s->of_ir, k + s->of_o) +
-		   (conv(dblen, hlen, s->rr, s->ar_ir, k + s->ar_o) +
-		    conv(dblen, hlen, s->lr, s->or_ir, k + s->or_o)) *
-		   M1_76DB + common);
-	   } else {
-	      left    =
-		 ( conv(dblen, hlen, s->lf, s->af_ir, k + s->af_o) +
-		   conv(dblen, hlen, s->rf, s->of_ir, k + s->of_o) +
-		   conv(dblen, hlen, s->lr, s->ar_ir, k + s->ar_o) +
-		   conv(dblen, hlen, s->rr, s->or_ir, k + s->or_o) +
-		   common);
-	      right   =
-		 ( conv(dblen, hlen, s->rf, s->af_ir, k + s->af_o) +
-		   conv(dblen, hlen, s->lf, s->of_ir, k + s->of_o) +
-		   conv(dblen, hlen, s->rr, s->ar_ir, k + s->ar_o) +
-		   conv(dblen, hlen, s->lr, s->or_ir, k + s->or_o) +
-		   common);
-	   }
-	   break;
-	case HRTF_MIX_STEREO:
-	   left    =
-	      ( conv(dblen, hlen, s->lf, s->af_ir, k + s->af_o) +
-		conv(dblen, hlen, s->rf, s->of_ir, k + s->of_o));
-	   right   =
-	      ( conv(dblen, hlen, s->rf, s->af_ir, k + s->af_o) +
-		conv(dblen, hlen, s->lf, s->of_ir, k + s->of_o));
-	   break;
-	default:
-	    /* make gcc happy */
-	    left = 0.0;
-	    right = 0.0;
-	    break;
+	if(s->matrix_mode && s->decode_mode != HRTF_MIX_STEREO) {
+	    /* In matrix decoding mode, the rear channel gain must be
+	       renormalized, as there is an additional channel (done by
+	       the filter matrix). */
+	    matrix_decode(in, k, 2, 3, 0, s->dlbuflen,
+			  s->lr_fwr, s->rr_fwr,
+			  s->lrprr_fwr, s->lrmrr_fwr,
+			  &(s->adapt_lr_gain), &(s->adapt_rr_gain),
+			  &(s->adapt_lrprr_gain), &(s->adapt_lrmrr_gain),
+			  s->lr, s->rr, NULL, NULL, s->cr);
 	}
 
+	conv_in[CONV_IN_LF] = s->lf[k];
+	conv_in[CONV_IN_RF] = s->rf[k];
+	conv_in[CONV_IN_LR] = s->lr[k];
+	conv_in[CONV_IN_RR] = s->rr[k];
+	conv_in[CONV_IN_CF] = s->cf[k];
+	conv_in[CONV_IN_CR] = s->cr[k];
 	/* Bass compensation for the lower frequency cut of the HRTF.  A
 	   cross talk of the left and right channel is introduced to
 	   match the directional characteristics of higher frequencies.
 	   The bass will not have any real 3D perception, but that is
 	   OK (note at 180 Hz, the wavelength is about 2 m, and any
 	   spatial perception is impossible). */
-	left_b  = conv(dblen, blen, s->ba_l, s->ba_ir, k);
-	right_b = conv(dblen, blen, s->ba_r, s->ba_ir, k);
-	left  += (1 - BASSCROSS) * left_b  + BASSCROSS * right_b;
-	right += (1 - BASSCROSS) * right_b + BASSCROSS * left_b;
+	conv_in[CONV_IN_BA_L] = s->ba_l[k];
+	conv_in[CONV_IN_BA_R] = s->ba_r[k];
 	/* Also mix the LFE channel (if available) */
-	if(data->nch >= 6) {
-	    left  += in[5] * M3_01DB;
-	    right += in[5] * M3_01DB;
-	}
+	conv_in[CONV_IN_LFE] = data->nch >= 6 ? in[5] : 0;
+	conv_in += CONV_NUM_IN;
 
-	/* Amplitude renormalization. */
-	left  *= AMPLNORM;
-	right *= AMPLNORM;
+	/* Next sample... */
+	in = &in[data->nch];
+	(s->cyc_pos)--;
+	if(s->cyc_pos < 0)
+	    s->cyc_pos += s->dlbuflen;
+    }
+
+    fftconv_process(s->conv, s->conv_in, CONV_NUM_IN, s->conv_out, 2, frames);
+
+    for(i = 0; i < frames; i++) {
+	/* Already renormalized */
+	left  = s->conv_out[2 * i];
+	right = s->conv_out[2 * i + 1];
 
 	switch (s->decode_mode) {
 	case HRTF_MIX_51:
@@ -554,12 +604,7 @@ static struct mp_audio* play(struct af_instance *af, struct mp_audio *data)
 	   break;
 	}
 
-	/* Next sample... */
-	in = &in[data->nch];
 	out = &out[af->data->nch];
-	(s->cyc_pos)--;
-	if(s->cyc_pos < 0)
-	    s->cyc_pos += dblen;
     }
 
     /* Set output data */
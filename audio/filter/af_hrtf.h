@@ -33,6 +33,7 @@
 
 #define DELAYBUFLEN	1024	/* Length of the delay buffer */
 #define HRTFFILTLEN	64	/* HRTF filter length */
+#define HRTFCONVBLOCK	128	/* FFT convolution block length (latency) */
 #define IRTHRESH	0.001	/* Impulse response pruning thresh. */
 
 #define AMPLNORM	M6_99DB	/* Overall amplitude renormalization */
@@ -28,6 +28,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdbool.h>
 
 #include <inttypes.h>
 #include <math.h>
@@ -36,11 +37,22 @@
 #include <dlfcn.h>
 #include <ladspa.h>
 
+#include <libavutil/common.h>
+
 /* ------------------------------------------------------------------------- */
 
 /* Local Includes */
 
 #include "af.h"
+#include "osdep/timer.h"
+
+/* ------------------------------------------------------------------------- */
+
+/* Number of frames the plugins process at once. Larger chunks of audio are
+ * split into blocks of this size, so the buffers never need to be resized.
+ */
+
+#define LADSPA_BLOCK_SIZE 1024
 
 /* ------------------------------------------------------------------------- */
 
@@ -56,11 +68,6 @@ typedef struct af_ladspa_s
                      *   the data unchanged.
                      */
 
-    int activated;  /**< 0 or 1. Activate LADSPA filters only once, even
-                     *   if the buffers get resized, to avoid a stuttering
-                     *   filter.
-                     */
-
     char *file;
     char *label;
 
@@ -86,10 +93,15 @@ typedef struct af_ladspa_s
     float *outputcontrols;
 
     int nch;                /**< number of channels */
-    int bufsize;
-    float **inbufs;
+    int rate;
+    int inplace;            /**< outbufs are the same as inbufs */
+    float **inbufs;         /**< LADSPA_BLOCK_SIZE frames per channel */
     float **outbufs;
     LADSPA_Handle *chhandles;
+    bool *chactive;         /**< activate() was called on the instance */
+
+    int64_t *run_time;      /**< time spent in run(), per instance [us] */
+    int64_t frames_run;
 
 } af_ladspa_t;
 
@@ -97,6 +109,7 @@ typedef struct af_ladspa_s
 
 static int af_open(struct af_instance *af);
 static int af_ladspa_malloc_failed(char*);
+static void af_ladspa_free_instances(af_ladspa_t *setup);
 
 /* ------------------------------------------------------------------------- */
 
@@ -656,20 +669,12 @@ static void uninit(struct af_instance *af) {
     free(af->data);
     if (af->setup) {
         af_ladspa_t *setup = (af_ladspa_t*) af->setup;
-        const LADSPA_Descriptor *pdes = setup->plugin_descriptor;
 
-        if (setup->myname) {
+        if (setup->myname)
             mp_msg(MSGT_AFILTER, MSGL_V, "%s: cleaning up\n", setup->myname);
-            free(setup->myname);
-        }
 
-        if (setup->chhandles) {
-            for (int i = 0; i < setup->nch; i+=setup->ninputs) {
-                if (pdes->deactivate) pdes->deactivate(setup->chhandles[i]);
-                if (pdes->cleanup) pdes->cleanup(setup->chhandles[i]);
-            }
-            free(setup->chhandles);
-        }
+        af_ladspa_free_instances(setup);
+        free(setup->myname);
 
         free(setup->file);
         free(setup->label);
@@ -680,18 +685,6 @@ static void uninit(struct af_instance *af) {
         free(setup->inputs);
         free(setup->outputs);
 
-        if (setup->inbufs) {
-            for(int i = 0; i < setup->nch; i++)
-                free(setup->inbufs[i]);
-            free(setup->inbufs);
-        }
-
-        if (setup->outbufs) {
-            for (int i = 0; i < setup->nch; i++)
-                free(setup->outbufs[i]);
-            free(setup->outbufs);
-        }
-
         if (setup->libhandle)
             dlclose(setup->libhandle);
 
@@ -702,171 +695,267 @@ static void uninit(struct af_instance *af) {
 
 /* ------------------------------------------------------------------------- */
 
-/** \brief Process chunk of audio data through the selected LADSPA Plugin.
+/** \brief Print the time spent in the plugin instances, and free them.
  *
- * \param af    Pointer to audio filter instance
- * \param data  Pointer to chunk of audio data
+ * Deactivates and cleans up the plugin instances, and frees the buffers.
+ * Also used to clean up after af_ladspa_create_instances() failed halfway,
+ * so instances may be missing or not activated.
  *
- * \return      Either AF_ERROR or AF_OK
+ * \param setup     Current setup of the filter
+ *
+ * \return  No return value.
  */
 
-static struct mp_audio* play(struct af_instance *af, struct mp_audio *data) {
-    af_ladspa_t *setup = af->setup;
+static void af_ladspa_free_instances(af_ladspa_t *setup) {
     const LADSPA_Descriptor *pdes = setup->plugin_descriptor;
-    float *audio = (float*)data->audio;
-    int nsamples = data->len/4; /* /4 because it's 32-bit float */
-    int nch = data->nch;
-    int rate = data->rate;
-    int i, p;
+    double duration = setup->rate ? setup->frames_run / (double)setup->rate : 0;
+    int i;
 
-    if (setup->status !=AF_OK)
-        return data;
+    if (setup->chhandles) {
+        for (i=0; i<setup->nch; i+=setup->ninputs) {
+            if (!setup->chhandles[i])
+                continue;
+            /* wall-clock time, which includes time the thread was preempted */
+            if (duration > 0) {
+                double elapsed = setup->run_time[i] / 1e6;
+                mp_msg(MSGT_AFILTER, MSGL_V, "%s: instance %d: %.3f s elapsed "
+                       "for %.3f s of audio (%.2f%%)\n", setup->myname,
+                       i / setup->ninputs, elapsed, duration,
+                       elapsed / duration * 100);
+            }
+            if (pdes->deactivate && setup->chactive && setup->chactive[i])
+                pdes->deactivate(setup->chhandles[i]);
+            if (pdes->cleanup) pdes->cleanup(setup->chhandles[i]);
+        }
+        free(setup->chhandles);
+        setup->chhandles = NULL;
+    }
+    free(setup->chactive);
+    setup->chactive = NULL;
+
+    if (setup->inbufs) {
+        for (i=0; i<setup->nch; i++)
+            free(setup->inbufs[i]);
+        free(setup->inbufs);
+        setup->inbufs = NULL;
+    }
+    if (setup->outbufs) {
+        if (!setup->inplace) {
+            for (i=0; i<setup->nch; i++)
+                free(setup->outbufs[i]);
+        }
+        free(setup->outbufs);
+        setup->outbufs = NULL;
+    }
 
-    /* See if it's the first call. If so, setup inbufs/outbufs, instantiate
-     * plugin, connect ports and activate plugin
-     */
+    free(setup->run_time);
+    setup->run_time = NULL;
+    setup->frames_run = 0;
+    setup->nch = 0;
+}
 
-    /* 2004-12-07: Also check if the buffersize has to be changed!
-     *             data->len is not constant per se! re-init buffers.
-     */
+/* ------------------------------------------------------------------------- */
 
-    if ( (setup->bufsize != nsamples/nch) || (setup->nch != nch) ) {
+/** \brief Instantiate the plugin and connect it to the buffers.
+ *
+ * One instance is created per channel, or per pair of channels for stereo
+ * effects. If the plugin can process in place, the same buffer is used as
+ * input and output of each channel.
+ *
+ * \param setup     Current setup of the filter
+ * \param nch       Number of channels
+ * \param rate      Sample rate
+ *
+ * \return  Either AF_ERROR or AF_OK
+ */
 
-        /* if setup->nch==0, it's the first call, if not, something has
-         * changed and all previous mallocs have to be freed
-         */
+static int af_ladspa_create_instances(af_ladspa_t *setup, int nch, int rate) {
+    const LADSPA_Descriptor *pdes = setup->plugin_descriptor;
+    int i, p;
 
-        if (setup->nch != 0) {
-            mp_msg(MSGT_AFILTER, MSGL_DBG3, "%s: bufsize change; free old buffer\n",
-                                                                setup->myname);
+    af_ladspa_free_instances(setup);
 
-            if(setup->inbufs) {
-                for(i=0; i<setup->nch; i++)
-                    free(setup->inbufs[i]);
-                free(setup->inbufs);
-            }
-            if(setup->outbufs) {
-                for(i=0; i<setup->nch; i++)
-                    free(setup->outbufs[i]);
-                free(setup->outbufs);
-            }
-        } /* everything is freed */
+    /* With a stereo effect and an odd number of channels, both outputs of
+     * the last instance write the same buffer, see below.
+     */
+    setup->inplace = !LADSPA_IS_INPLACE_BROKEN(pdes->Properties) &&
+                     nch % setup->ninputs == 0;
+    setup->nch = nch;
+    setup->rate = rate;
+
+    setup->inbufs = calloc(nch, sizeof(float*));
+    setup->outbufs = calloc(nch, sizeof(float*));
+    setup->chhandles = calloc(nch, sizeof(LADSPA_Handle));
+    setup->chactive = calloc(nch, sizeof(bool));
+    setup->run_time = calloc(nch, sizeof(int64_t));
+    if (!setup->inbufs || !setup->outbufs || !setup->chhandles ||
+        !setup->chactive || !setup->run_time)
+        return af_ladspa_malloc_failed(setup->myname);
+
+    mp_msg(MSGT_AFILTER, MSGL_V, "%s: %d channels, block size %d%s\n",
+           setup->myname, nch, LADSPA_BLOCK_SIZE,
+           setup->inplace ? ", in place" : "");
+
+    for(i=0; i<nch; i++) {
+        setup->inbufs[i] = calloc(LADSPA_BLOCK_SIZE, sizeof(float));
+        setup->outbufs[i] = setup->inplace ? setup->inbufs[i] :
+                            calloc(LADSPA_BLOCK_SIZE, sizeof(float));
+        if (!setup->inbufs[i] || !setup->outbufs[i])
+            return af_ladspa_malloc_failed(setup->myname);
+    }
 
-        setup->bufsize = nsamples/nch;
-        setup->nch = nch;
+    /* create handles
+     * for stereo effects, create one handle for two channels
+     */
 
-        setup->inbufs = calloc(nch, sizeof(float*));
-        setup->outbufs = calloc(nch, sizeof(float*));
+    for(i=0; i<nch; i++) {
 
-        mp_msg(MSGT_AFILTER, MSGL_DBG3, "%s: bufsize = %d\n",
-                                        setup->myname, setup->bufsize);
+        if (i % setup->ninputs) { /* stereo effect */
+            /* copy the handle from previous channel */
+            setup->chhandles[i] = setup->chhandles[i-1];
+            continue;
+        }
 
-        for(i=0; i<nch; i++) {
-            setup->inbufs[i] = calloc(setup->bufsize, sizeof(float));
-            setup->outbufs[i] = calloc(setup->bufsize, sizeof(float));
+        setup->chhandles[i] = pdes->instantiate(pdes, rate);
+        if (!setup->chhandles[i]) {
+            mp_msg(MSGT_AFILTER, MSGL_ERR, "%s: %s\n", setup->myname,
+                                    _("Could not instantiate the plugin."));
+            return AF_ERROR;
         }
+    }
 
-        /* only on the first call, there are no handles. */
+    /* connect input/output ports for each channel/filter instance */
+
+    for(i=0; i<nch; i++) {
+        pdes->connect_port(setup->chhandles[i],
+                           setup->inputs[i % setup->ninputs],
+                           setup->inbufs[i]);
+        pdes->connect_port(setup->chhandles[i],
+                           setup->outputs[i % setup->ninputs],
+                           setup->outbufs[i]);
+
+        /* connect (input) controls */
+
+        for (p=0; p<setup->nports; p++) {
+            LADSPA_PortDescriptor d = pdes->PortDescriptors[p];
+            if (LADSPA_IS_PORT_CONTROL(d)) {
+                if (LADSPA_IS_PORT_INPUT(d)) {
+                    pdes->connect_port(setup->chhandles[i], p,
+                                            &(setup->inputcontrols[p]) );
+                } else {
+                    pdes->connect_port(setup->chhandles[i], p,
+                                            &(setup->outputcontrols[p]) );
+                }
+            }
+        }
 
-        if (!setup->chhandles) {
-            setup->chhandles = calloc(nch, sizeof(LADSPA_Handle));
+        if (i % setup->ninputs == 0) {
+            if (pdes->activate)
+                pdes->activate(setup->chhandles[i]);
+            setup->chactive[i] = true;
+        }
 
-            /* create handles
-             * for stereo effects, create one handle for two channels
-             */
+    } /* All channels/filters done! except for... */
 
-            for(i=0; i<nch; i++) {
+    /* Stereo effect with one channel left. Use same buffer for left
+     * and right. connect it to the second port.
+     */
 
-                if (i % setup->ninputs) { /* stereo effect */
-                    /* copy the handle from previous channel */
-                    setup->chhandles[i] = setup->chhandles[i-1];
-                    continue;
-                }
+    for (p = i; p % setup->ninputs; p++) {
+        pdes->connect_port(setup->chhandles[i-1],
+                           setup->inputs[p % setup->ninputs],
+                           setup->inbufs[i-1]);
+        pdes->connect_port(setup->chhandles[i-1],
+                           setup->outputs[p % setup->ninputs],
+                           setup->outbufs[i-1]);
+    } /* done! */
 
-                setup->chhandles[i] = pdes->instantiate(pdes, rate);
-            }
-        }
+    return AF_OK;
+}
 
-        /* connect input/output ports for each channel/filter instance
-         *
-         * always (re)connect ports
-         */
+/* ------------------------------------------------------------------------- */
 
-        for(i=0; i<nch; i++) {
-            pdes->connect_port(setup->chhandles[i],
-                               setup->inputs[i % setup->ninputs],
-                               setup->inbufs[i]);
-            pdes->connect_port(setup->chhandles[i],
-                               setup->outputs[i % setup->ninputs],
-                               setup->outbufs[i]);
-
-            /* connect (input) controls */
-
-            for (p=0; p<setup->nports; p++) {
-                LADSPA_PortDescriptor d = pdes->PortDescriptors[p];
-                if (LADSPA_IS_PORT_CONTROL(d)) {
-                    if (LADSPA_IS_PORT_INPUT(d)) {
-                        pdes->connect_port(setup->chhandles[i], p,
-                                                &(setup->inputcontrols[p]) );
-                    } else {
-                        pdes->connect_port(setup->chhandles[i], p,
-                                                &(setup->outputcontrols[p]) );
-                    }
-                }
-            }
+/** \brief Process chunk of audio data through the selected LADSPA Plugin.
+ *
+ * The audio is processed in blocks of at most LADSPA_BLOCK_SIZE frames.
+ *
+ * \param af    Audio filter instance
+ * \param data  Pointer to an mp_audio struct containing the audio data.
+ *
+ * \return      Either AF_ERROR or AF_OK
+ */
 
-            /* Activate filter (if it isn't already :) ) */
+static struct mp_audio* play(struct af_instance *af, struct mp_audio *data) {
+    af_ladspa_t *setup = af->setup;
+    const LADSPA_Descriptor *pdes = setup->plugin_descriptor;
+    float *audio = (float*)data->audio;
+    int nch = data->nch;
+    int nframes = data->len / 4 / nch; /* /4 because it's 32-bit float */
+    int i, p, pos;
 
-            if (pdes->activate && !setup->activated && i % setup->ninputs == 0)
-                pdes->activate(setup->chhandles[i]);
+    if (setup->status !=AF_OK)
+        return data;
 
-        } /* All channels/filters done! except for... */
-        setup->activated = 1;
+    /* Instantiate the plugin on the first call, or if the number of
+     * channels changed.
+     */
 
-        /* Stereo effect with one channel left. Use same buffer for left
-         * and right. connect it to the second port.
-         */
+    if (setup->nch != nch || setup->rate != data->rate) {
+        if (af_ladspa_create_instances(setup, nch, data->rate) != AF_OK) {
+            af_ladspa_free_instances(setup);
+            setup->status = AF_ERROR;
+            return data;
+        }
+    }
 
-        for (p = i; p % setup->ninputs; p++) {
-            pdes->connect_port(setup->chhandles[i-1],
-                               setup->inputs[p % setup->ninputs],
-                               setup->inbufs[i-1]);
-            pdes->connect_port(setup->chhandles[i-1],
-                               setup->outputs[p % setup->ninputs],
-                               setup->outbufs[i-1]);
-        } /* done! */
-
-    } /* setup for first call/change of bufsize is done.
-       * normal playing routine follows...
-       */
-
-    /* Right now, I use a separate input and output buffer.
-     * I could change this to in-place processing (inbuf==outbuf), but some
-     * ladspa filters are broken and are not able to handle that. This seems
-     * fast enough, so unless somebody complains, it stays this way :)
+    /* Mono audio with a mono in-place plugin: the plugin can work directly
+     * on the audio data, without any copying.
      */
 
-    /* Fill inbufs */
-
-    for (p=0; p<setup->bufsize; p++) {
-        for (i=0; i<nch; i++) {
-            setup->inbufs[i][p] = audio[p*nch + i];
+    if (nch == 1 && setup->ninputs == 1 && setup->inplace) {
+        for (pos = 0; pos < nframes; pos += LADSPA_BLOCK_SIZE) {
+            int n = FFMIN(nframes - pos, LADSPA_BLOCK_SIZE);
+            int64_t t = mp_time_us();
+            pdes->connect_port(setup->chhandles[0], setup->inputs[0],
+                               audio + pos);
+            pdes->connect_port(setup->chhandles[0], setup->outputs[0],
+                               audio + pos);
+            pdes->run(setup->chhandles[0], n);
+            setup->run_time[0] += mp_time_us() - t;
         }
+        setup->frames_run += nframes;
+        return data;
     }
 
-    /* Run filter(s) */
+    for (pos = 0; pos < nframes; pos += LADSPA_BLOCK_SIZE) {
+        int n = FFMIN(nframes - pos, LADSPA_BLOCK_SIZE);
+        float *block = audio + pos * nch;
 
-    for (i=0; i<nch; i+=setup->ninputs) {
-        pdes->run(setup->chhandles[i], setup->bufsize);
-    }
+        /* Fill inbufs */
+
+        for (p=0; p<n; p++) {
+            for (i=0; i<nch; i++) {
+                setup->inbufs[i][p] = block[p*nch + i];
+            }
+        }
+
+        /* Run filter(s) */
 
-    /* Extract outbufs */
+        for (i=0; i<nch; i+=setup->ninputs) {
+            int64_t t = mp_time_us();
+            pdes->run(setup->chhandles[i], n);
+            setup->run_time[i] += mp_time_us() - t;
+        }
+
+        /* Extract outbufs */
 
-    for (p=0; p<setup->bufsize; p++) {
-        for (i=0; i<nch; i++) {
-            audio[p*nch + i] = setup->outbufs[i][p];
+        for (p=0; p<n; p++) {
+            for (i=0; i<nch; i++) {
+                block[p*nch + i] = setup->outbufs[i][p];
+            }
         }
     }
+    setup->frames_run += nframes;
 
     /* done */
 
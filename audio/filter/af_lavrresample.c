@@ -23,6 +23,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <inttypes.h>
+#include <math.h>
 #include <libavutil/opt.h>
 #include <libavutil/audioconvert.h>
 #include <libavutil/common.h>
@@ -45,6 +46,7 @@
 #define avresample_convert(ctx, out, out_planesize, out_samples, in, in_planesize, in_samples) \
     swr_convert(ctx, out, out_samples, (const uint8_t**)(in), in_samples)
 #define avresample_set_channel_mapping swr_set_channel_mapping
+#define avresample_set_compensation swr_set_compensation
 #define USE_SET_CHANNEL_MAPPING 1
 #else
 #error "config.h broken"
@@ -80,8 +82,18 @@ struct af_resample {
     int reorder_in[MP_NUM_CHANNELS];
     int reorder_out[MP_NUM_CHANNELS];
     uint8_t *reorder_buffer;
+    // Input rate changes done with the resampler's compensation, see
+    // AF_CONTROL_RESAMPLE_INPUT_RATE
+    double comp_ratio;  // output samples per configured output sample
+    int comp_delta;
+    int comp_left;      // output samples until the compensation runs out
 };
 
+// Number of output samples a compensation is set for. It's renewed long
+// before it runs out. With 2^26, the largest possible rate change (192000 vs.
+// 8000 Hz) still fits into sample_delta.
+#define COMPENSATION_DISTANCE (1 << 26)
+
 #ifdef CONFIG_LIBAVRESAMPLE
 static int get_delay(struct af_resample *s)
 {
@@ -165,6 +177,9 @@ static int control(struct af_instance *af, int cmd, void *arg)
             avresample_close(s->avrctx);
             avresample_close(s->avrctx_out);
 
+            s->comp_ratio = 1;
+            s->comp_delta = 0;
+
             s->ctx.out_rate    = out->rate;
             s->ctx.in_rate     = in->rate;
             s->ctx.out_format  = out->format;
@@ -278,6 +293,23 @@ static int control(struct af_instance *af, int cmd, void *arg)
     case AF_CONTROL_RESAMPLE_RATE | AF_CONTROL_SET:
         out->rate = *(int *)arg;
         return AF_OK;
+    case AF_CONTROL_RESAMPLE_INPUT_RATE | AF_CONTROL_SET: {
+        // Compensation needs an active resampler, and changes the rate
+        // without flushing the filter state.
+        if (!s->ctx.in_rate || s->ctx.in_rate == s->ctx.out_rate)
+            return AF_FALSE;
+        double ratio = *(double *)arg / s->ctx.in_rate;
+        int delta = lrint(COMPENSATION_DISTANCE * (1 - ratio));
+        if (avresample_set_compensation(s->avrctx, delta,
+                                        COMPENSATION_DISTANCE) < 0)
+            return AF_FALSE;
+        s->comp_ratio = 1 / ratio;
+        s->comp_delta = delta;
+        s->comp_left  = COMPENSATION_DISTANCE;
+        af->mul = (double) (out->rate * out->nch) /
+                  (*(double *)arg * s->ctx.in_channels.num);
+        return AF_OK;
+    }
     }
     return AF_UNKNOWN;
 }
@@ -318,6 +350,8 @@ static struct mp_audio *play(struct af_instance *af, struct mp_audio *data)
     int out_samples = avresample_available(s->avrctx) +
         av_rescale_rnd(get_delay(s) + in_samples,
                        s->ctx.out_rate, s->ctx.in_rate, AV_ROUND_UP);
+    if (s->comp_ratio > 1)
+        out_samples = ceil(out_samples * s->comp_ratio) + 1;
     int out_size    = out->bps * out_samples * out->nch;
 
     if (talloc_get_size(out->audio) < out_size)
@@ -335,6 +369,15 @@ static struct mp_audio *play(struct af_instance *af, struct mp_audio *data)
             (uint8_t **) &out->audio, out_size, out_samples,
             (uint8_t **) &in->audio,  in_size,  in_samples);
 
+    if (s->comp_delta) {
+        s->comp_left -= FFMAX(out_samples, 0);
+        if (s->comp_left < COMPENSATION_DISTANCE / 2) {
+            avresample_set_compensation(s->avrctx, s->comp_delta,
+                                        COMPENSATION_DISTANCE);
+            s->comp_left = COMPENSATION_DISTANCE;
+        }
+    }
+
     *data = *out;
 
 #if USE_SET_CHANNEL_MAPPING
@@ -375,6 +418,7 @@ static int af_open(struct af_instance *af)
     };
 
     s->allow_detach = 1;
+    s->comp_ratio = 1;
 
     s->avrctx = avresample_alloc_context();
     s->avrctx_out = avresample_alloc_context();
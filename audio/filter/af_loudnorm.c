@@ -0,0 +1,561 @@
+/*
+ * Loudness normalization (EBU R128 / ITU-R BS.1770) with a lookahead
+ * true-peak limiter.
+ *
+ * This file is part of mpv.
+ *
+ * mpv is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * mpv is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with mpv.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* The input is measured with the BS.1770 meter: K-weighting, 400 ms blocks
+ * with 75% overlap, absolute gate at -70 LUFS and relative gate at -10 LU.
+ * The gated blocks are collected in a histogram, so the integrated loudness
+ * of the whole input so far can be computed cheaply.
+ *
+ * The normalization gain is either derived from the integrated loudness
+ * measured so far (mode=dynamic, changed slowly), or taken from ReplayGain
+ * or R128 tags, which the player passes with AF_CONTROL_REPLAYGAIN.
+ *
+ * The limiter estimates the true peak of the amplified signal with 4x
+ * oversampling (48 tap polyphase FIR, as in BS.1770 annex 2). The required
+ * gain reduction is held with a sliding minimum over the lookahead window and
+ * smoothed with a moving average of the same length, which makes the gain
+ * ramp down in time for each peak. The audio is delayed accordingly.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+
+#include <libavutil/common.h>
+
+#include "talloc.h"
+#include "af.h"
+#include "core/subopt-helper.h"
+
+// Oversampling of the true peak estimation, and taps per phase
+#define TP_PHASES 4
+#define TP_TAPS 12
+// Delay of the interpolated signal, in samples
+#define TP_DELAY (TP_TAPS / 2)
+
+// Histogram of the gated block loudness, in 0.1 LU steps from -70 LUFS
+#define HIST_MIN -70.0
+#define HIST_BINS 900
+
+// Number of 100 ms sub-blocks per 400 ms measurement block
+#define BLOCK_SUBBLOCKS 4
+// Gated blocks needed before mode=dynamic changes the gain (about 3 s)
+#define DYNAMIC_MIN_BLOCKS 30
+// Maximum change of the gain in mode=dynamic, dB per second
+#define DYNAMIC_SLEW 2.0
+
+enum {
+    MODE_DYNAMIC,
+    MODE_TRACK,
+    MODE_ALBUM,
+    MODE_LIMIT,
+};
+
+struct biquad {
+    double b0, b1, b2, a1, a2;
+};
+
+struct kw_state {
+    double s[4];
+};
+
+struct af_loudnorm {
+    // Options
+    char *mode_str;
+    float target;           // LUFS
+    float maxgain;          // dB
+    float ceiling;          // dBTP
+    float lookahead;        // ms
+    float release;          // ms
+    int mode;
+
+    struct af_replaygain tags;
+
+    // Meter
+    struct biquad kw[2];    // K-weighting: high shelf, high pass
+    struct kw_state *kw_state; // [nch], filter states
+    float *ch_weight;       // [nch]
+    int subblock_len;       // frames per 100 ms
+    int subblock_pos;
+    double subblock_energy; // weighted sum of squares of the current subblock
+    double recent[BLOCK_SUBBLOCKS]; // mean square of the last subblocks
+    int num_subblocks;
+    int64_t hist_count[HIST_BINS];
+    double hist_energy[HIST_BINS];
+    int64_t gated_blocks;
+    float max_peak;         // before limiting, linear
+
+    // Normalization gain
+    float gain_db;          // gain at the end of the current subblock
+    float gain;             // current linear gain
+    float gain_step;        // per frame, ramps to gain_db within the subblock
+
+    // Limiter
+    float tp_coeffs[TP_PHASES][TP_TAPS];
+    float **tp_hist;        // [nch], 2 * TP_TAPS (mirrored ring buffer)
+    int tp_pos;
+    int look;               // lookahead window, frames
+    float release_coef;
+    float ceiling_lin;
+    float rel_gain;         // gain after release, before hold
+    float *hold_val;        // [look], monotonic queue for the sliding minimum
+    int64_t *hold_idx;
+    int hold_head, hold_count;
+    int64_t frame;
+    float *box;             // [look], moving average of the held gain
+    int box_pos;
+    double box_sum;
+    float **delay;          // [nch], TP_DELAY + look - 1 frames
+    int delay_len, delay_pos;
+    float *peak;            // [subblock_len], scratch buffers
+    float *lim_gain;
+
+    void *alloc;            // talloc context of the per-format buffers
+};
+
+static void set_biquad(struct biquad *f, double b0, double b1, double b2,
+                       double a0, double a1, double a2)
+{
+    *f = (struct biquad){b0 / a0, b1 / a0, b2 / a0, a1 / a0, a2 / a0};
+}
+
+// K-weighting filter for any sample rate (BS.1770 gives the coefficients
+// for 48 kHz only; these are the analog prototypes they were derived from).
+static void init_k_weighting(struct af_loudnorm *s, int rate)
+{
+    double f0 = 1681.974450955533, q = 0.7071752369554196;
+    double k = tan(M_PI * f0 / rate);
+    double vh = pow(10.0, 3.999843853973347 / 20.0);
+    double vb = pow(vh, 0.4996667741545416);
+    set_biquad(&s->kw[0], vh + vb * k / q + k * k, 2 * (k * k - vh),
+               vh - vb * k / q + k * k, 1 + k / q + k * k, 2 * (k * k - 1),
+               1 - k / q + k * k);
+    f0 = 38.13547087602444;
+    q = 0.5003270373238773;
+    k = tan(M_PI * f0 / rate);
+    set_biquad(&s->kw[1], 1, -2, 1, 1 + k / q + k * k, 2 * (k * k - 1),
+               1 - k / q + k * k);
+}
+
+// Windowed sinc interpolator, each phase normalized to unity gain at DC
+static void init_true_peak(struct af_loudnorm *s)
+{
+    int len = TP_PHASES * TP_TAPS;
+    for (int p = 0; p < TP_PHASES; p++) {
+        double sum = 0;
+        for (int t = 0; t < TP_TAPS; t++) {
+            int k = t * TP_PHASES + p;
+            double x = (k - (len - 1) / 2.0) / TP_PHASES;
+            double w = 2 * M_PI * (k + 0.5) / len;
+            double v = (x ? sin(M_PI * x) / (M_PI * x) : 1) *
+                       (0.42 - 0.5 * cos(w) + 0.08 * cos(2 * w));
+            // tp_hist holds the newest sample last
+            s->tp_coeffs[p][TP_TAPS - 1 - t] = v;
+            sum += v;
+        }
+        for (int t = 0; t < TP_TAPS; t++)
+            s->tp_coeffs[p][t] /= sum;
+    }
+}
+
+static float channel_weight(int speaker)
+{
+    switch (speaker) {
+    case MP_SPEAKER_ID_LFE:
+    case MP_SPEAKER_ID_LFE2:
+        return 0;
+    case MP_SPEAKER_ID_BL:
+    case MP_SPEAKER_ID_BR:
+    case MP_SPEAKER_ID_SL:
+    case MP_SPEAKER_ID_SR:
+    case MP_SPEAKER_ID_SDL:
+    case MP_SPEAKER_ID_SDR:
+        return 1.41;
+    }
+    return 1;
+}
+
+static double energy_to_lufs(double e)
+{
+    return e > 0 ? -0.691 + 10 * log10(e) : -HUGE_VAL;
+}
+
+// Integrated loudness of the input so far, -HUGE_VAL if nothing was measured
+static double integrated_loudness(struct af_loudnorm *s)
+{
+    double sum = 0;
+    int64_t count = 0;
+    for (int n = 0; n < HIST_BINS; n++) {
+        sum += s->hist_energy[n];
+        count += s->hist_count[n];
+    }
+    if (!count)
+        return -HUGE_VAL;
+    double gate = energy_to_lufs(sum / count) - 10;
+    int start = av_clip(ceil((gate - HIST_MIN) * 10), 0, HIST_BINS);
+    sum = 0;
+    count = 0;
+    for (int n = start; n < HIST_BINS; n++) {
+        sum += s->hist_energy[n];
+        count += s->hist_count[n];
+    }
+    return count ? energy_to_lufs(sum / count) : -HUGE_VAL;
+}
+
+static float tag_gain(struct af_loudnorm *s)
+{
+    float gain = s->tags.track_gain;
+    if (s->mode == MODE_ALBUM && !isnan(s->tags.album_gain))
+        gain = s->tags.album_gain;
+    // The tags refer to -18 LUFS
+    return gain + s->target + 18;
+}
+
+// Called at the end of each subblock: update the meter and the gain.
+static void end_subblock(struct af_loudnorm *s)
+{
+    memmove(s->recent + 1, s->recent,
+            (BLOCK_SUBBLOCKS - 1) * sizeof(s->recent[0]));
+    s->recent[0] = s->subblock_energy / s->subblock_len;
+    s->subblock_energy = 0;
+    s->subblock_pos = 0;
+    if (s->num_subblocks < BLOCK_SUBBLOCKS)
+        s->num_subblocks++;
+
+    if (s->num_subblocks == BLOCK_SUBBLOCKS) {
+        double e = 0;
+        for (int n = 0; n < BLOCK_SUBBLOCKS; n++)
+            e += s->recent[n];
+        e /= BLOCK_SUBBLOCKS;
+        double l = energy_to_lufs(e);
+        if (l > HIST_MIN) {
+            int bin = FFMIN((int)((l - HIST_MIN) * 10), HIST_BINS - 1);
+            s->hist_count[bin]++;
+            s->hist_energy[bin] += e;
+            s->gated_blocks++;
+        }
+    }
+
+    float gain_db = s->gain_db;
+    if (s->mode == MODE_LIMIT) {
+        gain_db = 0;
+    } else if (s->mode != MODE_DYNAMIC && !isnan(s->tags.track_gain)) {
+        gain_db = tag_gain(s);
+    } else if (s->gated_blocks >= DYNAMIC_MIN_BLOCKS) {
+        float want = s->target - integrated_loudness(s);
+        float step = DYNAMIC_SLEW / 10;
+        gain_db += av_clipf(want - gain_db, -step, step);
+    }
+    s->gain_db = FFMIN(gain_db, s->maxgain);
+    s->gain_step = (pow(10.0, s->gain_db / 20.0) - s->gain) / s->subblock_len;
+}
+
+// Filter frames of audio, not crossing a subblock boundary.
+static void process(struct af_loudnorm *s, float *a, int nch, int frames)
+{
+    // Meter, on the input signal
+    struct biquad f0 = s->kw[0], f1 = s->kw[1];
+    for (int ch = 0; ch < nch; ch++) {
+        if (!s->ch_weight[ch])
+            continue;
+        double *st = s->kw_state[ch].s, sum = 0;
+        for (int f = 0; f < frames; f++) {
+            double x = a[f * nch + ch];
+            double y = f0.b0 * x + st[0];
+            st[0] = f0.b1 * x - f0.a1 * y + st[1];
+            st[1] = f0.b2 * x - f0.a2 * y;
+            double z = f1.b0 * y + st[2];
+            st[2] = f1.b1 * y - f1.a1 * z + st[3];
+            st[3] = f1.b2 * y - f1.a2 * z;
+            sum += z * z;
+        }
+        s->subblock_energy += s->ch_weight[ch] * sum;
+    }
+
+    // Normalization gain and true peak of the result
+    float *peak = s->peak;
+    int pos = s->tp_pos;
+    for (int f = 0; f < frames; f++)
+        peak[f] = 0;
+    for (int ch = 0; ch < nch; ch++) {
+        float *hist = s->tp_hist[ch];
+        pos = s->tp_pos;
+        for (int f = 0; f < frames; f++) {
+            float x = a[f * nch + ch] * (s->gain + s->gain_step * f);
+            a[f * nch + ch] = x;
+            pos = pos + 1 == TP_TAPS ? 0 : pos + 1;
+            hist[pos] = hist[pos + TP_TAPS] = x;
+            const float *w = hist + pos + 1;
+            float m = fabsf(w[TP_TAPS - 1 - TP_DELAY]);
+            for (int p = 0; p < TP_PHASES; p++) {
+                float y = 0;
+                for (int t = 0; t < TP_TAPS; t++)
+                    y += w[t] * s->tp_coeffs[p][t];
+                m = FFMAX(m, fabsf(y));
+            }
+            peak[f] = FFMAX(peak[f], m);
+        }
+    }
+    s->tp_pos = pos;
+    s->gain += s->gain_step * frames;
+
+    // Limiter gain
+    int look = s->look;
+    for (int f = 0; f < frames; f++) {
+        float g = peak[f] > s->ceiling_lin ? s->ceiling_lin / peak[f] : 1;
+        s->max_peak = FFMAX(s->max_peak, peak[f]);
+        float r = s->rel_gain + (1 - s->rel_gain) * s->release_coef;
+        r = FFMIN(r, g);
+        s->rel_gain = r;
+
+        // Sliding minimum of r over the last look frames
+        int64_t n = s->frame++;
+        if (s->hold_count && s->hold_idx[s->hold_head] <= n - look) {
+            s->hold_head = (s->hold_head + 1) % look;
+            s->hold_count--;
+        }
+        while (s->hold_count &&
+               s->hold_val[(s->hold_head + s->hold_count - 1) % look] >= r)
+            s->hold_count--;
+        int tail = (s->hold_head + s->hold_count) % look;
+        s->hold_val[tail] = r;
+        s->hold_idx[tail] = n;
+        s->hold_count++;
+        float h = s->hold_val[s->hold_head];
+
+        // Moving average of the held gain
+        s->box_sum += h - s->box[s->box_pos];
+        s->box[s->box_pos] = h;
+        if (++s->box_pos == look) {
+            // Avoid accumulating rounding errors
+            s->box_pos = 0;
+            s->box_sum = 0;
+            for (int i = 0; i < look; i++)
+                s->box_sum += s->box[i];
+        }
+        s->lim_gain[f] = s->box_sum / look;
+    }
+
+    // Delay the audio by the lookahead, and apply the limiter gain
+    for (int ch = 0; ch < nch; ch++) {
+        float *d = s->delay[ch];
+        pos = s->delay_pos;
+        for (int f = 0; f < frames; f++) {
+            float x = a[f * nch + ch];
+            a[f * nch + ch] = d[pos] * s->lim_gain[f];
+            d[pos] = x;
+            pos = pos + 1 == s->delay_len ? 0 : pos + 1;
+        }
+    }
+    s->delay_pos = pos;
+}
+
+static int reinit(struct af_instance *af, struct mp_audio *in)
+{
+    struct af_loudnorm *s = af->setup;
+    mp_audio_copy_config(af->data, in);
+    mp_audio_set_format(af->data, AF_FORMAT_FLOAT_NE);
+    int nch = af->data->nch, rate = af->data->rate;
+
+    talloc_free(s->alloc);
+    s->alloc = talloc_new(NULL);
+
+    init_k_weighting(s, rate);
+    s->kw_state = talloc_zero_array(s->alloc, struct kw_state, nch);
+    s->ch_weight = talloc_array(s->alloc, float, nch);
+    for (int ch = 0; ch < nch; ch++)
+        s->ch_weight[ch] = channel_weight(af->data->channels.speaker[ch]);
+    s->subblock_len = FFMAX(rate / 10, 1);
+    s->subblock_pos = 0;
+    s->subblock_energy = 0;
+    s->num_subblocks = 0;
+
+    s->look = FFMAX(lrint(s->lookahead * rate / 1000), 1);
+    s->release_coef = 1 - exp(-1000.0 / (s->release * rate));
+    s->ceiling_lin = pow(10.0, s->ceiling / 20.0);
+    s->rel_gain = 1;
+    s->hold_val = talloc_array(s->alloc, float, s->look);
+    s->hold_idx = talloc_array(s->alloc, int64_t, s->look);
+    s->hold_head = s->hold_count = 0;
+    s->frame = 0;
+    s->box = talloc_array(s->alloc, float, s->look);
+    for (int i = 0; i < s->look; i++)
+        s->box[i] = 1;
+    s->box_pos = 0;
+    s->box_sum = s->look;
+
+    s->delay_len = TP_DELAY + s->look - 1;
+    s->delay_pos = 0;
+    s->tp_pos = 0;
+    s->tp_hist = talloc_array(s->alloc, float *, nch);
+    s->delay = talloc_array(s->alloc, float *, nch);
+    for (int ch = 0; ch < nch; ch++) {
+        s->tp_hist[ch] = talloc_zero_array(s->alloc, float, 2 * TP_TAPS);
+        s->delay[ch] = talloc_zero_array(s->alloc, float, s->delay_len);
+    }
+    s->peak = talloc_array(s->alloc, float, s->subblock_len);
+    s->lim_gain = talloc_array(s->alloc, float, s->subblock_len);
+
+    // The measured loudness and the gain are kept across reinits
+    s->gain = pow(10.0, s->gain_db / 20.0);
+    s->gain_step = 0;
+
+    af->delay = s->delay_len * nch * af->data->bps;
+    mp_msg(MSGT_AFILTER, MSGL_V, "[loudnorm] Target %.1f LUFS, lookahead "
+           "%d samples, latency %d samples\n", s->target, s->look,
+           s->delay_len);
+    return af_test_output(af, in);
+}
+
+// Initialization and runtime control
+static int control(struct af_instance *af, int cmd, void *arg)
+{
+    struct af_loudnorm *s = af->setup;
+    switch (cmd) {
+    case AF_CONTROL_REINIT:
+        return reinit(af, arg);
+    case AF_CONTROL_COMMAND_LINE: {
+        const opt_t subopts[] = {
+            {"mode",      OPT_ARG_MSTRZ, &s->mode_str,  NULL},
+            {"target",    OPT_ARG_FLOAT, &s->target,    NULL},
+            {"maxgain",   OPT_ARG_FLOAT, &s->maxgain,   NULL},
+            {"ceiling",   OPT_ARG_FLOAT, &s->ceiling,   NULL},
+            {"lookahead", OPT_ARG_FLOAT, &s->lookahead, NULL},
+            {"release",   OPT_ARG_FLOAT, &s->release,   NULL},
+            {NULL}
+        };
+        if (subopt_parse(arg, subopts) != 0) {
+            mp_msg(MSGT_AFILTER, MSGL_ERR, "[loudnorm] Invalid option "
+                   "specified.\n");
+            return AF_ERROR;
+        }
+        if (!s->mode_str || !strcmp(s->mode_str, "dynamic")) {
+            s->mode = MODE_DYNAMIC;
+        } else if (!strcmp(s->mode_str, "track")) {
+            s->mode = MODE_TRACK;
+        } else if (!strcmp(s->mode_str, "album")) {
+            s->mode = MODE_ALBUM;
+        } else if (!strcmp(s->mode_str, "limit")) {
+            s->mode = MODE_LIMIT;
+        } else {
+            mp_msg(MSGT_AFILTER, MSGL_ERR, "[loudnorm] Unknown mode: %s\n",
+                   s->mode_str);
+            return AF_ERROR;
+        }
+        if (s->target < -70 || s->target > 0 || s->ceiling < -20 ||
+            s->ceiling > 0 || s->lookahead < 0.1 || s->lookahead > 100 ||
+            s->release < 1 || s->release > 10000)
+        {
+            mp_msg(MSGT_AFILTER, MSGL_ERR, "[loudnorm] Option out of "
+                   "range.\n");
+            return AF_ERROR;
+        }
+        return AF_OK;
+    }
+    case AF_CONTROL_REPLAYGAIN | AF_CONTROL_SET: {
+        s->tags = *(struct af_replaygain *)arg;
+        if (s->mode == MODE_TRACK || s->mode == MODE_ALBUM) {
+            if (isnan(s->tags.track_gain)) {
+                mp_msg(MSGT_AFILTER, MSGL_V, "[loudnorm] No ReplayGain/R128 "
+                       "tags, measuring the loudness instead.\n");
+            } else {
+                // Apply it right from the start, without ramping
+                s->gain_db = FFMIN(tag_gain(s), s->maxgain);
+                s->gain = pow(10.0, s->gain_db / 20.0);
+                s->gain_step = 0;
+                mp_msg(MSGT_AFILTER, MSGL_V, "[loudnorm] Gain from tags: "
+                       "%.2f dB\n", s->gain_db);
+            }
+        }
+        return AF_OK;
+    }
+    case AF_CONTROL_PRE_DESTROY:
+        mp_msg(MSGT_AFILTER, MSGL_V, "[loudnorm] Integrated loudness %.1f "
+               "LUFS, true peak before limiting %.1f dBTP, gain %.1f dB\n",
+               integrated_loudness(s), 20 * log10(s->max_peak), s->gain_db);
+        return AF_OK;
+    }
+    return AF_UNKNOWN;
+}
+
+// Deallocate memory
+static void uninit(struct af_instance *af)
+{
+    struct af_loudnorm *s = af->setup;
+    if (s) {
+        talloc_free(s->alloc);
+        free(s->mode_str);
+    }
+    free(af->setup);
+    free(af->data);
+}
+
+// Filter data through filter
+static struct mp_audio *play(struct af_instance *af, struct mp_audio *data)
+{
+    struct af_loudnorm *s = af->setup;
+    int nch = data->nch;
+    float *audio = data->audio;
+    int frames = data->len / (nch * sizeof(float));
+    while (frames > 0) {
+        int n = FFMIN(frames, s->subblock_len - s->subblock_pos);
+        process(s, audio, nch, n);
+        s->subblock_pos += n;
+        if (s->subblock_pos == s->subblock_len)
+            end_subblock(s);
+        audio += n * nch;
+        frames -= n;
+    }
+    return data;
+}
+
+// Allocate memory and set function pointers
+static int af_open(struct af_instance *af)
+{
+    af->control = control;
+    af->uninit = uninit;
+    af->play = play;
+    af->mul = 1;
+    af->data = calloc(1, sizeof(struct mp_audio));
+    af->setup = calloc(1, sizeof(struct af_loudnorm));
+    if (af->data == NULL || af->setup == NULL)
+        return AF_ERROR;
+    struct af_loudnorm *s = af->setup;
+    s->target = -23;
+    s->maxgain = 12;
+    s->ceiling = -1;
+    s->lookahead = 5;
+    s->release = 100;
+    s->tags = (struct af_replaygain){NAN, NAN};
+    init_true_peak(s);
+    return AF_OK;
+}
+
+// Description of this filter
+struct af_info af_info_loudnorm = {
+    "Loudness normalization and true peak limiter",
+    "loudnorm",
+    "",
+    "",
+    AF_FLAGS_REENTRANT,
+    af_open
+};
@@ -36,6 +36,9 @@
 #include <limits.h>
 #include <assert.h>
 
+#include <libavcodec/avfft.h>
+#include <libavutil/mem.h>
+
 #include "af.h"
 #include "libavutil/common.h"
 #include "core/subopt-helper.h"
@@ -69,6 +72,13 @@ typedef struct af_scaletempo_s
   void*   buf_pre_corr;
   void*   table_window;
   int     (*best_overlap_offset)(struct af_scaletempo_s* s);
+  // best overlap using FFT cross correlation
+  int     fft_size;
+  RDFTContext* rdft;
+  RDFTContext* irdft;
+  float*  fft_pre_corr;
+  float*  fft_search;
+  float*  fft_corr;
   // command line
   float   scale_nominal;
   float   ms_stride;
@@ -76,6 +86,7 @@ typedef struct af_scaletempo_s
   float   ms_search;
   short   speed_tempo;
   short   speed_pitch;
+  int     use_fft;          // -1: auto, 0: no, 1: yes
 } af_scaletempo_t;
 
 static int fill_queue(struct af_instance* af, struct mp_audio* data, int offset)
@@ -133,14 +144,23 @@ static int best_overlap_offset_float(af_scaletempo_t* s)
     *ppc++ = *pw++ * *po++;
   }
 
+  // buf_pre_corr is zero padded to a multiple of 4 samples, so the loop can
+  // keep 4 independent sums, which the compiler can vectorize
   search_start = (float*)s->buf_queue + s->num_channels;
   for (off=0; off<s->frames_search; off++) {
-    float corr = 0;
+    float c0 = 0, c1 = 0, c2 = 0, c3 = 0;
+    float corr;
     float* ps = search_start;
     ppc = s->buf_pre_corr;
-    for (i=s->num_channels; i<s->samples_overlap; i++) {
-      corr += *ppc++ * *ps++;
+    for (i=s->num_channels; i<s->samples_overlap; i+=4) {
+      c0 += ppc[0] * ps[0];
+      c1 += ppc[1] * ps[1];
+      c2 += ppc[2] * ps[2];
+      c3 += ppc[3] * ps[3];
+      ppc += 4;
+      ps  += 4;
     }
+    corr = (c0 + c1) + (c2 + c3);
     if (corr > best_corr) {
       best_corr = corr;
       best_off  = off;
@@ -151,6 +171,103 @@ static int best_overlap_offset_float(af_scaletempo_t* s)
   return best_off * 4 * s->num_channels;
 }
 
+/* Same as best_overlap_offset_float(), but computes the correlation for all
+ * offsets at once: per channel, the spectra of the windowed overlap and of
+ * the search area are multiplied, summed over all channels, and transformed
+ * back. The scale of the result doesn't matter, as only its maximum is used.
+ */
+static int best_overlap_offset_fft(af_scaletempo_t* s)
+{
+  int nch = s->num_channels;
+  int n = s->fft_size;
+  int frames_pre_corr = s->samples_overlap / nch - 1;
+  int frames_in = s->frames_search + frames_pre_corr - 1;
+  float* pw = s->table_window;
+  float* po = (float*)s->buf_overlap + nch;
+  float* pq = (float*)s->buf_queue + nch;
+  float* pa = s->fft_pre_corr;
+  float* pb = s->fft_search;
+  float* pc = s->fft_corr;
+  float best_corr = INT_MIN;
+  int best_off = 0;
+  int c, i, off;
+
+  memset(pc, 0, n * sizeof(float));
+  for (c=0; c<nch; c++) {
+    for (i=0; i<frames_pre_corr; i++)
+      pa[i] = pw[i * nch + c] * po[i * nch + c];
+    memset(pa + frames_pre_corr, 0, (n - frames_pre_corr) * sizeof(float));
+    for (i=0; i<frames_in; i++)
+      pb[i] = pq[i * nch + c];
+    memset(pb + frames_in, 0, (n - frames_in) * sizeof(float));
+    av_rdft_calc(s->rdft, pa);
+    av_rdft_calc(s->rdft, pb);
+    // conj(a) * b; the first two values are the real DC and Nyquist terms
+    pc[0] += pa[0] * pb[0];
+    pc[1] += pa[1] * pb[1];
+    for (i=2; i<n; i+=2) {
+      pc[i]   += pa[i] * pb[i]   + pa[i+1] * pb[i+1];
+      pc[i+1] += pa[i] * pb[i+1] - pa[i+1] * pb[i];
+    }
+  }
+  av_rdft_calc(s->irdft, pc);
+
+  for (off=0; off<s->frames_search; off++) {
+    if (pc[off] > best_corr) {
+      best_corr = pc[off];
+      best_off  = off;
+    }
+  }
+
+  return best_off * 4 * nch;
+}
+
+static void free_fft(af_scaletempo_t* s)
+{
+  if (s->rdft)
+    av_rdft_end(s->rdft);
+  if (s->irdft)
+    av_rdft_end(s->irdft);
+  s->rdft = s->irdft = NULL;
+  av_freep(&s->fft_pre_corr);
+  av_freep(&s->fft_search);
+  av_freep(&s->fft_corr);
+  s->fft_size = 0;
+}
+
+/* Set up the FFT correlation if it's (estimated to be) cheaper than the
+ * direct one, or if it was forced. Returns whether it's used.
+ */
+static int init_fft(af_scaletempo_t* s, int frames_overlap, int nch)
+{
+  int frames_in = s->frames_search + frames_overlap - 2;
+  int bits = av_log2(frames_in - 1) + 1;
+  int n = 1 << bits;
+  // multiply-adds of the direct search vs. rough cost of the transforms
+  int64_t direct_cost = (int64_t)s->frames_search * (frames_overlap - 1) * nch;
+  int64_t fft_cost = 2 * (int64_t)(2 * nch + 1) * n * bits;
+
+  free_fft(s);
+  if (s->use_fft == 0 || (s->use_fft < 0 && fft_cost >= direct_cost))
+    return 0;
+  if (bits < 4 || bits > 16)
+    return 0;
+
+  s->rdft  = av_rdft_init(bits, DFT_R2C);
+  s->irdft = av_rdft_init(bits, IDFT_C2R);
+  s->fft_pre_corr = av_malloc(n * sizeof(float));
+  s->fft_search   = av_malloc(n * sizeof(float));
+  s->fft_corr     = av_malloc(n * sizeof(float));
+  if (!s->rdft || !s->irdft || !s->fft_pre_corr || !s->fft_search ||
+      !s->fft_corr)
+  {
+    free_fft(s);
+    return 0;
+  }
+  s->fft_size = n;
+  return 1;
+}
+
 static int best_overlap_offset_s16(af_scaletempo_t* s)
 {
   int32_t *pw, *ppc;
@@ -226,7 +343,9 @@ static struct mp_audio* play(struct af_instance* af, struct mp_audio* data)
   int max_bytes_out;
   int8_t* pout;
 
-  if (s->scale == 1.0) {
+  // Once data is queued, keep going even at scale 1, so that a live change of
+  // the scale doesn't drop the queued audio.
+  if (s->scale == 1.0 && !s->bytes_queued) {
     af->delay = 0;
     return data;
   }
@@ -284,6 +403,19 @@ static struct mp_audio* play(struct af_instance* af, struct mp_audio* data)
   return data;
 }
 
+// Change the scale of a configured filter, taking effect with the next stride
+static void set_scale(struct af_instance* af, float scale)
+{
+  af_scaletempo_t* s = af->setup;
+  s->scale = scale;
+  if (!s->bytes_per_frame)
+    return;
+  int frames_stride = s->bytes_stride / s->bytes_per_frame;
+  s->bytes_stride_scaled  = s->scale * s->bytes_stride;
+  s->frames_stride_scaled = s->scale * frames_stride;
+  af->mul = (double)s->bytes_stride / s->bytes_stride_scaled;
+}
+
 // Initialization and runtime control
 static int control(struct af_instance* af, int cmd, void* arg)
 {
@@ -304,13 +436,10 @@ static int control(struct af_instance* af, int cmd, void* arg)
 
     mp_audio_copy_config(af->data, data);
 
-    if (s->scale == 1.0) {
-      if (s->speed_tempo && s->speed_pitch)
-        return AF_DETACH;
-      af->delay = 0;
-      af->mul = 1;
-      return af_test_output(af, data);
-    }
+    // Stay in the chain at scale 1 (play() passes the audio through), so
+    // that playback speed changes can be applied without reinitializing.
+    if (s->scale == 1.0 && s->speed_tempo && s->speed_pitch)
+      return AF_DETACH;
 
     if (data->format == AF_FORMAT_S16_NE) {
       use_int = 1;
@@ -393,12 +522,13 @@ static int control(struct af_instance* af, int cmd, void* arg)
         s->best_overlap_offset = best_overlap_offset_s16;
       } else {
         float* pw;
-        s->buf_pre_corr = realloc(s->buf_pre_corr, s->bytes_overlap);
+        s->buf_pre_corr = realloc(s->buf_pre_corr, s->bytes_overlap + UNROLL_PADDING);
         s->table_window = realloc(s->table_window, s->bytes_overlap - nch * bps);
         if(!s->buf_pre_corr || !s->table_window) {
           mp_msg(MSGT_AFILTER, MSGL_FATAL, "[scaletempo] Out of memory\n");
           return AF_ERROR;
         }
+        memset((char *)s->buf_pre_corr + s->bytes_overlap - nch * bps, 0, UNROLL_PADDING);
         pw = s->table_window;
         for (i=1; i<frames_overlap; i++) {
           float v = i * (frames_overlap - i);
@@ -406,7 +536,10 @@ static int control(struct af_instance* af, int cmd, void* arg)
             *pw++ = v;
           }
         }
-        s->best_overlap_offset = best_overlap_offset_float;
+        if (init_fft(s, frames_overlap, nch))
+          s->best_overlap_offset = best_overlap_offset_fft;
+        else
+          s->best_overlap_offset = best_overlap_offset_float;
       }
     }
 
@@ -420,20 +553,22 @@ static int control(struct af_instance* af, int cmd, void* arg)
       mp_msg(MSGT_AFILTER, MSGL_FATAL, "[scaletempo] Out of memory\n");
       return AF_ERROR;
     }
+    memset((char *)s->buf_queue + s->bytes_queue, 0, UNROLL_PADDING);
 
     s->bytes_queued = 0;
     s->bytes_to_slide = 0;
 
     mp_msg (MSGT_AFILTER, MSGL_DBG2, "[scaletempo] "
             "%.2f stride_in, %i stride_out, %i standing, "
-            "%i overlap, %i search, %i queue, %s mode\n",
+            "%i overlap, %i search, %i queue, %s mode%s\n",
             s->frames_stride_scaled,
             (int)(s->bytes_stride / nch / bps),
             (int)(s->bytes_standing / nch / bps),
             (int)(s->bytes_overlap / nch / bps),
             s->frames_search,
             (int)(s->bytes_queue / nch / bps),
-            (use_int?"s16":"float"));
+            (use_int?"s16":"float"),
+            (s->best_overlap_offset == best_overlap_offset_fft?", fft":""));
 
     return af_test_output(af, (struct mp_audio*)arg);
   }
@@ -443,11 +578,11 @@ static int control(struct af_instance* af, int cmd, void* arg)
         break;
       }
       s->speed = *(float*)arg;
-      s->scale = s->speed * s->scale_nominal;
+      set_scale(af, s->speed * s->scale_nominal);
     } else {
       if (s->speed_pitch) {
         s->speed = 1 / *(float*)arg;
-        s->scale = s->speed * s->scale_nominal;
+        set_scale(af, s->speed * s->scale_nominal);
         break;
       }
     }
@@ -455,7 +590,7 @@ static int control(struct af_instance* af, int cmd, void* arg)
   }
   case AF_CONTROL_SCALETEMPO_AMOUNT | AF_CONTROL_SET:{
     s->scale = *(float*)arg;
-    s->scale = s->speed * s->scale_nominal;
+    set_scale(af, s->speed * s->scale_nominal);
     return AF_OK;
   }
   case AF_CONTROL_SCALETEMPO_AMOUNT | AF_CONTROL_GET:
@@ -463,12 +598,14 @@ static int control(struct af_instance* af, int cmd, void* arg)
     return AF_OK;
   case AF_CONTROL_COMMAND_LINE:{
     strarg_t speed = {};
+    strarg_t fft = {};
     opt_t subopts[] = {
       {"scale",   OPT_ARG_FLOAT, &s->scale_nominal, NULL},
       {"stride",  OPT_ARG_FLOAT, &s->ms_stride, NULL},
       {"overlap", OPT_ARG_FLOAT, &s->percent_overlap, NULL},
       {"search",  OPT_ARG_FLOAT, &s->ms_search, NULL},
       {"speed",   OPT_ARG_STR,   &speed, NULL},
+      {"fft",     OPT_ARG_STR,   &fft, NULL},
       {NULL},
     };
     if (subopt_parse(arg, subopts) != 0) {
@@ -520,6 +657,21 @@ static int control(struct af_instance* af, int cmd, void* arg)
         return AF_ERROR;
       }
     }
+    if (fft.len > 0) {
+      if (strcmp(fft.str, "auto") == 0) {
+        s->use_fft = -1;
+      } else if (strcmp(fft.str, "yes") == 0) {
+        s->use_fft = 1;
+      } else if (strcmp(fft.str, "no") == 0) {
+        s->use_fft = 0;
+      } else {
+        mp_msg(MSGT_AFILTER, MSGL_ERR,
+               "[scaletempo] %s: %s: fft=[auto|yes|no]\n",
+               mp_gtext("error parsing command line"),
+               mp_gtext("value out of range"));
+        return AF_ERROR;
+      }
+    }
     s->scale = s->speed * s->scale_nominal;
     mp_msg(MSGT_AFILTER, MSGL_DBG2, "[scaletempo] %6.3f scale, %6.2f stride, %6.2f overlap, %6.2f search, speed = %s\n", s->scale_nominal, s->ms_stride, s->percent_overlap, s->ms_search, (s->speed_tempo?(s->speed_pitch?"tempo and speed":"tempo"):(s->speed_pitch?"pitch":"none")));
     return AF_OK;
@@ -539,6 +691,7 @@ static void uninit(struct af_instance* af)
   free(s->buf_pre_corr);
   free(s->table_blend);
   free(s->table_window);
+  free_fft(s);
   free(af->setup);
 }
 
@@ -562,6 +715,7 @@ static int af_open(struct af_instance* af){
   s->ms_stride = 60;
   s->percent_overlap = .20;
   s->ms_search = 14;
+  s->use_fft = -1;
 
   return AF_OK;
 }
@@ -41,31 +41,16 @@
 
 #include "af.h"
 #include "dsp.h"
+#include "fftconv.h"
 
 #define L  32    // Length of fir filter
 #define LD 65536 // Length of delay buffer
+#define LB 64    // Block length (latency) of the FFT convolution
 
-// 32 Tap fir filter loop unrolled
-#define FIR(x,w,y) \
-  y = ( w[0] *x[0] +w[1] *x[1] +w[2] *x[2] +w[3] *x[3]  \
-      + w[4] *x[4] +w[5] *x[5] +w[6] *x[6] +w[7] *x[7]  \
-      + w[8] *x[8] +w[9] *x[9] +w[10]*x[10]+w[11]*x[11] \
-      + w[12]*x[12]+w[13]*x[13]+w[14]*x[14]+w[15]*x[15] \
-      + w[16]*x[16]+w[17]*x[17]+w[18]*x[18]+w[19]*x[19] \
-      + w[20]*x[20]+w[21]*x[21]+w[22]*x[22]+w[23]*x[23] \
-      + w[24]*x[24]+w[25]*x[25]+w[26]*x[26]+w[27]*x[27] \
-      + w[28]*x[28]+w[29]*x[29]+w[30]*x[30]+w[31]*x[31])
-
-// Add to circular queue macro + update index
 #ifdef SPLITREAR
-#define ADDQUE(qi,rq,lq,r,l)\
-  lq[qi]=lq[qi+L]=(l);\
-  rq[qi]=rq[qi+L]=(r);\
-  qi=(qi-1)&(L-1);
+#define NUM_OUT 4 // Number of outputs computed by the convolution
 #else
-#define ADDQUE(qi,lq,l)\
-  lq[qi]=lq[qi+L]=(l);\
-  qi=(qi-1)&(L-1);
+#define NUM_OUT 3
 #endif
 
 // Macro for updating queue index in delay queues
@@ -74,17 +59,59 @@
 // instance data
 typedef struct af_surround_s
 {
-  float lq[2*L]; // Circular queue for filtering left rear channel
-  float rq[2*L]; // Circular queue for filtering right rear channel
   float w[L]; 	 // FIR filter coefficients for surround sound 7kHz low-pass
+  struct fftconv* conv; // Steering matrix and low-pass filter
   float* dr;	 // Delay queue right rear channel
   float* dl;	 // Delay queue left rear channel
   float  d;	 // Delay time
-  int i;       	 // Position in circular buffer
   int wi;	 // Write index for delay queue
   int ri;	 // Read index for delay queue
 }af_surround_t;
 
+// The beginnings of an active matrix...
+static float steering_matrix[][12] = {
+//	LL	RL	LR	RR	LS	RS
+//	LLs	RLs	LRs	RRs	LC	RC
+       {.707,	.0,	.0,	.707,	.5,	-.5,
+	.5878,	-.3928,	.3928,	-.5878,	.5,	.5},
+};
+
+// Set up the convolution of the input channels into the front channels and
+// the low-passed surround channels (before the delay)
+static int init_conv(af_surround_t* s)
+{
+  float* m = steering_matrix[0];
+  float  one = 1;
+  float  ir[L+1] = {0};
+  int    err = 0;
+
+  // The low-pass output is delayed by one sample
+  memcpy(ir + 1, s->w, L * sizeof(float));
+
+  fftconv_destroy(s->conv);
+  s->conv = fftconv_create(LB, 2, NUM_OUT, L+1);
+  if (!s->conv)
+    return -1;
+
+  // Output front left and right
+  err |= fftconv_add_ir(s->conv, 0, 0, &one, 1, m[0]);
+  err |= fftconv_add_ir(s->conv, 1, 0, &one, 1, m[1]);
+  err |= fftconv_add_ir(s->conv, 0, 1, &one, 1, m[2]);
+  err |= fftconv_add_ir(s->conv, 1, 1, &one, 1, m[3]);
+
+  // Low-pass @ 7kHz of the surround
+#ifdef SPLITREAR
+  err |= fftconv_add_ir(s->conv, 0, 2, ir, L+1, m[8]);
+  err |= fftconv_add_ir(s->conv, 1, 2, ir, L+1, m[9]);
+  err |= fftconv_add_ir(s->conv, 0, 3, ir, L+1, m[6]);
+  err |= fftconv_add_ir(s->conv, 1, 3, ir, L+1, m[7]);
+#else
+  err |= fftconv_add_ir(s->conv, 0, 2, ir, L+1, m[4]);
+  err |= fftconv_add_ir(s->conv, 1, 2, ir, L+1, m[5]);
+#endif
+  return err ? -1 : 0;
+}
+
 // Initialization and runtime control
 static int control(struct af_instance* af, int cmd, void* arg)
 {
@@ -106,6 +133,11 @@ static int control(struct af_instance* af, int cmd, void* arg)
       mp_msg(MSGT_AFILTER, MSGL_ERR, "[surround] Unable to design low-pass filter.\n");
       return AF_ERROR;
     }
+    if (init_conv(s) < 0) {
+      mp_msg(MSGT_AFILTER, MSGL_ERR, "[surround] Unable to set up convolution.\n");
+      return AF_ERROR;
+    }
+    af->delay = fftconv_latency(s->conv) * 2 * af->data->bps;
 
     // Free previous delay queues
     free(s->dl);
@@ -147,74 +179,65 @@ static int control(struct af_instance* af, int cmd, void* arg)
 // Deallocate memory
 static void uninit(struct af_instance* af)
 {
+  af_surround_t* s = af->setup;
   if(af->data)
     free(af->data->audio);
   free(af->data);
+  if(s){
+    fftconv_destroy(s->conv);
+    free(s->dl);
+    free(s->dr);
+  }
   free(af->setup);
 }
 
-// The beginnings of an active matrix...
-static float steering_matrix[][12] = {
-//	LL	RL	LR	RR	LS	RS
-//	LLs	RLs	LRs	RRs	LC	RC
-       {.707,	.0,	.0,	.707,	.5,	-.5,
-	.5878,	-.3928,	.3928,	-.5878,	.5,	.5},
-};
-
 // Experimental moving average dominance
 //static int amp_L = 0, amp_R = 0, amp_C = 0, amp_S = 0;
 
 // Filter data through filter
 static struct mp_audio* play(struct af_instance* af, struct mp_audio* data){
   af_surround_t* s   = (af_surround_t*)af->setup;
-  float*	 m   = steering_matrix[0];
   float*     	 in  = data->audio; 	// Input audio data
   float*     	 out = NULL;		// Output audio data
-  float*	 end = in + data->len / sizeof(float); // Loop end
-  int 		 i   = s->i;	// Filter queue index
+  int		 len = data->len / data->nch / sizeof(float); // Number of frames
   int 		 ri  = s->ri;	// Read index for delay queue
   int 		 wi  = s->wi;	// Write index for delay queue
+  int		 n;
 
   if (AF_OK != RESIZE_LOCAL_BUFFER(af, data))
     return NULL;
 
   out = af->data->audio;
 
-  while(in < end){
-    /* Dominance:
-       abs(in[0])  abs(in[1]);
-       abs(in[0]+in[1])  abs(in[0]-in[1]);
-       10 * log( abs(in[0]) / (abs(in[1])|1) );
-       10 * log( abs(in[0]+in[1]) / (abs(in[0]-in[1])|1) ); */
-
-    /* About volume balancing...
-       Surround encoding does the following:
-           Lt=L+.707*C+.707*S, Rt=R+.707*C-.707*S
-       So S should be extracted as:
-           (Lt-Rt)
-       But we are splitting the S to two output channels, so we
-       must take 3dB off as we split it:
-           Ls=Rs=.707*(Lt-Rt)
-       Trouble is, Lt could be +1, Rt -1, so possibility that S will
-       overflow. So to avoid that, we cut L/R by 3dB (*.707), and S by
-       6dB (/2). This keeps the overall balance, but guarantees no
-       overflow. */
-
-    // Output front left and right
-    out[0] = m[0]*in[0] + m[1]*in[1];
-    out[1] = m[2]*in[0] + m[3]*in[1];
-
-    // Low-pass output @ 7kHz
-    FIR((&s->lq[i]), s->w, s->dl[wi]);
-
+  /* Dominance:
+     abs(in[0])  abs(in[1]);
+     abs(in[0]+in[1])  abs(in[0]-in[1]);
+     10 * log( abs(in[0]) / (abs(in[1])|1) );
+     10 * log( abs(in[0]+in[1]) / (abs(in[0]-in[1])|1) ); */
+
+  /* About volume balancing...
+     Surround encoding does the following:
+         Lt=L+.707*C+.707*S, Rt=R+.707*C-.707*S
+     So S should be extracted as:
+         (Lt-Rt)
+     But we are splitting the S to two output channels, so we
+     must take 3dB off as we split it:
+         Ls=Rs=.707*(Lt-Rt)
+     Trouble is, Lt could be +1, Rt -1, so possibility that S will
+     overflow. So to avoid that, we cut L/R by 3dB (*.707), and S by
+     6dB (/2). This keeps the overall balance, but guarantees no
+     overflow. */
+
+  // Steering matrix and low-pass filter, see init_conv()
+  fftconv_process(s->conv, in, data->nch, out, af->data->nch, len);
+
+  for (n = 0; n < len; n++) {
     // Delay output by d ms
+    s->dl[wi] = out[2];
     out[2] = s->dl[ri];
 
 #ifdef SPLITREAR
-    // Low-pass output @ 7kHz
-    FIR((&s->rq[i]), s->w, s->dr[wi]);
-
-    // Delay output by d ms
+    s->dr[wi] = out[3];
     out[3] = s->dr[ri];
 #else
     out[3] = -out[2];
@@ -224,20 +247,12 @@ static struct mp_audio* play(struct af_instance* af, struct mp_audio* data){
     UPDATEQI(ri);
     UPDATEQI(wi);
 
-    // Calculate and save surround in circular queue
-#ifdef SPLITREAR
-    ADDQUE(i, s->rq, s->lq, m[6]*in[0]+m[7]*in[1], m[8]*in[0]+m[9]*in[1]);
-#else
-    ADDQUE(i, s->lq, m[4]*in[0]+m[5]*in[1]);
-#endif
-
     // Next sample...
-    in = &in[data->nch];
     out = &out[af->data->nch];
   }
 
   // Save indexes
-  s->i  = i; s->ri = ri; s->wi = wi;
+  s->ri = ri; s->wi = wi;
 
   // Set output data
   data->audio = af->data->audio;
@@ -78,6 +78,10 @@ typedef struct af_control_ext_s{
 // Set output rate in resample
 #define AF_CONTROL_RESAMPLE_RATE	0x00000100 | AF_CONTROL_FILTER_SPECIFIC
 
+// Change the rate the input is resampled from, without reinitializing the
+// filter (for playback speed changes), arg is double*
+#define AF_CONTROL_RESAMPLE_INPUT_RATE	0x00000200 | AF_CONTROL_FILTER_SPECIFIC
+
 // Format
 
 #define AF_CONTROL_FORMAT_FMT		0x00000400 | AF_CONTROL_FILTER_SPECIFIC
@@ -127,4 +131,15 @@ typedef struct af_control_ext_s{
 #define AF_CONTROL_PLAYBACK_SPEED	0x00003500 | AF_CONTROL_FILTER_SPECIFIC
 #define AF_CONTROL_SCALETEMPO_AMOUNT	0x00003600 | AF_CONTROL_FILTER_SPECIFIC
 
+// Loudness normalization gains read from the file's tags, arg is
+// struct af_replaygain*
+#define AF_CONTROL_REPLAYGAIN		0x00003700 | AF_CONTROL_FILTER_SPECIFIC
+
+// Gains in dB that bring the track/album to a loudness of -18 LUFS (the
+// ReplayGain 2.0 reference level), NAN if the file has no such tag.
+struct af_replaygain {
+    float track_gain;
+    float album_gain;
+};
+
 #endif /* MPLAYER_CONTROL_H */
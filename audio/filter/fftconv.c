@@ -0,0 +1,266 @@
+/*
+ * This file is part of mpv.
+ *
+ * mpv is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * mpv is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with mpv.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/* Overlap-save convolution with a frequency-domain delay line: each block of
+ * B input samples is transformed together with the previous block (size 2*B
+ * transform). The spectra of the last P input blocks are kept, and each output
+ * block is the inverse transform of the sum of these spectra multiplied with
+ * the spectra of the P impulse response partitions. The second half of the
+ * inverse transform is the (non-circular) convolution result.
+ *
+ * The transforms are done with libavcodec's (SIMD optimized) RDFT. Spectra are
+ * kept with separate real and imaginary arrays, so that the complex
+ * multiply-add, which dominates for long impulse responses, is vectorized by
+ * the compiler.
+ */
+
+#include <stdbool.h>
+#include <string.h>
+
+#include <libavcodec/avfft.h>
+#include <libavutil/common.h>
+#include <libavutil/mem.h>
+
+#include "talloc.h"
+#include "fftconv.h"
+
+struct fftconv {
+    int block;          // B, samples per partition and block
+    int bins;           // B + 1, spectrum size
+    int num_in, num_out;
+    int num_parts;      // P
+    RDFTContext *rdft, *irdft;
+    float *tmp;         // 2*B, transform buffer
+    float *acc;         // spectrum, sum for the current output
+    float **win;        // [num_in], 2*B: previous and current input block
+    float **fdl;        // [num_in], P input spectra (frequency delay line)
+    bool *in_used;      // [num_in], input has a non-zero response
+    float **out;        // [num_out], B: output block being returned
+    float **ir;         // [(out * num_in + in) * P + p], NULL if all zero
+    int fdl_pos;        // index of the newest spectrum in fdl
+    int pos;            // samples buffered in the current block
+};
+
+// Spectra are stored as bins real parts followed by bins imaginary parts.
+static void unpack_spectrum(float *spec, const float *packed, int block)
+{
+    float *re = spec, *im = spec + block + 1;
+    re[0] = packed[0];
+    im[0] = 0;
+    re[block] = packed[1];
+    im[block] = 0;
+    for (int k = 1; k < block; k++) {
+        re[k] = packed[2 * k];
+        im[k] = packed[2 * k + 1];
+    }
+}
+
+static void pack_spectrum(float *packed, const float *spec, int block)
+{
+    const float *re = spec, *im = spec + block + 1;
+    packed[0] = re[0];
+    packed[1] = re[block];
+    for (int k = 1; k < block; k++) {
+        packed[2 * k]     = re[k];
+        packed[2 * k + 1] = im[k];
+    }
+}
+
+// acc += x * h
+static void spectrum_mac(float *restrict acc, const float *restrict x,
+                         const float *restrict h, int bins)
+{
+    float *restrict acc_re = acc, *restrict acc_im = acc + bins;
+    const float *x_re = x, *x_im = x + bins;
+    const float *h_re = h, *h_im = h + bins;
+    for (int k = 0; k < bins; k++) {
+        acc_re[k] += x_re[k] * h_re[k] - x_im[k] * h_im[k];
+        acc_im[k] += x_re[k] * h_im[k] + x_im[k] * h_re[k];
+    }
+}
+
+struct fftconv *fftconv_create(int block_size, int num_in, int num_out,
+                               int max_ir_len)
+{
+    if (block_size < 8 || block_size > 32768 ||
+        (block_size & (block_size - 1)) || num_in < 1 || num_out < 1 ||
+        max_ir_len < 1)
+        return NULL;
+
+    struct fftconv *c = talloc_zero(NULL, struct fftconv);
+    int bits = av_log2(block_size) + 1;
+    c->block = block_size;
+    c->bins = block_size + 1;
+    c->num_in = num_in;
+    c->num_out = num_out;
+    c->num_parts = (max_ir_len + block_size - 1) / block_size;
+    c->win = talloc_zero_array(c, float *, num_in);
+    c->fdl = talloc_zero_array(c, float *, num_in);
+    c->in_used = talloc_zero_array(c, bool, num_in);
+    c->out = talloc_zero_array(c, float *, num_out);
+    c->ir = talloc_zero_array(c, float *, num_out * num_in * c->num_parts);
+
+    c->rdft = av_rdft_init(bits, DFT_R2C);
+    c->irdft = av_rdft_init(bits, IDFT_C2R);
+    c->tmp = av_malloc(2 * c->block * sizeof(float));
+    c->acc = av_malloc(2 * c->bins * sizeof(float));
+    bool ok = c->rdft && c->irdft && c->tmp && c->acc;
+    for (int i = 0; i < num_in; i++) {
+        c->win[i] = av_malloc(2 * c->block * sizeof(float));
+        c->fdl[i] = av_malloc(c->num_parts * 2 * c->bins * sizeof(float));
+        ok &= c->win[i] && c->fdl[i];
+    }
+    for (int o = 0; o < num_out; o++) {
+        c->out[o] = av_malloc(c->block * sizeof(float));
+        ok &= !!c->out[o];
+    }
+    if (!ok) {
+        fftconv_destroy(c);
+        return NULL;
+    }
+    fftconv_reset(c);
+    return c;
+}
+
+void fftconv_destroy(struct fftconv *c)
+{
+    if (!c)
+        return;
+    if (c->rdft)
+        av_rdft_end(c->rdft);
+    if (c->irdft)
+        av_rdft_end(c->irdft);
+    av_free(c->tmp);
+    av_free(c->acc);
+    for (int i = 0; i < c->num_in; i++) {
+        av_free(c->win[i]);
+        av_free(c->fdl[i]);
+    }
+    for (int o = 0; o < c->num_out; o++)
+        av_free(c->out[o]);
+    for (int n = 0; n < c->num_out * c->num_in * c->num_parts; n++)
+        av_free(c->ir[n]);
+    talloc_free(c);
+}
+
+int fftconv_add_ir(struct fftconv *c, int in, int out, const float *ir,
+                   int len, float gain)
+{
+    int block = c->block;
+    if (len > c->num_parts * block)
+        return -1;
+    // The inverse transform scales the result by B
+    gain /= block;
+    for (int p = 0; p * block < len; p++) {
+        const float *part = ir + p * block;
+        int n = FFMIN(len - p * block, block);
+        bool zero = true;
+        for (int i = 0; i < n && zero; i++)
+            zero = part[i] == 0;
+        if (zero)
+            continue;
+        float **spec = &c->ir[(out * c->num_in + in) * c->num_parts + p];
+        if (!*spec) {
+            *spec = av_mallocz(2 * c->bins * sizeof(float));
+            if (!*spec)
+                return -1;
+        }
+        for (int i = 0; i < n; i++)
+            c->tmp[i] = part[i] * gain;
+        memset(c->tmp + n, 0, (2 * block - n) * sizeof(float));
+        av_rdft_calc(c->rdft, c->tmp);
+        unpack_spectrum(c->acc, c->tmp, block);
+        for (int k = 0; k < 2 * c->bins; k++)
+            (*spec)[k] += c->acc[k];
+        c->in_used[in] = true;
+    }
+    return 0;
+}
+
+void fftconv_reset(struct fftconv *c)
+{
+    for (int i = 0; i < c->num_in; i++) {
+        memset(c->win[i], 0, 2 * c->block * sizeof(float));
+        memset(c->fdl[i], 0, c->num_parts * 2 * c->bins * sizeof(float));
+    }
+    for (int o = 0; o < c->num_out; o++)
+        memset(c->out[o], 0, c->block * sizeof(float));
+    c->fdl_pos = 0;
+    c->pos = 0;
+}
+
+int fftconv_latency(struct fftconv *c)
+{
+    return c->block;
+}
+
+static void process_block(struct fftconv *c)
+{
+    int block = c->block, bins = c->bins, parts = c->num_parts;
+
+    c->fdl_pos = (c->fdl_pos + 1) % parts;
+    for (int i = 0; i < c->num_in; i++) {
+        if (c->in_used[i]) {
+            memcpy(c->tmp, c->win[i], 2 * block * sizeof(float));
+            av_rdft_calc(c->rdft, c->tmp);
+            unpack_spectrum(c->fdl[i] + c->fdl_pos * 2 * bins, c->tmp, block);
+        }
+        memcpy(c->win[i], c->win[i] + block, block * sizeof(float));
+    }
+
+    for (int o = 0; o < c->num_out; o++) {
+        memset(c->acc, 0, 2 * bins * sizeof(float));
+        for (int i = 0; i < c->num_in; i++) {
+            float **ir = &c->ir[(o * c->num_in + i) * parts];
+            for (int p = 0; p < parts; p++) {
+                if (!ir[p])
+                    continue;
+                int n = (c->fdl_pos - p + parts) % parts;
+                spectrum_mac(c->acc, c->fdl[i] + n * 2 * bins, ir[p], bins);
+            }
+        }
+        pack_spectrum(c->tmp, c->acc, block);
+        av_rdft_calc(c->irdft, c->tmp);
+        memcpy(c->out[o], c->tmp + block, block * sizeof(float));
+    }
+}
+
+void fftconv_process(struct fftconv *c, const float *in, int in_stride,
+                     float *out, int out_stride, int samples)
+{
+    while (samples > 0) {
+        int n = FFMIN(samples, c->block - c->pos);
+        for (int i = 0; i < c->num_in; i++) {
+            float *win = c->win[i] + c->block + c->pos;
+            for (int f = 0; f < n; f++)
+                win[f] = in[f * in_stride + i];
+        }
+        for (int o = 0; o < c->num_out; o++) {
+            const float *src = c->out[o] + c->pos;
+            for (int f = 0; f < n; f++)
+                out[f * out_stride + o] = src[f];
+        }
+        in += n * in_stride;
+        out += n * out_stride;
+        samples -= n;
+        c->pos += n;
+        if (c->pos == c->block) {
+            process_block(c);
+            c->pos = 0;
+        }
+    }
+}
@@ -0,0 +1,57 @@
+/*
+ * This file is part of mpv.
+ *
+ * mpv is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * mpv is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with mpv.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MPLAYER_FFTCONV_H
+#define MPLAYER_FFTCONV_H
+
+/* Uniformly partitioned FFT convolution.
+ *
+ * Convolves num_in input signals into num_out output signals: each output is
+ * the sum of all inputs, each convolved with the impulse response set for the
+ * (input, output) pair. Impulse responses are split into partitions of
+ * block_size samples, so the cost per sample grows with the number of
+ * (non-zero) partitions instead of the impulse response length.
+ *
+ * The output is delayed by block_size samples (see fftconv_latency()).
+ */
+
+struct fftconv;
+
+// block_size must be a power of 2 between 8 and 32768. max_ir_len is the
+// maximum length of the impulse responses. Returns NULL on failure.
+struct fftconv *fftconv_create(int block_size, int num_in, int num_out,
+                               int max_ir_len);
+void fftconv_destroy(struct fftconv *c);
+
+// Add ir[0..len-1]*gain to the impulse response from input in to output out.
+// Returns -1 if len is larger than max_ir_len.
+int fftconv_add_ir(struct fftconv *c, int in, int out, const float *ir,
+                   int len, float gain);
+
+// Filter samples frames. Input i is read from in[n * in_stride + i], output o
+// is written to out[n * out_stride + o], for frame n. in and out can be the
+// same buffer if the strides are equal.
+void fftconv_process(struct fftconv *c, const float *in, int in_stride,
+                     float *out, int out_stride, int samples);
+
+// Clear the signal history (e.g. after seeking).
+void fftconv_reset(struct fftconv *c);
+
+// Delay of the output, in samples
+int fftconv_latency(struct fftconv *c);
+
+#endif /* MPLAYER_FFTCONV_H */
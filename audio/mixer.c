@@ -22,6 +22,7 @@
 
 #include "config.h"
 #include "audio/out/ao.h"
+#include "audio/out/mix.h"
 #include "audio/filter/af.h"
 #include "core/mp_msg.h"
 #include "mixer.h"
@@ -242,6 +243,30 @@ void mixer_setbalance(mixer_t *mixer, float val)
                             AF_CONTROL_PAN_BALANCE | AF_CONTROL_SET, &val);
 }
 
+/* Volume (0-100) of the additional streams mixed into the AO (see
+ * audio/out/mix.h), independent of the main volume. stream is the index of
+ * the mixed stream, or -1 for all of them (getting returns the first one).
+ */
+void mixer_getmixvolume(mixer_t *mixer, int stream, float *vol)
+{
+    struct ao_mix_stream *s =
+        mixer->ao ? ao_mix_get_stream(mixer->ao, FFMAX(stream, 0)) : NULL;
+    *vol = s ? ao_mix_get_volume(s) : mixer->mix_volume;
+}
+
+void mixer_setmixvolume(mixer_t *mixer, int stream, float vol)
+{
+    vol = av_clipf(vol, 0, 100);
+    if (stream < 0)
+        mixer->mix_volume = vol;
+    if (!mixer->ao)
+        return;
+    for (int n = 0; n < ao_mix_get_num_streams(mixer->ao); n++) {
+        if (stream < 0 || stream == n)
+            ao_mix_set_volume(ao_mix_get_stream(mixer->ao, n), vol);
+    }
+}
+
 // Called after the audio filter chain is built or rebuilt.
 void mixer_reinit(struct mixer *mixer, struct ao *ao)
 {
@@ -43,6 +43,7 @@ typedef struct mixer {
     float balance;
     bool user_set_mute;
     bool user_set_volume;
+    float mix_volume;   // for streams mixed in with audio/out/mix.h
 } mixer_t;
 
 void mixer_reinit(struct mixer *mixer, struct ao *ao);
@@ -56,5 +57,7 @@ void mixer_setmute(mixer_t *mixer, bool mute);
 bool mixer_getmute(mixer_t *mixer);
 void mixer_getbalance(mixer_t *mixer, float *bal);
 void mixer_setbalance(mixer_t *mixer, float bal);
+void mixer_getmixvolume(mixer_t *mixer, int stream, float *vol);
+void mixer_setmixvolume(mixer_t *mixer, int stream, float vol);
 
 #endif /* MPLAYER_MIXER_H */
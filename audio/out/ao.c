@@ -19,14 +19,28 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <math.h>
 #include <assert.h>
 
 #include "talloc.h"
 
 #include "config.h"
 #include "ao.h"
+#include "mix.h"
 
 #include "core/mp_msg.h"
+#include "osdep/timer.h"
+
+// Bandwidth of the audio clock DLL [Hz]
+#define CLOCK_BANDWIDTH 0.2
+// Differences larger than this reset the clock instead [s]
+#define CLOCK_MAX_ERROR 0.1
+// Limit for the measured speed difference of the audio and system clocks
+#define CLOCK_MAX_DRIFT 0.005
+// Updates further apart than this reset the clock [s]. The loop gain
+// sqrt(2) * 2 * pi * CLOCK_BANDWIDTH * dt must stay well below 1, or the
+// filter overshoots and oscillates.
+#define CLOCK_MAX_INTERVAL 0.25
 
 // there are some globals:
 struct ao *global_ao;
@@ -206,7 +220,14 @@ void ao_uninit(struct ao *ao, bool cut_audio)
 
 int ao_play(struct ao *ao, void *data, int len, int flags)
 {
-    return ao->driver->play(ao, data, len, flags);
+    if (ao->mix)
+        data = ao_mix_process(ao, data, len);
+    int played = ao->driver->play(ao, data, len, flags);
+    if (ao->mix && played > 0)
+        ao_mix_consume(ao, played);
+    if (played > 0 && ao->bps)
+        ao->written += played / (double)ao->bps;
+    return played;
 }
 
 int ao_control(struct ao *ao, enum aocontrol cmd, void *arg)
@@ -216,13 +237,75 @@ int ao_control(struct ao *ao, enum aocontrol cmd, void *arg)
     return CONTROL_UNKNOWN;
 }
 
+void ao_clock_reset(struct ao_clock *clock)
+{
+    clock->valid = false;
+}
+
+// Correct the clock with the playback position pos measured at time.
+void ao_clock_update(struct ao_clock *clock, double pos, double time)
+{
+    double dt = time - clock->time;
+    if (!clock->valid || dt > CLOCK_MAX_INTERVAL) {
+        *clock = (struct ao_clock) {
+            .valid = true,
+            .pos = pos,
+            .time = time,
+            .rate = 1,
+        };
+        return;
+    }
+    if (dt <= 0)
+        return;
+    double predicted = clock->pos + clock->rate * dt;
+    double error = pos - predicted;
+    if (fabs(error) > CLOCK_MAX_ERROR) {
+        // Underrun, or a driver that doesn't report the delay at all times
+        mp_msg(MSGT_AO, MSGL_DBG2, "Audio clock off by %f, resetting.\n",
+               error);
+        clock->valid = false;
+        ao_clock_update(clock, pos, time);
+        return;
+    }
+    double omega = 2 * M_PI * CLOCK_BANDWIDTH * dt;
+    clock->pos = predicted + M_SQRT2 * omega * error;
+    clock->rate += omega * omega * error / dt;
+    if (clock->rate < 1 - CLOCK_MAX_DRIFT)
+        clock->rate = 1 - CLOCK_MAX_DRIFT;
+    if (clock->rate > 1 + CLOCK_MAX_DRIFT)
+        clock->rate = 1 + CLOCK_MAX_DRIFT;
+    clock->time = time;
+}
+
+// Estimated playback position at time.
+double ao_clock_get(struct ao_clock *clock, double time)
+{
+    return clock->pos + clock->rate * (time - clock->time);
+}
+
+/* Return the time until audio written now is played. The delay measured by
+ * the driver is passed through the audio clock, so that video timing based
+ * on it is smooth.
+ */
 double ao_get_delay(struct ao *ao)
 {
     if (!ao->driver->get_delay) {
         assert(ao->untimed);
         return 0;
     }
-    return ao->driver->get_delay(ao);
+    double now = mp_time_sec();
+    double delay, time = now;
+    if (!ao->driver->get_delay_timed ||
+        !ao->driver->get_delay_timed(ao, &delay, &time))
+        delay = ao->driver->get_delay(ao);
+    // Nothing to smooth if nothing is playing
+    if (delay <= 0 || ao->paused) {
+        ao_clock_reset(&ao->clock);
+        return delay;
+    }
+    ao_clock_update(&ao->clock, ao->written - delay, time);
+    delay = ao->written - ao_clock_get(&ao->clock, now);
+    return delay > 0 ? delay : 0;
 }
 
 int ao_get_space(struct ao *ao)
@@ -234,18 +317,21 @@ void ao_reset(struct ao *ao)
 {
     ao->buffer.len = 0;
     ao->buffer_playable_size = 0;
+    ao_clock_reset(&ao->clock);
     if (ao->driver->reset)
         ao->driver->reset(ao);
 }
 
 void ao_pause(struct ao *ao)
 {
+    ao->paused = true;
     if (ao->driver->pause)
         ao->driver->pause(ao);
 }
 
 void ao_resume(struct ao *ao)
 {
+    ao->paused = false;
     if (ao->driver->resume)
         ao->driver->resume(ao);
 }
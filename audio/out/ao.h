@@ -80,10 +80,32 @@ struct ao_driver {
     int (*get_space)(struct ao *ao);
     int (*play)(struct ao *ao, void *data, int len, int flags);
     float (*get_delay)(struct ao *ao);
+    // Optional. Like get_delay, but the driver also returns the time
+    // (mp_time_sec()) at which the delay was measured, e.g. from a timestamp
+    // of the audio hardware. *time is set to the current time on entry.
+    // Returns false if the delay can't be measured this way right now, in
+    // which case get_delay is used instead.
+    bool (*get_delay_timed)(struct ao *ao, double *delay, double *time);
     void (*pause)(struct ao *ao);
     void (*resume)(struct ao *ao);
 };
 
+/* Smoothed audio clock. Estimates the playback position of the device as a
+ * linear function of the system time, corrected with each measurement by a
+ * second order delay-locked loop. This filters out the jitter of crude delay
+ * measurements, and follows the drift between the audio and system clocks.
+ */
+struct ao_clock {
+    bool valid;
+    double pos;         // estimated playback position at time [s]
+    double time;        // mp_time_sec() of the last update
+    double rate;        // speed of the audio clock relative to system time
+};
+
+void ao_clock_reset(struct ao_clock *clock);
+void ao_clock_update(struct ao_clock *clock, double pos, double time);
+double ao_clock_get(struct ao_clock *clock, double time);
+
 /* global data used by mplayer and plugins */
 struct ao {
     int samplerate;
@@ -100,6 +122,10 @@ struct ao {
     bool untimed;
     bool no_persistent_volume;  // the AO does the equivalent of af_volume
     bool per_application_mixer; // like above, but volume persists (per app)
+    double written;     // seconds of audio accepted by play() so far
+    struct ao_clock clock;
+    bool paused;        // between ao_pause() and ao_resume()
+    struct ao_mix *mix; // additional streams mixed into the output (mix.h)
     const struct ao_driver *driver;
     void *priv;
     struct encode_lavc_context *encode_lavc_ctx;
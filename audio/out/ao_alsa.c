@@ -612,6 +612,11 @@ static int init(struct ao *ao, char *params)
             (p->alsa, alsa_swparams, boundary);
     CHECK_ALSA_ERROR("Unable to set silence size");
 
+    /* timestamp the position updates, see get_delay_timed() */
+    if (snd_pcm_sw_params_set_tstamp_mode
+            (p->alsa, alsa_swparams, SND_PCM_TSTAMP_ENABLE) < 0)
+        mp_msg(MSGT_AO, MSGL_V, "alsa-init: unable to enable timestamps\n");
+
     err = snd_pcm_sw_params(p->alsa, alsa_swparams);
     CHECK_ALSA_ERROR("Unable to get sw-parameters");
 
@@ -821,6 +826,36 @@ static float get_delay(struct ao *ao)
         return 0;
 }
 
+/* delay as above, together with the time the hardware position was read */
+static bool get_delay_timed(struct ao *ao, double *delay, double *time)
+{
+    struct priv *p = ao->priv;
+    if (!p->alsa || snd_pcm_state(p->alsa) != SND_PCM_STATE_RUNNING)
+        return false;
+
+    snd_pcm_status_t *status;
+    snd_pcm_status_alloca(&status);
+    if (snd_pcm_status(p->alsa, status) < 0)
+        return false;
+
+    snd_htimestamp_t tstamp;
+    snd_pcm_status_get_htstamp(status, &tstamp);
+    if (!tstamp.tv_sec && !tstamp.tv_nsec)
+        return false;
+    /* the timestamps use gettimeofday() unless configured otherwise */
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    double age = (now.tv_sec - tstamp.tv_sec) +
+                 (now.tv_usec * 1000L - tstamp.tv_nsec) / 1e9;
+    snd_pcm_sframes_t frames = snd_pcm_status_get_delay(status);
+    if (age < 0 || age > 1 || frames < 0)
+        return false;
+
+    *delay = (double)frames / ao->samplerate;
+    *time -= age;
+    return true;
+}
+
 const struct ao_driver audio_out_alsa = {
     .info = &(const struct ao_info) {
         "ALSA-0.9.x-1.x audio output",
@@ -834,6 +869,7 @@ const struct ao_driver audio_out_alsa = {
     .get_space = get_space,
     .play      = play,
     .get_delay = get_delay,
+    .get_delay_timed = get_delay_timed,
     .pause     = audio_pause,
     .resume    = audio_resume,
     .reset     = reset,
@@ -25,12 +25,16 @@
 
 #include "config.h"
 #include "osdep/timer.h"
+#include "core/subopt-helper.h"
 #include "audio/format.h"
 #include "ao.h"
 
 struct priv {
     double last_time;
     float buffered_bytes;
+    // Simulation of a real device, for testing the audio clock
+    float speed;        // speed of the device clock relative to system time
+    float jitter;       // maximum error of the reported delay [s]
 };
 
 static void drain(struct ao *ao)
@@ -38,7 +42,7 @@ static void drain(struct ao *ao)
     struct priv *priv = ao->priv;
 
     double now = mp_time_sec();
-    priv->buffered_bytes -= (now - priv->last_time) * ao->bps;
+    priv->buffered_bytes -= (now - priv->last_time) * ao->bps * priv->speed;
     if (priv->buffered_bytes < 0)
         priv->buffered_bytes = 0;
     priv->last_time = now;
@@ -49,6 +53,16 @@ static int init(struct ao *ao, char *params)
     struct priv *priv = talloc_zero(ao, struct priv);
     ao->priv = priv;
 
+    const opt_t subopts[] = {
+        {"speed",  OPT_ARG_FLOAT, &priv->speed,  NULL},
+        {"jitter", OPT_ARG_FLOAT, &priv->jitter, NULL},
+        {NULL}
+    };
+    priv->speed = 1;
+    if (subopt_parse(params, subopts) != 0 || priv->speed <= 0 ||
+        priv->jitter < 0)
+        return -1;
+
     struct mp_chmap_sel sel = {0};
     mp_chmap_sel_add_any(&sel);
     if (!ao_chmap_sel_adjust(ao, &sel, &ao->channels))
@@ -112,7 +126,13 @@ static float get_delay(struct ao *ao)
     struct priv *priv = ao->priv;
 
     drain(ao);
-    return priv->buffered_bytes / ao->bps;
+    float delay = priv->buffered_bytes / ao->bps;
+    if (priv->jitter) {
+        delay += (rand() / (float)RAND_MAX * 2 - 1) * priv->jitter;
+        if (delay < 0)
+            delay = 0;
+    }
+    return delay;
 }
 
 const struct ao_driver audio_out_null = {
@@ -23,6 +23,7 @@
 #include <stdlib.h>
 #include <stdbool.h>
 #include <string.h>
+#include <sys/time.h>
 
 #include <pulse/pulseaudio.h>
 
@@ -432,8 +433,10 @@ static int get_space(struct ao *ao)
     return space;
 }
 
-// Return the current latency in seconds
-static float get_delay(struct ao *ao)
+/* Return the current latency in seconds, and the system time (gettimeofday())
+ * the server's timing info refers to in *timestamp.
+ */
+static double get_latency(struct ao *ao, struct timeval *timestamp)
 {
     /* This code basically does what pa_stream_get_latency() _should_
      * do, but doesn't due to multiple known bugs in PulseAudio (at
@@ -461,6 +464,7 @@ static float get_delay(struct ao *ao)
         GENERIC_ERR_MSG(priv->context, "pa_stream_get_timing_info() failed");
         return 0;
     }
+    *timestamp = ti->timestamp;
     const struct pa_sample_spec *ss = pa_stream_get_sample_spec(priv->stream);
     if (!ss) {
         pa_threaded_mainloop_unlock(priv->mainloop);
@@ -488,6 +492,27 @@ static float get_delay(struct ao *ao)
     return latency / 1e6;
 }
 
+static float get_delay(struct ao *ao)
+{
+    struct timeval timestamp;
+    return get_latency(ao, &timestamp);
+}
+
+// As get_delay(), with the time the server's timing info was current
+static bool get_delay_timed(struct ao *ao, double *delay, double *time)
+{
+    struct timeval timestamp = {0};
+    *delay = get_latency(ao, &timestamp);
+    struct timeval now;
+    gettimeofday(&now, NULL);
+    double age = (now.tv_sec - timestamp.tv_sec) +
+                 (now.tv_usec - timestamp.tv_usec) / 1e6;
+    // *time is the current time if the timestamp is unusable
+    if (timestamp.tv_sec && age >= 0 && age <= 1)
+        *time -= age;
+    return true;
+}
+
 /* A callback function that is called when the
  * pa_context_get_sink_input_info() operation completes. Saves the
  * volume field of the specified structure to the global variable volume.
@@ -601,6 +626,7 @@ const struct ao_driver audio_out_pulse = {
     .get_space = get_space,
     .play      = play,
     .get_delay = get_delay,
+    .get_delay_timed = get_delay_timed,
     .pause     = pause,
     .resume    = resume,
 };
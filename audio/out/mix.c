@@ -0,0 +1,211 @@
+/*
+ * This file is part of mpv.
+ *
+ * mpv is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * mpv is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with mpv.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <assert.h>
+#include <string.h>
+#include <math.h>
+
+#include <libavutil/common.h>
+
+#include "talloc.h"
+
+#include "core/mp_msg.h"
+#include "core/mp_talloc.h"
+#include "audio/format.h"
+#include "ao.h"
+#include "mix.h"
+
+// Minimum amount of audio a stream keeps buffered [s]
+#define MIX_MIN_BUFFER 0.25
+
+struct ao_mix_stream {
+    char *name;
+    float volume;
+    uint8_t *data;
+    int len;            // bytes buffered
+};
+
+struct ao_mix {
+    struct ao_mix_stream **streams;
+    int num_streams;
+    int sstride;        // bytes per frame
+    uint8_t *buffer;    // main stream with the other streams added
+};
+
+/* The loops below are written so that the compiler can vectorize them (no
+ * aliasing, no data dependent branches); the s16 case uses fixed point gain.
+ */
+static void mix_float(float *restrict dst, const float *restrict src,
+                      int samples, float gain)
+{
+    for (int n = 0; n < samples; n++)
+        dst[n] += src[n] * gain;
+}
+
+static void mix_s16(int16_t *restrict dst, const int16_t *restrict src,
+                    int samples, float gain)
+{
+    int32_t g = lrintf(gain * (1 << 15));
+    for (int n = 0; n < samples; n++)
+        dst[n] = av_clip_int16(dst[n] + ((src[n] * g) >> 15));
+}
+
+static void mix_s32(int32_t *restrict dst, const int32_t *restrict src,
+                    int samples, float gain)
+{
+    for (int n = 0; n < samples; n++)
+        dst[n] = av_clipl_int32(dst[n] + (int64_t)(src[n] * (double)gain));
+}
+
+static bool format_can_mix(int format)
+{
+    return format == AF_FORMAT_FLOAT_NE || format == AF_FORMAT_S16_NE ||
+           format == AF_FORMAT_S32_NE;
+}
+
+struct ao_mix_stream *ao_mix_add_stream(struct ao *ao, const char *name)
+{
+    if (!format_can_mix(ao->format)) {
+        mp_msg(MSGT_AO, MSGL_ERR, "[mix] Can't mix audio into the output "
+               "format %s.\n", af_fmt2str_short(ao->format));
+        return NULL;
+    }
+    if (!ao->mix) {
+        ao->mix = talloc_zero(ao, struct ao_mix);
+        ao->mix->sstride = ao->channels.num * (af_fmt2bits(ao->format) / 8);
+    }
+    struct ao_mix *mix = ao->mix;
+    struct ao_mix_stream *s = talloc_zero(mix, struct ao_mix_stream);
+    s->name = talloc_strdup(s, name);
+    s->volume = 100;
+    MP_TARRAY_APPEND(mix, mix->streams, mix->num_streams, s);
+    mp_msg(MSGT_AO, MSGL_V, "[mix] Added stream '%s'.\n", name);
+    return s;
+}
+
+void ao_mix_remove_stream(struct ao *ao, struct ao_mix_stream *s)
+{
+    struct ao_mix *mix = ao->mix;
+    for (int n = 0; n < mix->num_streams; n++) {
+        if (mix->streams[n] == s) {
+            MP_TARRAY_REMOVE_AT(mix->streams, mix->num_streams, n);
+            mp_msg(MSGT_AO, MSGL_V, "[mix] Removed stream '%s'.\n", s->name);
+            talloc_free(s);
+            return;
+        }
+    }
+}
+
+int ao_mix_get_num_streams(struct ao *ao)
+{
+    return ao->mix ? ao->mix->num_streams : 0;
+}
+
+struct ao_mix_stream *ao_mix_get_stream(struct ao *ao, int index)
+{
+    if (index < 0 || index >= ao_mix_get_num_streams(ao))
+        return NULL;
+    return ao->mix->streams[index];
+}
+
+/* Streams are played along with the main stream, so they have to buffer at
+ * least as much as the main stream can play at once, which is what the AO
+ * reports as free space.
+ */
+static int stream_target_size(struct ao *ao)
+{
+    int size = FFMAX(ao_get_space(ao), ao->bps * MIX_MIN_BUFFER);
+    return size - size % ao->mix->sstride;
+}
+
+int ao_mix_get_space(struct ao *ao, struct ao_mix_stream *s)
+{
+    return FFMAX(stream_target_size(ao) - s->len, 0);
+}
+
+int ao_mix_write(struct ao *ao, struct ao_mix_stream *s, void *data, int len)
+{
+    len -= len % ao->mix->sstride;
+    if (len <= 0)
+        return 0;
+    if (talloc_get_size(s->data) < s->len + len)
+        s->data = talloc_realloc_size(s, s->data, s->len + len);
+    memcpy(s->data + s->len, data, len);
+    s->len += len;
+    return len;
+}
+
+int ao_mix_get_buffered(struct ao_mix_stream *s)
+{
+    return s->len;
+}
+
+void ao_mix_set_volume(struct ao_mix_stream *s, float volume)
+{
+    s->volume = av_clipf(volume, 0, 100);
+}
+
+float ao_mix_get_volume(struct ao_mix_stream *s)
+{
+    return s->volume;
+}
+
+void *ao_mix_process(struct ao *ao, void *data, int len)
+{
+    struct ao_mix *mix = ao->mix;
+    bool copied = false;
+    for (int n = 0; n < mix->num_streams; n++) {
+        struct ao_mix_stream *s = mix->streams[n];
+        int bytes = FFMIN(len, s->len);
+        if (!bytes || !s->volume)
+            continue;
+        // The caller keeps data that wasn't played, so don't mix into it
+        if (!copied) {
+            if (talloc_get_size(mix->buffer) < len)
+                mix->buffer = talloc_realloc_size(mix, mix->buffer, len);
+            memcpy(mix->buffer, data, len);
+            copied = true;
+        }
+        float gain = s->volume / 100.0;
+        switch (ao->format) {
+        case AF_FORMAT_FLOAT_NE:
+            mix_float((float *)mix->buffer, (float *)s->data, bytes / 4, gain);
+            break;
+        case AF_FORMAT_S16_NE:
+            mix_s16((int16_t *)mix->buffer, (int16_t *)s->data, bytes / 2,
+                    gain);
+            break;
+        case AF_FORMAT_S32_NE:
+            mix_s32((int32_t *)mix->buffer, (int32_t *)s->data, bytes / 4,
+                    gain);
+            break;
+        }
+    }
+    return copied ? mix->buffer : data;
+}
+
+void ao_mix_consume(struct ao *ao, int len)
+{
+    struct ao_mix *mix = ao->mix;
+    for (int n = 0; n < mix->num_streams; n++) {
+        struct ao_mix_stream *s = mix->streams[n];
+        int bytes = FFMIN(len, s->len);
+        memmove(s->data, s->data + bytes, s->len - bytes);
+        s->len -= bytes;
+    }
+}
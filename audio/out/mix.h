@@ -0,0 +1,59 @@
+/*
+ * This file is part of mpv.
+ *
+ * mpv is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * mpv is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with mpv.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MPLAYER_AO_MIX_H
+#define MPLAYER_AO_MIX_H
+
+/* Software mixing of additional audio streams into an open AO.
+ *
+ * The audio passed to ao_play() is the main stream. Each additional stream
+ * buffers audio in the format of the AO (the caller converts it, e.g. with its
+ * own filter chain), and is added to the main stream as it is played. Streams
+ * never block the main stream: if a stream has no data buffered, only the main
+ * stream is played.
+ *
+ * Mixing is supported if the AO format is float, s16 or s32 (native endian).
+ */
+
+struct ao;
+struct ao_mix_stream;
+
+// Returns NULL if the AO format can't be mixed.
+struct ao_mix_stream *ao_mix_add_stream(struct ao *ao, const char *name);
+void ao_mix_remove_stream(struct ao *ao, struct ao_mix_stream *s);
+
+int ao_mix_get_num_streams(struct ao *ao);
+struct ao_mix_stream *ao_mix_get_stream(struct ao *ao, int index);
+
+// Number of bytes the stream wants buffered ahead of the main stream
+int ao_mix_get_space(struct ao *ao, struct ao_mix_stream *s);
+// Buffer len bytes (cut to whole frames). Returns the number of bytes taken.
+int ao_mix_write(struct ao *ao, struct ao_mix_stream *s, void *data,
+                 int len);
+// Bytes buffered and not played yet
+int ao_mix_get_buffered(struct ao_mix_stream *s);
+
+// Volume in the range 0-100 (linear amplitude, 100 is unchanged)
+void ao_mix_set_volume(struct ao_mix_stream *s, float volume);
+float ao_mix_get_volume(struct ao_mix_stream *s);
+
+// Used by ao_play(): return data with all streams added to the first len
+// bytes, then remove the played bytes from the streams.
+void *ao_mix_process(struct ao *ao, void *data, int len);
+void ao_mix_consume(struct ao *ao, int len);
+
+#endif /* MPLAYER_AO_MIX_H */
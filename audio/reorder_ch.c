@@ -83,7 +83,7 @@ void reorder_to_packed(uint8_t *out, uint8_t **in,
                        size_t size, size_t nchan, size_t nmemb)
 {
     if (nchan == 1)
-        memcpy(out, in, size * nchan * nmemb);
+        memcpy(out, in[0], size * nchan * nmemb);
     // See reorder_to_planar() why this is done this way
     else if (size == 1)
         reorder_to_packed_(out, in, 1, nchan, nmemb);
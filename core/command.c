@@ -67,6 +67,7 @@
 
 #include "core/mp_core.h"
 #include "mp_fifo.h"
+#include "osdep/timer.h"
 #include "libavutil/avstring.h"
 
 static void change_video_filters(MPContext *mpctx, const char *cmd,
@@ -149,7 +150,7 @@ static int mp_property_playback_speed(m_option_t *prop, int action,
         opts->playback_speed = *(float *) arg;
         // Adjust time until next frame flip for nosound mode
         mpctx->time_frame *= orig_speed / opts->playback_speed;
-        if (mpctx->sh_audio)
+        if (mpctx->sh_audio && !update_playback_speed_filters(mpctx))
             reinit_audio_chain(mpctx);
         return M_PROPERTY_OK;
     }
@@ -311,6 +312,15 @@ static int mp_property_avsync(m_option_t *prop, int action, void *arg,
     return m_property_double_ro(prop, action, arg, mpctx->last_av_difference);
 }
 
+/// Time from the last seek until audio was audible again (RO)
+static int mp_property_seek_latency(m_option_t *prop, int action, void *arg,
+                                    MPContext *mpctx)
+{
+    if (!mpctx->sh_audio || !mpctx->seek_latency)
+        return M_PROPERTY_UNAVAILABLE;
+    return m_property_double_ro(prop, action, arg, mpctx->seek_latency);
+}
+
 /// Current position in percent (RW)
 static int mp_property_percent_pos(m_option_t *prop, int action,
                                    void *arg, MPContext *mpctx)
@@ -661,6 +671,24 @@ static int mp_property_volume(m_option_t *prop, int action, void *arg,
     return M_PROPERTY_NOT_IMPLEMENTED;
 }
 
+/// Volume of the files mixed in with --audio-mix (RW)
+static int mp_property_audio_mix_volume(m_option_t *prop, int action,
+                                        void *arg, MPContext *mpctx)
+{
+    if (!mpctx->num_mix_sources)
+        return M_PROPERTY_UNAVAILABLE;
+
+    switch (action) {
+    case M_PROPERTY_GET:
+        mixer_getmixvolume(&mpctx->mixer, -1, arg);
+        return M_PROPERTY_OK;
+    case M_PROPERTY_SET:
+        mixer_setmixvolume(&mpctx->mixer, -1, *(float *)arg);
+        return M_PROPERTY_OK;
+    }
+    return M_PROPERTY_NOT_IMPLEMENTED;
+}
+
 /// Mute (RW)
 static int mp_property_mute(m_option_t *prop, int action, void *arg,
                             MPContext *mpctx)
@@ -1515,6 +1543,7 @@ static const m_option_t mp_properties[] = {
     { "length", mp_property_length, CONF_TYPE_TIME,
       M_OPT_MIN, 0, 0, NULL },
     { "avsync", mp_property_avsync, CONF_TYPE_DOUBLE },
+    { "seek-latency", mp_property_seek_latency, CONF_TYPE_DOUBLE },
     { "percent-pos", mp_property_percent_pos, CONF_TYPE_INT,
       M_OPT_RANGE, 0, 100, NULL },
     { "time-pos", mp_property_time_pos, CONF_TYPE_TIME,
@@ -1547,6 +1576,8 @@ static const m_option_t mp_properties[] = {
       M_OPT_RANGE, 0, 100, NULL },
     { "mute", mp_property_mute, CONF_TYPE_FLAG,
       M_OPT_RANGE, 0, 1, NULL },
+    { "audio-mix-volume", mp_property_audio_mix_volume, CONF_TYPE_FLOAT,
+      M_OPT_RANGE, 0, 100, NULL },
     M_OPTION_PROPERTY_CUSTOM("audio-delay", mp_property_audio_delay),
     { "audio-format", mp_property_audio_format, CONF_TYPE_STRING,
       0, 0, 0, NULL },
@@ -1636,15 +1667,72 @@ static const m_option_t mp_properties[] = {
     {0},
 };
 
+// A property whose changes are reported to the slave mode client.
+struct observed_property {
+    char *name;
+    int handle;
+    double interval;        // minimum time between two checks
+    double last_check;
+    int64_t generation;     // command_ctx.generation at the last check
+    char *value;            // last reported value, or NULL
+};
+
+struct command_ctx {
+    struct m_property_index *properties;
+    // Incremented each time a property is changed through mp_property_do().
+    int64_t generation;
+    struct observed_property **observed;
+    int num_observed;
+};
+
+static struct command_ctx *get_command_ctx(struct MPContext *mpctx)
+{
+    if (!mpctx->command_ctx) {
+        struct command_ctx *ctx = talloc_zero(mpctx, struct command_ctx);
+        ctx->properties = m_property_index_new(ctx, mp_properties);
+        mpctx->command_ctx = ctx;
+    }
+    return mpctx->command_ctx;
+}
+
+static struct m_property_index *get_property_index(struct MPContext *mpctx)
+{
+    return get_command_ctx(mpctx)->properties;
+}
+
+static bool is_write_action(int action)
+{
+    return action == M_PROPERTY_SET || action == M_PROPERTY_SET_STRING ||
+           action == M_PROPERTY_SWITCH || action == M_PROPERTY_KEY_ACTION;
+}
+
 int mp_property_do(const char *name, int action, void *val,
                    struct MPContext *ctx)
 {
-    return m_property_do(mp_properties, name, action, val, ctx);
+    int r = m_property_do(get_property_index(ctx), name, action, val, ctx);
+    if (r > 0 && is_write_action(action))
+        get_command_ctx(ctx)->generation++;
+    return r;
+}
+
+int mp_property_lookup(struct MPContext *mpctx, const char *name)
+{
+    return m_property_lookup(get_property_index(mpctx), name);
+}
+
+int mp_property_do_handle(int handle, int action, void *val,
+                          struct MPContext *mpctx)
+{
+    int r = m_property_do_handle(get_property_index(mpctx), handle, action,
+                                 val, mpctx);
+    if (r > 0 && is_write_action(action))
+        get_command_ctx(mpctx)->generation++;
+    return r;
 }
 
 char *mp_property_expand_string(struct MPContext *mpctx, char *str)
 {
-    return m_properties_expand_string(mp_properties, str, mpctx);
+    return m_properties_expand_string(get_property_index(mpctx), str, mpctx);
 }
 
 void property_print_help(void)
@@ -1846,6 +1934,79 @@ static void change_video_filters(MPContext *mpctx, const char *cmd,
         queue_seek(mpctx, MPSEEK_ABSOLUTE, refresh_pts, 1);
 }
 
+static void observe_property(struct MPContext *mpctx, const char *name,
+                             double interval)
+{
+    struct command_ctx *ctx = get_command_ctx(mpctx);
+    int handle = mp_property_lookup(mpctx, name);
+    if (handle < 0) {
+        mp_msg(MSGT_GLOBAL, MSGL_INFO, "ANS_ERROR=%s\n",
+               property_error_string(handle));
+        return;
+    }
+    for (int n = 0; n < ctx->num_observed; n++) {
+        struct observed_property *o = ctx->observed[n];
+        if (strcmp(o->name, name) == 0) {
+            o->interval = interval;
+            return;
+        }
+    }
+    struct observed_property *o = talloc_ptrtype(ctx, o);
+    *o = (struct observed_property) {
+        .name = talloc_strdup(o, name),
+        .handle = handle,
+        .interval = interval,
+        .generation = -1,   // report the current value on the next update
+    };
+    MP_TARRAY_APPEND(ctx, ctx->observed, ctx->num_observed, o);
+}
+
+static void unobserve_property(struct MPContext *mpctx, const char *name)
+{
+    struct command_ctx *ctx = get_command_ctx(mpctx);
+    for (int n = 0; n < ctx->num_observed; n++) {
+        struct observed_property *o = ctx->observed[n];
+        if (strcmp(o->name, name) == 0) {
+            talloc_free(o);
+            MP_TARRAY_REMOVE_AT(ctx->observed, ctx->num_observed, n);
+            return;
+        }
+    }
+}
+
+// Print the values of observed properties that changed since the last call.
+// Each property is checked at most once per its interval, unless a property
+// was changed with mp_property_do() in the meantime.
+void mp_notify_property_changes(struct MPContext *mpctx)
+{
+    struct command_ctx *ctx = mpctx->command_ctx;
+    if (!ctx || !ctx->num_observed)
+        return;
+
+    double now = mp_time_sec();
+    for (int n = 0; n < ctx->num_observed; n++) {
+        struct observed_property *o = ctx->observed[n];
+        if (o->generation == ctx->generation &&
+            now < o->last_check + o->interval)
+            continue;
+        o->generation = ctx->generation;
+        o->last_check = now;
+
+        char *val = NULL;
+        int r = mp_property_do_handle(o->handle, M_PROPERTY_GET_STRING, &val,
+                                      mpctx);
+        if (r <= 0)
+            val = talloc_strdup(NULL, property_error_string(r));
+        if (!o->value || strcmp(o->value, val) != 0) {
+            mp_msg(MSGT_GLOBAL, MSGL_INFO, "ANS_%s=%s\n", o->name, val);
+            talloc_free(o->value);
+            o->value = talloc_steal(o, val);
+        } else {
+            talloc_free(val);
+        }
+    }
+}
+
 void run_command(MPContext *mpctx, mp_cmd_t *cmd)
 {
     struct MPOpts *opts = &mpctx->opts;
@@ -1949,6 +2110,14 @@ void run_command(MPContext *mpctx, mp_cmd_t *cmd)
         break;
     }
 
+    case MP_CMD_OBSERVE_PROPERTY:
+        observe_property(mpctx, cmd->args[0].v.s, cmd->args[1].v.f);
+        break;
+
+    case MP_CMD_UNOBSERVE_PROPERTY:
+        unobserve_property(mpctx, cmd->args[0].v.s);
+        break;
+
     case MP_CMD_SPEED_MULT: {
         float v = cmd->args[0].v.f;
         v *= mpctx->opts.playback_speed;
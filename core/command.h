@@ -23,9 +23,13 @@ struct MPContext;
 struct mp_cmd;
 
 void run_command(struct MPContext *mpctx, struct mp_cmd *cmd);
+void mp_notify_property_changes(struct MPContext *mpctx);
 char *mp_property_expand_string(struct MPContext *mpctx, char *str);
 void property_print_help(void);
 int mp_property_do(const char* name, int action, void* val,
                    struct MPContext *mpctx);
+int mp_property_lookup(struct MPContext *mpctx, const char *name);
+int mp_property_do_handle(int handle, int action, void *val,
+                          struct MPContext *mpctx);
 
 #endif /* MPLAYER_COMMAND_H */
@@ -31,6 +31,10 @@
 #include <ctype.h>
 #include <assert.h>
 
+#ifdef HAVE_EPOLL
+#include <sys/epoll.h>
+#endif
+
 #include <libavutil/avstring.h>
 #include <libavutil/common.h>
 
@@ -186,6 +190,8 @@ static const mp_cmd_t mp_cmds[] = {
   { MP_CMD_KEYDOWN_EVENTS, "key_down_event", { ARG_INT } },
   { MP_CMD_SET, "set", { ARG_STRING,  ARG_STRING } },
   { MP_CMD_GET_PROPERTY, "get_property", { ARG_STRING } },
+  { MP_CMD_OBSERVE_PROPERTY, "observe_property", { ARG_STRING, OARG_FLOAT(0.1) } },
+  { MP_CMD_UNOBSERVE_PROPERTY, "unobserve_property", { ARG_STRING } },
   { MP_CMD_ADD, "add", { ARG_STRING, OARG_FLOAT(0) } },
   { MP_CMD_CYCLE, "cycle", {
       ARG_STRING,
@@ -467,6 +473,12 @@ struct input_fd {
     unsigned dead : 1;
     unsigned got_cmd : 1;
     unsigned no_select : 1;
+    // Set by read_events() if the fd was reported readable.
+    unsigned ready : 1;
+    // Registered with epoll and currently waiting for input.
+    unsigned polled : 1;
+    // Can't be polled with epoll (e.g. regular files): always read it.
+    unsigned always_ready : 1;
     // These fields are for the cmd fds.
     char *buffer;
     int pos, size;
@@ -481,6 +493,8 @@ struct cmd_bind_section {
 
 struct cmd_queue {
     struct mp_cmd *first;
+    struct mp_cmd *last;
+    int num;
 };
 
 struct input_ctx {
@@ -524,8 +538,20 @@ struct input_ctx {
 
     struct cmd_queue key_cmd_queue;
     struct cmd_queue control_cmd_queue;
+    // Stop reading command fds while the control queue has this many entries.
+    int cmd_queue_size;
+    // Number of times command input had to be throttled for this reason.
+    int cmd_queue_overloads;
+    bool cmd_queue_overloaded;
 
     int wakeup_pipe[2];
+    int epoll_fd;
+
+    // Foreign fd (e.g. a network socket) to wait for along with input, see
+    // mp_input_wait_fd().
+    int wait_fd;
+    bool wait_write;
+    bool wait_ready;
 };
 
 
@@ -545,6 +571,7 @@ static const m_option_t input_conf[] = {
     { "cmdlist", print_cmd_list, CONF_TYPE_PRINT_FUNC, CONF_GLOBAL | CONF_NOCFG },
     OPT_STRING("js-dev", input.js_dev, CONF_GLOBAL),
     OPT_STRING("file", input.in_file, CONF_GLOBAL),
+    OPT_INTRANGE("cmdqueue-size", input.cmd_queue_size, CONF_GLOBAL, 1, 1000000),
     OPT_FLAG("default-bindings", input.default_bindings, CONF_GLOBAL),
     OPT_FLAG("test", input.test, CONF_GLOBAL),
     { NULL, NULL, 0, 0, 0, 0, NULL}
@@ -616,10 +643,7 @@ bool mp_input_is_abort_cmd(int cmd_id)
 
 static int queue_count_cmds(struct cmd_queue *queue)
 {
-    int res = 0;
-    for (struct mp_cmd *cmd = queue->first; cmd; cmd = cmd->queue_next)
-        res++;
-    return res;
+    return queue->num;
 }
 
 static bool queue_has_abort_cmds(struct cmd_queue *queue)
@@ -634,12 +658,17 @@ static bool queue_has_abort_cmds(struct cmd_queue *queue)
 static void queue_remove(struct cmd_queue *queue, struct mp_cmd *cmd)
 {
     struct mp_cmd **p_prev = &queue->first;
+    struct mp_cmd *prev = NULL;
     while (*p_prev != cmd) {
-        p_prev = &(*p_prev)->queue_next;
+        prev = *p_prev;
+        p_prev = &prev->queue_next;
     }
     // if this fails, cmd was not in the queue
     assert(*p_prev == cmd);
     *p_prev = cmd->queue_next;
+    if (queue->last == cmd)
+        queue->last = prev;
+    queue->num--;
 }
 
 static void queue_add(struct cmd_queue *queue, struct mp_cmd *cmd,
@@ -648,13 +677,65 @@ static void queue_add(struct cmd_queue *queue, struct mp_cmd *cmd,
     if (at_head) {
         cmd->queue_next = queue->first;
         queue->first = cmd;
+        if (!queue->last)
+            queue->last = cmd;
     } else {
-        struct mp_cmd **p_prev = &queue->first;
-        while (*p_prev)
-            p_prev = &(*p_prev)->queue_next;
-        *p_prev = cmd;
         cmd->queue_next = NULL;
+        if (queue->last)
+            queue->last->queue_next = cmd;
+        else
+            queue->first = cmd;
+        queue->last = cmd;
     }
+    queue->num++;
+}
+
+// Returns false if the fd can't be used.
+static bool fd_poll_add(struct input_ctx *ictx, struct input_fd *mp_fd)
+{
+#ifdef HAVE_EPOLL
+    if (ictx->epoll_fd < 0 || mp_fd->no_select)
+        return true;
+    struct epoll_event ev = { .events = EPOLLIN, .data.fd = mp_fd->fd };
+    if (epoll_ctl(ictx->epoll_fd, EPOLL_CTL_ADD, mp_fd->fd, &ev) == 0) {
+        mp_fd->polled = 1;
+    } else if (errno == EPERM) {
+        // The fd doesn't support polling (regular files and some devices,
+        // which select() considers always readable).
+        mp_fd->always_ready = 1;
+    } else {
+        mp_msg(MSGT_INPUT, MSGL_ERR, "Can't poll file descriptor %d: %s\n",
+               mp_fd->fd, strerror(errno));
+        return false;
+    }
+#endif
+    return true;
+}
+
+static void fd_poll_remove(struct input_ctx *ictx, struct input_fd *mp_fd)
+{
+#ifdef HAVE_EPOLL
+    if (ictx->epoll_fd < 0 || mp_fd->no_select || mp_fd->always_ready)
+        return;
+    epoll_ctl(ictx->epoll_fd, EPOLL_CTL_DEL, mp_fd->fd, NULL);
+#endif
+}
+
+// Temporarily stop (or resume) waiting for input on the fd.
+static void fd_poll_enable(struct input_ctx *ictx, struct input_fd *mp_fd,
+                           bool enable)
+{
+#ifdef HAVE_EPOLL
+    if (ictx->epoll_fd < 0 || mp_fd->no_select || mp_fd->always_ready ||
+        mp_fd->polled == enable)
+        return;
+    struct epoll_event ev = { .events = enable ? EPOLLIN : 0,
+                              .data.fd = mp_fd->fd };
+    if (epoll_ctl(ictx->epoll_fd, EPOLL_CTL_MOD, mp_fd->fd, &ev) < 0)
+        mp_msg(MSGT_INPUT, MSGL_WARN, "Can't poll file descriptor %d: %s\n",
+               mp_fd->fd, strerror(errno));
+    mp_fd->polled = enable;
+#endif
 }
 
 int mp_input_add_cmd_fd(struct input_ctx *ictx, int fd, int select,
@@ -678,6 +759,8 @@ int mp_input_add_cmd_fd(struct input_ctx *ictx, int fd, int select,
         .close_func = close_func,
         .no_select = !select
     };
+    if (!fd_poll_add(ictx, &ictx->cmd_fds[ictx->num_cmd_fd]))
+        return 0;
     ictx->num_cmd_fd++;
 
     return 1;
@@ -694,6 +777,7 @@ void mp_input_rm_cmd_fd(struct input_ctx *ictx, int fd)
     }
     if (i == ictx->num_cmd_fd)
         return;
+    fd_poll_remove(ictx, &cmd_fds[i]);
     if (cmd_fds[i].close_func)
         cmd_fds[i].close_func(cmd_fds[i].fd);
     talloc_free(cmd_fds[i].buffer);
@@ -715,6 +799,7 @@ void mp_input_rm_key_fd(struct input_ctx *ictx, int fd)
     }
     if (i == ictx->num_key_fd)
         return;
+    fd_poll_remove(ictx, &key_fds[i]);
     if (key_fds[i].close_func)
         key_fds[i].close_func(key_fds[i].fd);
 
@@ -746,6 +831,8 @@ int mp_input_add_key_fd(struct input_ctx *ictx, int fd, int select,
         .no_select = !select,
         .ctx = ctx,
     };
+    if (!fd_poll_add(ictx, &ictx->key_fds[ictx->num_key_fd]))
+        return 0;
     ictx->num_key_fd++;
 
     return 1;
@@ -959,24 +1046,22 @@ error:
     return NULL;
 }
 
-#define MP_CMD_MAX_SIZE 4096
+// Size of the per-fd read buffer. This is also the maximum command length.
+#define MP_CMD_BUFFER_SIZE (64 * 1024)
 
-static int read_cmd(struct input_fd *mp_fd, char **ret)
+// Read as much data as fits into the buffer with a single read call.
+static int read_cmd_data(struct input_fd *mp_fd)
 {
-    char *end;
-    *ret = NULL;
-
     // Allocate the buffer if it doesn't exist
     if (!mp_fd->buffer) {
-        mp_fd->buffer = talloc_size(NULL, MP_CMD_MAX_SIZE);
+        mp_fd->buffer = talloc_size(NULL, MP_CMD_BUFFER_SIZE);
         mp_fd->pos = 0;
-        mp_fd->size = MP_CMD_MAX_SIZE;
+        mp_fd->size = MP_CMD_BUFFER_SIZE;
     }
 
-    // Get some data if needed/possible
-    while (!mp_fd->got_cmd && !mp_fd->eof && (mp_fd->size - mp_fd->pos > 1)) {
+    while (!mp_fd->eof && mp_fd->pos < mp_fd->size) {
         int r = mp_fd->read_func.cmd(mp_fd->fd, mp_fd->buffer + mp_fd->pos,
-                                     mp_fd->size - 1 - mp_fd->pos);
+                                     mp_fd->size - mp_fd->pos);
         // Error ?
         if (r < 0) {
             switch (r) {
@@ -998,50 +1083,16 @@ static int read_cmd(struct input_fd *mp_fd, char **ret)
         mp_fd->pos += r;
         break;
     }
+    return 0;
+}
 
-    mp_fd->got_cmd = 0;
-
-    while (1) {
-        int l = 0;
-        // Find the cmd end
-        mp_fd->buffer[mp_fd->pos] = '\0';
-        end = strchr(mp_fd->buffer, '\r');
-        if (end)
-            *end = '\n';
-        end = strchr(mp_fd->buffer, '\n');
-        // No cmd end ?
-        if (!end) {
-            // If buffer is full we must drop all until the next \n
-            if (mp_fd->size - mp_fd->pos <= 1) {
-                mp_tmsg(MSGT_INPUT, MSGL_ERR, "Command buffer of file "
-                        "descriptor %d is full: dropping content.\n",
-                        mp_fd->fd);
-                mp_fd->pos = 0;
-                mp_fd->drop = 1;
-            }
-            break;
-        }
-        // We already have a cmd : set the got_cmd flag
-        else if ((*ret)) {
-            mp_fd->got_cmd = 1;
-            break;
-        }
-
-        l = end - mp_fd->buffer;
-
-        // Not dropping : put the cmd in ret
-        if (!mp_fd->drop)
-            *ret = talloc_strndup(NULL, mp_fd->buffer, l);
-        else
-            mp_fd->drop = 0;
-        mp_fd->pos -= l + 1;
-        memmove(mp_fd->buffer, end + 1, mp_fd->pos);
+static char *find_line_end(char *s, char *end)
+{
+    for (; s < end; s++) {
+        if (*s == '\n' || *s == '\r')
+            return s;
     }
-
-    if (*ret)
-        return 1;
-    else
-        return MP_INPUT_NOTHING;
+    return NULL;
 }
 
 static int default_cmd_func(int fd, char *buf, int l)
@@ -1369,24 +1420,77 @@ void mp_input_feed_key(struct input_ctx *ictx, int code)
     queue_add(queue, cmd, false);
 }
 
+static bool cmd_queue_full(struct input_ctx *ictx)
+{
+    return queue_count_cmds(&ictx->control_cmd_queue) >= ictx->cmd_queue_size;
+}
+
+// Called when pending command input can't be queued.
+static void cmd_queue_overload(struct input_ctx *ictx)
+{
+    if (ictx->cmd_queue_overloaded)
+        return;
+    ictx->cmd_queue_overloaded = true;
+    ictx->cmd_queue_overloads++;
+    mp_msg(MSGT_INPUT, ictx->cmd_queue_overloads == 1 ? MSGL_WARN : MSGL_V,
+           "Command queue full (%d commands), throttling command input.\n",
+           ictx->cmd_queue_size);
+}
+
+// Read new data from the fd (unless complete commands are still buffered),
+// and queue all complete commands found in the buffer.
 static void read_cmd_fd(struct input_ctx *ictx, struct input_fd *cmd_fd)
 {
-    int r;
-    char *text;
-    while ((r = read_cmd(cmd_fd, &text)) >= 0) {
+    if (!cmd_fd->got_cmd) {
+        int r = read_cmd_data(cmd_fd);
+        if (r == MP_INPUT_ERROR) {
+            mp_tmsg(MSGT_INPUT, MSGL_ERR,
+                    "Error on command file descriptor %d\n", cmd_fd->fd);
+        } else if (r == MP_INPUT_DEAD) {
+            cmd_fd->dead = true;
+        }
+        if (r < 0)
+            return;
+    }
+
+    cmd_fd->got_cmd = 0;
+    char *buf = cmd_fd->buffer;
+    char *cur = buf;
+    char *buf_end = buf + cmd_fd->pos;
+    while (1) {
+        char *end = find_line_end(cur, buf_end);
+        if (!end)
+            break;
+        if (cmd_queue_full(ictx)) {
+            // Leave the rest in the buffer until the queue drains.
+            cmd_fd->got_cmd = 1;
+            cmd_queue_overload(ictx);
+            break;
+        }
+        bstr line = {cur, end - cur};
+        cur = end + 1;
+        if (cmd_fd->drop) {
+            cmd_fd->drop = 0;
+            continue;
+        }
+        if (!line.len)
+            continue;
         ictx->got_new_events = true;
-        struct mp_cmd *cmd = mp_input_parse_cmd(bstr0(text), "<pipe>");
-        talloc_free(text);
+        struct mp_cmd *cmd = mp_input_parse_cmd(line, "<pipe>");
         if (cmd)
             queue_add(&ictx->control_cmd_queue, cmd, false);
-        if (!cmd_fd->got_cmd)
-            return;
     }
-    if (r == MP_INPUT_ERROR)
-        mp_tmsg(MSGT_INPUT, MSGL_ERR, "Error on command file descriptor %d\n",
-                cmd_fd->fd);
-    else if (r == MP_INPUT_DEAD)
-        cmd_fd->dead = true;
+    cmd_fd->pos = buf_end - cur;
+    if (cur != buf)
+        memmove(buf, cur, cmd_fd->pos);
+
+    // If buffer is full we must drop all until the next \n
+    if (!cmd_fd->got_cmd && cmd_fd->pos == cmd_fd->size) {
+        mp_tmsg(MSGT_INPUT, MSGL_ERR, "Command buffer of file "
+                "descriptor %d is full: dropping content.\n", cmd_fd->fd);
+        cmd_fd->pos = 0;
+        cmd_fd->drop = 1;
+    }
 }
 
 static void read_key_fd(struct input_ctx *ictx, struct input_fd *key_fd)
@@ -1420,6 +1524,9 @@ static void read_events(struct input_ctx *ictx, int time)
     ictx->got_new_events = false;
     struct input_fd *key_fds = ictx->key_fds;
     struct input_fd *cmd_fds = ictx->cmd_fds;
+    bool cmds_full = cmd_queue_full(ictx);
+    if (!cmds_full)
+        ictx->cmd_queue_overloaded = false;
     for (int i = 0; i < ictx->num_key_fd; i++)
         if (key_fds[i].dead) {
             mp_input_rm_key_fd(ictx, key_fds[i].fd);
@@ -1427,14 +1534,73 @@ static void read_events(struct input_ctx *ictx, int time)
         } else if (time && key_fds[i].no_select)
             read_key_fd(ictx, &key_fds[i]);
     for (int i = 0; i < ictx->num_cmd_fd; i++)
-        if (cmd_fds[i].dead || cmd_fds[i].eof) {
+        if (cmd_fds[i].dead || (cmd_fds[i].eof && !cmd_fds[i].got_cmd)) {
             mp_input_rm_cmd_fd(ictx, cmd_fds[i].fd);
             i--;
-        } else if (time && cmd_fds[i].no_select)
+        } else if (!cmds_full && (cmd_fds[i].got_cmd || cmd_fds[i].always_ready
+                                  || (time && cmd_fds[i].no_select))) {
+            // Buffered commands or data that doesn't need waiting for
             read_cmd_fd(ictx, &cmd_fds[i]);
-    if (ictx->got_new_events)
+        }
+    for (int i = 0; i < ictx->num_key_fd; i++) {
+        if (key_fds[i].always_ready)
+            time = 0;
+    }
+    if (ictx->got_new_events || ictx->wait_ready)
         time = 0;
-#ifdef HAVE_POSIX_SELECT
+    cmds_full = cmd_queue_full(ictx);
+    for (int i = 0; i < ictx->num_key_fd; i++)
+        key_fds[i].ready = key_fds[i].no_select;
+    for (int i = 0; i < ictx->num_cmd_fd; i++) {
+        cmd_fds[i].ready = 0;
+        fd_poll_enable(ictx, &cmd_fds[i], !cmds_full);
+    }
+#if defined(HAVE_EPOLL)
+    if (ictx->epoll_fd >= 0) {
+        struct epoll_event events[MP_MAX_KEY_FD + MP_MAX_CMD_FD + 1];
+        bool wait_added = false;
+        if (ictx->wait_fd >= 0 && !ictx->wait_ready) {
+            struct epoll_event ev = {
+                .events = ictx->wait_write ? EPOLLOUT : EPOLLIN,
+                .data.fd = ictx->wait_fd,
+            };
+            wait_added = epoll_ctl(ictx->epoll_fd, EPOLL_CTL_ADD,
+                                   ictx->wait_fd, &ev) == 0;
+            // Not pollable (EPERM): don't block waiting for it.
+            if (!wait_added) {
+                ictx->wait_ready = true;
+                time = 0;
+            }
+        }
+        int num = epoll_wait(ictx->epoll_fd, events, FF_ARRAY_ELEMS(events),
+                             time);
+        if (num < 0) {
+            if (errno != EINTR)
+                mp_tmsg(MSGT_INPUT, MSGL_ERR, "Select error: %s\n",
+                        strerror(errno));
+            num = 0;
+        }
+        if (wait_added)
+            epoll_ctl(ictx->epoll_fd, EPOLL_CTL_DEL, ictx->wait_fd, NULL);
+        for (int n = 0; n < num; n++) {
+            int fd = events[n].data.fd;
+            if (wait_added && fd == ictx->wait_fd) {
+                ictx->wait_ready = true;
+                continue;
+            }
+            for (int i = 0; i < ictx->num_key_fd; i++) {
+                if (key_fds[i].fd == fd)
+                    key_fds[i].ready = 1;
+            }
+            for (int i = 0; i < ictx->num_cmd_fd; i++) {
+                if (cmd_fds[i].fd == fd)
+                    cmd_fds[i].ready = 1;
+            }
+        }
+    } else if (time > 0) {
+        mp_sleep_us(time * 1000);
+    }
+#elif defined(HAVE_POSIX_SELECT)
     fd_set fds;
     FD_ZERO(&fds);
     int max_fd = 0;
@@ -1446,42 +1612,70 @@ static void read_events(struct input_ctx *ictx, int time)
         FD_SET(key_fds[i].fd, &fds);
     }
     for (int i = 0; i < ictx->num_cmd_fd; i++) {
-        if (cmd_fds[i].no_select)
+        if (cmd_fds[i].no_select || cmds_full)
             continue;
         if (cmd_fds[i].fd > max_fd)
             max_fd = cmd_fds[i].fd;
         FD_SET(cmd_fds[i].fd, &fds);
     }
+    fd_set wfds;
+    FD_ZERO(&wfds);
+    int wait_fd = ictx->wait_ready ? -1 : ictx->wait_fd;
+    if (wait_fd >= 0) {
+        FD_SET(wait_fd, ictx->wait_write ? &wfds : &fds);
+        if (wait_fd > max_fd)
+            max_fd = wait_fd;
+    }
     struct timeval tv, *time_val;
     tv.tv_sec = time / 1000;
     tv.tv_usec = (time % 1000) * 1000;
     time_val = &tv;
-    if (select(max_fd + 1, &fds, NULL, NULL, time_val) < 0) {
+    if (select(max_fd + 1, &fds, &wfds, NULL, time_val) < 0) {
         if (errno != EINTR)
             mp_tmsg(MSGT_INPUT, MSGL_ERR, "Select error: %s\n",
                     strerror(errno));
         FD_ZERO(&fds);
+        FD_ZERO(&wfds);
+    }
+    if (wait_fd >= 0 && FD_ISSET(wait_fd, ictx->wait_write ? &wfds : &fds))
+        ictx->wait_ready = true;
+    for (int i = 0; i < ictx->num_key_fd; i++) {
+        if (!key_fds[i].no_select && FD_ISSET(key_fds[i].fd, &fds))
+            key_fds[i].ready = 1;
+    }
+    for (int i = 0; i < ictx->num_cmd_fd; i++) {
+        if (!cmd_fds[i].no_select && !cmds_full &&
+            FD_ISSET(cmd_fds[i].fd, &fds))
+            cmd_fds[i].ready = 1;
     }
 #else
+    // Can't wait for the fd: sleep a bit and let the caller try it.
+    if (ictx->wait_fd >= 0)
+        time = FFMIN(time, 10);
     if (time > 0)
         mp_sleep_us(time * 1000);
+    if (ictx->wait_fd >= 0)
+        ictx->wait_ready = true;
+    for (int i = 0; i < ictx->num_key_fd; i++)
+        key_fds[i].ready = 1;
+    for (int i = 0; i < ictx->num_cmd_fd; i++)
+        cmd_fds[i].ready = 1;
 #endif
 
-
     for (int i = 0; i < ictx->num_key_fd; i++) {
-#ifdef HAVE_POSIX_SELECT
-        if (!key_fds[i].no_select && !FD_ISSET(key_fds[i].fd, &fds))
-            continue;
-#endif
-        read_key_fd(ictx, &key_fds[i]);
+        if (key_fds[i].ready || key_fds[i].always_ready)
+            read_key_fd(ictx, &key_fds[i]);
     }
 
     for (int i = 0; i < ictx->num_cmd_fd; i++) {
-#ifdef HAVE_POSIX_SELECT
-        if (!cmd_fds[i].no_select && !FD_ISSET(cmd_fds[i].fd, &fds))
+        struct input_fd *cmd_fd = &cmd_fds[i];
+        if (!(cmd_fd->ready || cmd_fd->no_select || cmd_fd->always_ready))
             continue;
-#endif
-        read_cmd_fd(ictx, &cmd_fds[i]);
+        if (cmd_queue_full(ictx)) {
+            cmd_queue_overload(ictx);
+            break;
+        }
+        read_cmd_fd(ictx, cmd_fd);
     }
 }
 
@@ -1770,10 +1964,20 @@ struct input_ctx *mp_input_init(struct input_conf *input_conf,
         .ar_rate = input_conf->ar_rate,
         .default_bindings = input_conf->default_bindings,
         .test = input_conf->test,
+        .cmd_queue_size = input_conf->cmd_queue_size,
         .wakeup_pipe = {-1, -1},
+        .epoll_fd = -1,
+        .wait_fd = -1,
     };
     ictx->section = talloc_strdup(ictx, "default");
 
+#ifdef HAVE_EPOLL
+    ictx->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (ictx->epoll_fd < 0)
+        mp_msg(MSGT_INPUT, MSGL_WARN, "Failed to create epoll instance: %s\n",
+               strerror(errno));
+#endif
+
     parse_config(ictx, true, bstr0(builtin_input_conf), "<default>");
 
 #ifndef __MINGW32__
@@ -1902,6 +2106,13 @@ void mp_input_uninit(struct input_ctx *ictx, struct input_conf *input_conf)
         if (ictx->wakeup_pipe[i] != -1)
             close(ictx->wakeup_pipe[i]);
     }
+    if (ictx->epoll_fd >= 0)
+        close(ictx->epoll_fd);
+    if (ictx->cmd_queue_overloads) {
+        mp_msg(MSGT_INPUT, MSGL_V, "Command input was throttled %d times "
+               "because the command queue was full.\n",
+               ictx->cmd_queue_overloads);
+    }
     clear_queue(&ictx->key_cmd_queue);
     clear_queue(&ictx->control_cmd_queue);
     talloc_free(ictx->ar_cmd);
@@ -1965,6 +2176,25 @@ int mp_input_check_interrupt(struct input_ctx *ictx, int time)
     }
 }
 
+/**
+ * Wait until fd is readable (or writable if for_write is set), processing
+ * input events meanwhile, so that a user abort stops the wait immediately.
+ * \param time maximum time to wait in milliseconds
+ * \return 1 if the fd is ready, 0 if not (timeout or other input), -1 if
+ *         the current operation should be aborted
+ */
+int mp_input_wait_fd(struct input_ctx *ictx, int fd, bool for_write, int time)
+{
+    ictx->wait_fd = fd;
+    ictx->wait_write = for_write;
+    ictx->wait_ready = false;
+    int interrupted = mp_input_check_interrupt(ictx, time);
+    ictx->wait_fd = -1;
+    if (interrupted)
+        return -1;
+    return ictx->wait_ready;
+}
+
 unsigned int mp_input_get_mouse_event_counter(struct input_ctx *ictx)
 {
     return ictx->mouse_event_counter;
@@ -54,6 +54,8 @@ enum mp_command_type {
     MP_CMD_KEYDOWN_EVENTS,
     MP_CMD_SET,
     MP_CMD_GET_PROPERTY,
+    MP_CMD_OBSERVE_PROPERTY,
+    MP_CMD_UNOBSERVE_PROPERTY,
     MP_CMD_PRINT_TEXT,
     MP_CMD_SHOW_TEXT,
     MP_CMD_SHOW_PROGRESS,
@@ -223,6 +225,9 @@ void mp_input_wakeup(struct input_ctx *ictx);
 // Interruptible usleep:  (used by demux)
 int mp_input_check_interrupt(struct input_ctx *ictx, int time);
 
+// Wait for a fd to become ready, but stop early on user abort.
+int mp_input_wait_fd(struct input_ctx *ictx, int fd, bool for_write, int time);
+
 extern int async_quit_request;
 
 #endif /* MPLAYER_INPUT_H */
@@ -33,6 +33,8 @@
 #include "m_config.h"
 #include "core/m_option.h"
 #include "core/mp_msg.h"
+#include "core/mp_strmap.h"
+#include "core/mp_talloc.h"
 
 #define MAX_PROFILE_DEPTH 20
 
@@ -173,11 +175,20 @@ static int config_destroy(void *p)
     return 0;
 }
 
+struct m_config_lookup {
+    // Maps full option names to m_config_option (NULL if outdated)
+    struct mp_strmap *names;
+    // Options whose name ends with a wildcard; not included in the map
+    struct m_config_option **wildcards;
+    int num_wildcards;
+};
+
 struct m_config *m_config_simple(void *optstruct)
 {
     struct m_config *config = talloc_struct(NULL, struct m_config, {
         .optstruct = optstruct,
     });
+    config->lookup = talloc_zero(config, struct m_config_lookup);
     talloc_set_destructor(config, config_destroy);
     return config;
 }
@@ -416,6 +427,8 @@ static void m_config_add_option(struct m_config *config,
     if (!is_merge_opt(co->opt)) {
         co->next = config->opts;
         config->opts = co;
+        talloc_free(config->lookup->names);
+        config->lookup->names = NULL;
     }
 
     add_negation_option(config, parent, arg);
@@ -432,19 +445,45 @@ int m_config_register_options(struct m_config *config,
     return 1;
 }
 
+static bool is_wildcard_option(struct m_config_option *co)
+{
+    return (co->opt->type->flags & M_OPT_TYPE_ALLOW_WILDCARD)
+           && bstr_endswith0(bstr0(co->name), "*");
+}
+
+static void build_lookup(const struct m_config *config)
+{
+    struct m_config_lookup *lookup = config->lookup;
+    lookup->names = mp_strmap_new(lookup);
+    lookup->wildcards = NULL;
+    lookup->num_wildcards = 0;
+    // Options added later come first in the list, and take precedence.
+    for (struct m_config_option *co = config->opts; co; co = co->next) {
+        if (is_wildcard_option(co)) {
+            MP_TARRAY_APPEND(lookup->names, lookup->wildcards,
+                             lookup->num_wildcards, co);
+        } else {
+            mp_strmap_add(lookup->names, bstr0(co->name), co);
+        }
+    }
+}
+
 struct m_config_option *m_config_get_co(const struct m_config *config,
                                         struct bstr name)
 {
-    struct m_config_option *co;
+    struct m_config_lookup *lookup = config->lookup;
+    if (!lookup->names)
+        build_lookup(config);
 
-    for (co = config->opts; co; co = co->next) {
+    struct m_config_option *co = mp_strmap_get(lookup->names, name);
+    if (co)
+        return co;
+
+    for (int n = 0; n < lookup->num_wildcards; n++) {
+        co = lookup->wildcards[n];
         struct bstr coname = bstr0(co->name);
-        if ((co->opt->type->flags & M_OPT_TYPE_ALLOW_WILDCARD)
-                && bstr_endswith0(coname, "*")) {
-            coname.len--;
-            if (bstrcmp(bstr_splice(name, 0, coname.len), coname) == 0)
-                return co;
-        } else if (bstrcmp(coname, name) == 0)
+        coname.len--;
+        if (bstrcmp(bstr_splice(name, 0, coname.len), coname) == 0)
             return co;
     }
     return NULL;
@@ -83,6 +83,9 @@ typedef struct m_config {
 
     void *optstruct; // struct mpopts or other
     int (*includefunc)(struct m_config *conf, char *filename);
+
+    // Name lookup table for m_config_get_co(), built on demand.
+    struct m_config_lookup *lookup;
 } m_config_t;
 
 // Create a new config object.
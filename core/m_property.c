@@ -34,6 +34,7 @@
 #include "m_property.h"
 #include "core/mp_msg.h"
 #include "core/mp_common.h"
+#include "core/mp_strmap.h"
 
 const struct m_option_type m_option_type_dummy = {
     .name = "Unknown",
@@ -82,28 +83,89 @@ static bool translate_legacy_property(const char *name, char *buffer,
     return true;
 }
 
-static int do_action(const m_option_t *prop_list, const char *name,
-                     int action, void *arg, void *ctx)
-{
-    const char *sep;
+// Cap on the number of names cached by a m_property_index.
+#define MAX_HANDLES 4096
+
+// A resolved property name.
+struct m_property_handle {
     const m_option_t *prop;
-    if ((sep = strchr(name, '/')) && sep[1]) {
-        int len = sep - name;
-        char base[len + 1];
-        memcpy(base, name, len);
-        base[len] = 0;
-        prop = m_option_list_find(prop_list, base);
-        struct m_property_action_arg ka = {
-            .key = sep + 1,
+    const char *key;            // for "name/key", NULL otherwise
+    const char *name;           // translated name, used for messages
+};
+
+struct m_property_index {
+    // Base property name -> entry in prop_list
+    struct mp_strmap *props;
+    // Name as requested by the user -> handle index + 1
+    struct mp_strmap *names;
+    struct m_property_handle *handles;
+    int num_handles;
+};
+
+struct m_property_index *m_property_index_new(void *talloc_ctx,
+                                              const m_option_t *prop_list)
+{
+    struct m_property_index *index = talloc_zero(talloc_ctx,
+                                                 struct m_property_index);
+    index->props = mp_strmap_new(index);
+    index->names = mp_strmap_new(index);
+    for (int n = 0; prop_list[n].name; n++)
+        mp_strmap_add(index->props, bstr0(prop_list[n].name),
+                      (void *)&prop_list[n]);
+    return index;
+}
+
+// Translate the name and split it into the property and sub-property key.
+// Strings in the result are allocated with ta_ctx.
+static bool resolve_name(struct m_property_index *index, void *ta_ctx,
+                         const char *in_name, struct m_property_handle *res)
+{
+    char name[64];
+    if (!translate_legacy_property(in_name, name, sizeof(name)))
+        return false;
+
+    *res = (struct m_property_handle) {
+        .name = talloc_strdup(ta_ctx, name),
+    };
+    bstr base = bstr0(name);
+    const char *sep = strchr(name, '/');
+    if (sep && sep[1]) {
+        base.len = sep - name;
+        res->key = talloc_strdup(ta_ctx, sep + 1);
+    }
+    res->prop = mp_strmap_get(index->props, base);
+    return !!res->prop;
+}
+
+int m_property_lookup(struct m_property_index *index, const char *name)
+{
+    void *h = mp_strmap_get(index->names, bstr0(name));
+    if (h)
+        return (intptr_t)h - 1;
+    if (index->num_handles >= MAX_HANDLES)
+        return M_PROPERTY_ERROR;
+    struct m_property_handle handle;
+    if (!resolve_name(index, index, name, &handle))
+        return M_PROPERTY_UNKNOWN;
+    MP_TARRAY_APPEND(index, index->handles, index->num_handles, handle);
+    mp_strmap_add(index->names, bstr0(name), (void *)(intptr_t)index->num_handles);
+    return index->num_handles - 1;
+}
+
+static int do_action(struct m_property_handle *h, int action, void *arg,
+                     void *ctx)
+{
+    const m_option_t *prop = h->prop;
+    struct m_property_action_arg ka;
+    if (h->key) {
+        ka = (struct m_property_action_arg) {
+            .key = h->key,
             .action = action,
             .arg = arg,
         };
         action = M_PROPERTY_KEY_ACTION;
         arg = &ka;
-    } else
-        prop = m_option_list_find(prop_list, name);
-    if (!prop)
-        return M_PROPERTY_UNKNOWN;
+    }
     int (*control)(const m_option_t*, int, void*, void*) = prop->p;
     int r = control(prop, action, arg, ctx);
     if (action == M_PROPERTY_GET_TYPE && r < 0 &&
@@ -115,28 +177,24 @@ static int do_action(const m_option_t *prop_list, const char *name,
     return r;
 }
 
-int m_property_do(const m_option_t *prop_list, const char *in_name,
-                  int action, void *arg, void *ctx)
+static int do_property(struct m_property_handle *h, int action, void *arg,
+                       void *ctx)
 {
     union m_option_value val = {0};
     int r;
 
-    char name[64];
-    if (!translate_legacy_property(in_name, name, sizeof(name)))
-        return M_PROPERTY_UNKNOWN;
-
     struct m_option opt = {0};
-    r = do_action(prop_list, name, M_PROPERTY_GET_TYPE, &opt, ctx);
+    r = do_action(h, M_PROPERTY_GET_TYPE, &opt, ctx);
     if (r <= 0)
         return r;
     assert(opt.type);
 
     switch (action) {
     case M_PROPERTY_PRINT: {
-        if ((r = do_action(prop_list, name, M_PROPERTY_PRINT, arg, ctx)) >= 0)
+        if ((r = do_action(h, M_PROPERTY_PRINT, arg, ctx)) >= 0)
             return r;
         // Fallback to m_option
-        if ((r = do_action(prop_list, name, M_PROPERTY_GET, &val, ctx)) <= 0)
+        if ((r = do_action(h, M_PROPERTY_GET, &val, ctx)) <= 0)
             return r;
         char *str = m_option_pretty_print(&opt, &val);
         m_option_free(&opt, &val);
@@ -144,7 +202,7 @@ int m_property_do(const m_option_t *prop_list, const char *in_name,
         return str != NULL;
     }
     case M_PROPERTY_GET_STRING: {
-        if ((r = do_action(prop_list, name, M_PROPERTY_GET, &val, ctx)) <= 0)
+        if ((r = do_action(h, M_PROPERTY_GET, &val, ctx)) <= 0)
             return r;
         char *str = m_option_print(&opt, &val);
         m_option_free(&opt, &val);
@@ -153,56 +211,82 @@ int m_property_do(const m_option_t *prop_list, const char *in_name,
     }
     case M_PROPERTY_SET_STRING: {
         // (reject 0 return value: success, but empty string with flag)
-        if (m_option_parse(&opt, bstr0(name), bstr0(arg), &val) <= 0)
+        if (m_option_parse(&opt, bstr0(h->name), bstr0(arg), &val) <= 0)
             return M_PROPERTY_ERROR;
-        r = do_action(prop_list, name, M_PROPERTY_SET, &val, ctx);
+        r = do_action(h, M_PROPERTY_SET, &val, ctx);
         m_option_free(&opt, &val);
         return r;
     }
     case M_PROPERTY_SWITCH: {
         struct m_property_switch_arg *sarg = arg;
-        if ((r = do_action(prop_list, name, M_PROPERTY_SWITCH, arg, ctx)) !=
+        if ((r = do_action(h, M_PROPERTY_SWITCH, arg, ctx)) !=
             M_PROPERTY_NOT_IMPLEMENTED)
             return r;
         // Fallback to m_option
         if (!opt.type->add)
             return M_PROPERTY_NOT_IMPLEMENTED;
-        if ((r = do_action(prop_list, name, M_PROPERTY_GET, &val, ctx)) <= 0)
+        if ((r = do_action(h, M_PROPERTY_GET, &val, ctx)) <= 0)
             return r;
         opt.type->add(&opt, &val, sarg->inc, sarg->wrap);
-        r = do_action(prop_list, name, M_PROPERTY_SET, &val, ctx);
+        r = do_action(h, M_PROPERTY_SET, &val, ctx);
         m_option_free(&opt, &val);
         return r;
     }
     case M_PROPERTY_SET: {
         if (!opt.type->clamp) {
             mp_msg(MSGT_CPLAYER, MSGL_WARN, "Property '%s' without clamp().\n",
-                   name);
+                   h->name);
         } else {
             m_option_copy(&opt, &val, arg);
             r = opt.type->clamp(&opt, arg);
             m_option_free(&opt, &val);
             if (r != 0) {
                 mp_msg(MSGT_CPLAYER, MSGL_ERR,
-                       "Property '%s': invalid value.\n", name);
+                       "Property '%s': invalid value.\n", h->name);
                 return M_PROPERTY_ERROR;
             }
         }
-        return do_action(prop_list, name, M_PROPERTY_SET, arg, ctx);
+        return do_action(h, M_PROPERTY_SET, arg, ctx);
     }
     default:
-        return do_action(prop_list, name, action, arg, ctx);
+        return do_action(h, action, arg, ctx);
     }
 }
 
-static int m_property_do_bstr(const m_option_t *prop_list, bstr name,
+int m_property_do_handle(struct m_property_index *index, int handle,
+                         int action, void *arg, void *ctx)
+{
+    if (handle < 0 || handle >= index->num_handles)
+        return M_PROPERTY_UNKNOWN;
+    return do_property(&index->handles[handle], action, arg, ctx);
+}
+
+int m_property_do(struct m_property_index *index, const char *name,
+                  int action, void *arg, void *ctx)
+{
+    int handle = m_property_lookup(index, name);
+    if (handle >= 0)
+        return do_property(&index->handles[handle], action, arg, ctx);
+    if (handle != M_PROPERTY_ERROR)
+        return handle;
+    // Too many names cached; resolve without caching
+    void *tmp = talloc_new(NULL);
+    struct m_property_handle h;
+    int r = M_PROPERTY_UNKNOWN;
+    if (resolve_name(index, tmp, name, &h))
+        r = do_property(&h, action, arg, ctx);
+    talloc_free(tmp);
+    return r;
+}
+
+static int m_property_do_bstr(struct m_property_index *index, bstr name,
                               int action, void *arg, void *ctx)
 {
     char name0[64];
     if (name.len >= sizeof(name0))
         return M_PROPERTY_UNKNOWN;
     snprintf(name0, sizeof(name0), "%.*s", BSTR_P(name));
-    return m_property_do(prop_list, name0, action, arg, ctx);
+    return m_property_do(index, name0, action, arg, ctx);
 }
 
 static void append_str(char **s, int *len, bstr append)
@@ -212,7 +296,7 @@ static void append_str(char **s, int *len, bstr append)
     *len = *len + append.len;
 }
 
-char *m_properties_expand_string(const m_option_t *prop_list, char *str0,
+char *m_properties_expand_string(struct m_property_index *index, char *str0,
                                  void *ctx)
 {
     char *ret = NULL;
@@ -245,7 +329,7 @@ char *m_properties_expand_string(const m_option_t *prop_list, char *str0,
                              ? M_PROPERTY_GET_STRING : M_PROPERTY_PRINT;
 
                 char *s = NULL;
-                int r = m_property_do_bstr(prop_list, name, method, &s, ctx);
+                int r = m_property_do_bstr(index, name, method, &s, ctx);
                 if (cond_yes || cond_no) {
                     skip = (!!s != cond_yes);
                 } else {
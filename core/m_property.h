@@ -102,13 +102,30 @@ enum mp_property_return {
     M_PROPERTY_UNKNOWN = -3,
 };
 
+// Hash table for looking up properties by name. Resolved names are cached,
+// so repeated accesses to the same property are cheap.
+// prop_list must stay valid as long as the index is used.
+struct m_property_index;
+struct m_property_index *m_property_index_new(void *talloc_ctx,
+                                              const struct m_option *prop_list);
+
 // Access a property.
 // action: one of m_property_action
 // ctx: opaque value passed through to property implementation
 // returns: one of mp_property_return
-int m_property_do(const struct m_option* prop_list, const char* property_name,
+int m_property_do(struct m_property_index *index, const char* property_name,
                   int action, void* arg, void *ctx);
 
+// Resolve a property name (including sub-property keys and deprecated names)
+// once, and return a handle that can be passed to m_property_do_handle().
+// Handles stay valid for the lifetime of the index.
+// returns: handle >= 0, or M_PROPERTY_UNKNOWN/M_PROPERTY_ERROR
+int m_property_lookup(struct m_property_index *index, const char *name);
+
+// Like m_property_do(), but using a handle returned by m_property_lookup().
+int m_property_do_handle(struct m_property_index *index, int handle,
+                         int action, void *arg, void *ctx);
+
 // Print a list of properties.
 void m_properties_print_help_list(const struct m_option* list);
 
@@ -124,7 +141,7 @@ void m_properties_print_help_list(const struct m_option* list);
 // STR is recursively expanded using the same rules.
 // "$$" can be used to escape "$", and "$}" to escape "}".
 // "$>" disables parsing of "$" for the rest of the string.
-char* m_properties_expand_string(const struct m_option* prop_list, char *str,
+char* m_properties_expand_string(struct m_property_index *index, char *str,
                                  void *ctx);
 
 // Trivial helpers for implementing properties.
@@ -22,6 +22,7 @@
 #include <stdbool.h>
 
 #include "core/options.h"
+#include "audio/chmap.h"
 #include "audio/mixer.h"
 #include "demux/demux.h"
 
@@ -130,6 +131,8 @@ typedef struct MPContext {
     struct playlist *playlist;
     char *filename; // currently playing file
     struct mp_resolve_result *resolve_result;
+    // Next playlist entry, opened in the background (--prefetch-playlist)
+    struct mp_prefetch *prefetch;
     enum stop_play_reason stop_play;
     unsigned int initialized_flags;  // which subsystems have been initialized
 
@@ -168,6 +171,13 @@ typedef struct MPContext {
 
     mixer_t mixer;
     struct ao *ao;
+    // Files mixed into the audio output (--audio-mix), opened with the AO
+    struct mix_source **mix_sources;
+    int num_mix_sources;
+    // Decoder output format the AO was opened for (--gapless-audio=weak)
+    int ao_decoder_samplerate;
+    int ao_decoder_format;
+    struct mp_chmap ao_decoder_channels;
     struct vo *video_out;
 
     /* We're starting playback from scratch or after a seek. Show first
@@ -204,6 +214,11 @@ typedef struct MPContext {
     // the same value if the status line is updated at a time where no new
     // video frame is shown.
     double last_av_difference;
+    // mp_time_us() at the last seek, until the audio is written to the AO
+    // again (0 otherwise).
+    int64_t seek_start_time;
+    // Time from the last seek until the audio became audible, in seconds.
+    double seek_latency;
     /* timestamp of video frame currently visible on screen
      * (or at least queued to be flipped by VO) */
     double video_pts;
@@ -275,6 +290,7 @@ typedef struct MPContext {
     bool drop_message_shown;
 
     struct screenshot_ctx *screenshot_ctx;
+    struct command_ctx *command_ctx;
 
     char *track_layout_hash;
 
@@ -289,6 +305,7 @@ extern int forced_subs_only;
 
 void uninit_player(struct MPContext *mpctx, unsigned int mask);
 void reinit_audio_chain(struct MPContext *mpctx);
+bool update_playback_speed_filters(struct MPContext *mpctx);
 double playing_audio_pts(struct MPContext *mpctx);
 struct track *mp_add_subtitles(struct MPContext *mpctx, char *filename,
                                float fps, int noerr);
@@ -327,5 +344,11 @@ void build_ordered_chapter_timeline(struct MPContext *mpctx);
 void build_edl_timeline(struct MPContext *mpctx);
 // timeline/tl_cue.c
 void build_cue_timeline(struct MPContext *mpctx);
+// timeline/tl_open.c
+typedef struct demuxer *(*timeline_open_fn)(void *ctx, int index,
+                                            struct MPOpts *opts);
+void timeline_open_sources(struct MPContext *mpctx, int num,
+                           timeline_open_fn open_fn, void *fn_ctx,
+                           struct demuxer **demuxers);
 
 #endif /* MPLAYER_MP_CORE_H */
@@ -23,6 +23,7 @@
 #include <unistd.h>
 
 #include "config.h"
+#include "talloc.h"
 #include "osdep/getch2.h"
 #include "osdep/io.h"
 
@@ -35,6 +36,10 @@
 #include <signal.h>
 #endif
 
+#ifdef HAVE_PTHREADS
+#include <pthread.h>
+#endif
+
 #include "core/mp_msg.h"
 
 bool mp_msg_stdout_in_use = 0;
@@ -74,6 +79,206 @@ static int mp_msg_docolor(void) {
 	return mp_msg_cancolor && mp_msg_color;
 }
 
+#ifdef HAVE_PTHREADS
+
+/* Messages are formatted by the calling thread, and written to the terminal
+ * by a separate thread, so that slow output can't stall playback. */
+
+#define MSG_QUEUE_SIZE 1024
+
+struct msg_entry {
+    int mod, lev;
+    // number of identical messages following this one
+    int repeat;
+    // number of messages lost after this one because the queue was full
+    int dropped;
+    char *text;
+};
+
+static struct msg_queue {
+    pthread_mutex_t lock;
+    pthread_cond_t wakeup;
+    pthread_cond_t drained;
+    pthread_t thread;
+    bool running;
+    bool terminate;
+    // entry currently being written by the writer thread
+    bool busy;
+    struct msg_entry entries[MSG_QUEUE_SIZE];
+    int start, num;
+} msg_queue = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .wakeup = PTHREAD_COND_INITIALIZER,
+    .drained = PTHREAD_COND_INITIALIZER,
+};
+
+// Serializes terminal output between the writer thread and synchronous output.
+static pthread_mutex_t msg_output_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void print_msg(int mod, int lev, const char *text);
+
+static void *msg_thread(void *arg)
+{
+    struct msg_queue *q = &msg_queue;
+    pthread_mutex_lock(&q->lock);
+    while (1) {
+        while (!q->num && !q->terminate)
+            pthread_cond_wait(&q->wakeup, &q->lock);
+        if (!q->num)
+            break;
+        struct msg_entry e = q->entries[q->start];
+        q->start = (q->start + 1) % MSG_QUEUE_SIZE;
+        q->num--;
+        q->busy = true;
+        pthread_mutex_unlock(&q->lock);
+
+        pthread_mutex_lock(&msg_output_lock);
+        print_msg(e.mod, e.lev, e.text);
+        char buf[80];
+        if (e.repeat) {
+            snprintf(buf, sizeof(buf), "[last message repeated %d times]\n",
+                     e.repeat);
+            print_msg(e.mod, e.lev, buf);
+        }
+        if (e.dropped) {
+            snprintf(buf, sizeof(buf), "[%d log messages dropped]\n",
+                     e.dropped);
+            print_msg(MSGT_GLOBAL, MSGL_WARN, buf);
+        }
+        pthread_mutex_unlock(&msg_output_lock);
+        talloc_free(e.text);
+
+        pthread_mutex_lock(&q->lock);
+        q->busy = false;
+        if (!q->num)
+            pthread_cond_broadcast(&q->drained);
+    }
+    q->running = false;
+    pthread_cond_broadcast(&q->drained);
+    pthread_mutex_unlock(&q->lock);
+    return NULL;
+}
+
+// Returns false if the message must be printed synchronously.
+static bool queue_msg(int mod, int lev, const char *text)
+{
+    struct msg_queue *q = &msg_queue;
+    pthread_mutex_lock(&q->lock);
+    if (!q->running || q->terminate) {
+        pthread_mutex_unlock(&q->lock);
+        return false;
+    }
+    if (q->num) {
+        struct msg_entry *last =
+            &q->entries[(q->start + q->num - 1) % MSG_QUEUE_SIZE];
+        if (last->dropped) {
+            // Keep dropping until the queue has drained a bit.
+            if (q->num > MSG_QUEUE_SIZE / 2) {
+                last->dropped++;
+                goto done;
+            }
+        } else if (last->lev == MSGL_STATUS && lev == MSGL_STATUS) {
+            // Status lines overwrite each other; only the newest matters.
+            talloc_free(last->text);
+            last->mod = mod;
+            last->text = talloc_strdup(NULL, text);
+            goto done;
+        }
+        size_t len = strlen(text);
+        if (!last->dropped && last->mod == mod && last->lev == lev && len &&
+            text[len - 1] == '\n' && strcmp(last->text, text) == 0)
+        {
+            last->repeat++;
+            goto done;
+        }
+    }
+    if (q->num == MSG_QUEUE_SIZE) {
+        q->entries[(q->start + q->num - 1) % MSG_QUEUE_SIZE].dropped++;
+        goto done;
+    }
+    q->entries[(q->start + q->num) % MSG_QUEUE_SIZE] = (struct msg_entry){
+        .mod = mod,
+        .lev = lev,
+        .text = talloc_strdup(NULL, text),
+    };
+    q->num++;
+    pthread_cond_signal(&q->wakeup);
+done:
+    pthread_mutex_unlock(&q->lock);
+    return true;
+}
+
+void mp_msg_flush(void)
+{
+    struct msg_queue *q = &msg_queue;
+    pthread_mutex_lock(&q->lock);
+    while (q->running && (q->num || q->busy))
+        pthread_cond_wait(&q->drained, &q->lock);
+    pthread_mutex_unlock(&q->lock);
+}
+
+void mp_msg_uninit(void)
+{
+    struct msg_queue *q = &msg_queue;
+    pthread_mutex_lock(&q->lock);
+    bool running = q->running;
+    q->terminate = true;
+    pthread_cond_signal(&q->wakeup);
+    pthread_mutex_unlock(&q->lock);
+    if (running)
+        pthread_join(q->thread, NULL);
+}
+
+/* The writer thread may hold either lock while the cache process is forked,
+ * so take both to keep the child from inheriting a locked mutex. No other
+ * code holds both at the same time, so the order can't deadlock.
+ */
+static void msg_atfork_prepare(void)
+{
+    pthread_mutex_lock(&msg_output_lock);
+    pthread_mutex_lock(&msg_queue.lock);
+}
+
+static void msg_atfork_parent(void)
+{
+    pthread_mutex_unlock(&msg_queue.lock);
+    pthread_mutex_unlock(&msg_output_lock);
+}
+
+static void msg_atfork_child(void)
+{
+    // The writer thread doesn't exist in the child process.
+    msg_queue.running = false;
+    msg_queue.busy = false;
+    msg_queue.num = 0;
+    pthread_mutex_unlock(&msg_queue.lock);
+    pthread_mutex_unlock(&msg_output_lock);
+}
+
+static void msg_thread_init(void)
+{
+    struct msg_queue *q = &msg_queue;
+    if (q->running || getenv("MPV_SYNC_MSG"))
+        return;
+    if (pthread_create(&q->thread, NULL, msg_thread, NULL))
+        return;
+    q->running = true;
+    pthread_atfork(msg_atfork_prepare, msg_atfork_parent, msg_atfork_child);
+    atexit(mp_msg_uninit);
+}
+
+#else /* HAVE_PTHREADS */
+
+void mp_msg_flush(void)
+{
+}
+
+void mp_msg_uninit(void)
+{
+}
+
+#endif /* HAVE_PTHREADS */
+
 void mp_msg_init(void){
 #ifdef _WIN32
     CONSOLE_SCREEN_BUFFER_INFO cinfo;
@@ -107,6 +312,9 @@ void mp_msg_init(void){
     bindtextdomain("mpv", localedir);
     bind_textdomain_codeset("mpv", "UTF-8");
 #endif
+#ifdef HAVE_PTHREADS
+    msg_thread_init();
+#endif
 }
 
 int mp_msg_test(int mod, int lev)
@@ -224,20 +432,14 @@ static void print_msg_module(FILE* stream, int mod)
     fprintf(stream, ": ");
 }
 
-void mp_msg_va(int mod, int lev, const char *format, va_list va)
+static void print_msg(int mod, int lev, const char *tmp)
 {
-    char tmp[MSGSIZE_MAX];
     FILE *stream =
         (mp_msg_stdout_in_use || (lev == MSGL_STATUS)) ? stderr : stdout;
     static int header = 1;
     // indicates if last line printed was a status line
     static int statusline;
 
-    if (!mp_msg_test(mod, lev)) return; // do not display
-    vsnprintf(tmp, MSGSIZE_MAX, format, va);
-    tmp[MSGSIZE_MAX-2] = '\n';
-    tmp[MSGSIZE_MAX-1] = 0;
-
     /* A status line is normally intended to be overwritten by the next
      * status line, and does not end with a '\n'. If we're printing a normal
      * line instead after the status one print '\n' to change line. */
@@ -266,6 +468,29 @@ void mp_msg_va(int mod, int lev, const char *format, va_list va)
     fflush(stream);
 }
 
+void mp_msg_va(int mod, int lev, const char *format, va_list va)
+{
+    char tmp[MSGSIZE_MAX];
+
+    if (!mp_msg_test(mod, lev)) return; // do not display
+    vsnprintf(tmp, MSGSIZE_MAX, format, va);
+    tmp[MSGSIZE_MAX-2] = '\n';
+    tmp[MSGSIZE_MAX-1] = 0;
+
+#ifdef HAVE_PTHREADS
+    // Fatal errors are usually followed by exiting or crashing, so make sure
+    // they (and everything before them) reach the terminal right away.
+    if (lev > MSGL_FATAL && queue_msg(mod, lev, tmp))
+        return;
+    mp_msg_flush();
+    pthread_mutex_lock(&msg_output_lock);
+    print_msg(mod, lev, tmp);
+    pthread_mutex_unlock(&msg_output_lock);
+#else
+    print_msg(mod, lev, tmp);
+#endif
+}
+
 void mp_msg(int mod, int lev, const char *format, ...)
 {
     va_list va;
@@ -129,6 +129,8 @@ extern int verbose;
 #define MSGT_MAX 64
 
 void mp_msg_init(void);
+void mp_msg_uninit(void);
+void mp_msg_flush(void);
 int mp_msg_test(int mod, int lev);
 
 #include "config.h"
@@ -0,0 +1,109 @@
+/*
+ * This file is part of MPlayer.
+ *
+ * MPlayer is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * MPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with MPlayer; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "talloc.h"
+#include "core/mp_strmap.h"
+
+struct entry {
+    char *key;          // NULL if unused
+    size_t key_len;
+    uint32_t hash;
+    void *val;
+};
+
+struct mp_strmap {
+    struct entry *entries;
+    int size;           // always a power of 2
+    int count;
+};
+
+// FNV-1a
+static uint32_t hash_bstr(struct bstr s)
+{
+    uint32_t h = 2166136261u;
+    for (size_t n = 0; n < s.len; n++) {
+        h ^= s.start[n];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+struct mp_strmap *mp_strmap_new(void *talloc_ctx)
+{
+    struct mp_strmap *map = talloc_zero(talloc_ctx, struct mp_strmap);
+    map->size = 64;
+    map->entries = talloc_zero_array(map, struct entry, map->size);
+    return map;
+}
+
+static struct entry *find_slot(struct mp_strmap *map, struct bstr key,
+                               uint32_t hash)
+{
+    int mask = map->size - 1;
+    for (int i = hash & mask; ; i = (i + 1) & mask) {
+        struct entry *e = &map->entries[i];
+        if (!e->key)
+            return e;
+        if (e->hash == hash && e->key_len == key.len &&
+            memcmp(e->key, key.start, key.len) == 0)
+            return e;
+    }
+}
+
+static void grow(struct mp_strmap *map)
+{
+    struct entry *old = map->entries;
+    int old_size = map->size;
+    map->size *= 2;
+    map->entries = talloc_zero_array(map, struct entry, map->size);
+    for (int n = 0; n < old_size; n++) {
+        if (old[n].key) {
+            struct bstr key = {(unsigned char *)old[n].key, old[n].key_len};
+            *find_slot(map, key, old[n].hash) = old[n];
+        }
+    }
+    talloc_free(old);
+}
+
+bool mp_strmap_add(struct mp_strmap *map, struct bstr key, void *val)
+{
+    // Keep the load factor below 1/2, so that probe sequences stay short.
+    if ((map->count + 1) * 2 > map->size)
+        grow(map);
+    uint32_t hash = hash_bstr(key);
+    struct entry *e = find_slot(map, key, hash);
+    if (e->key)
+        return false;
+    *e = (struct entry) {
+        .key = talloc_strndup(map, (char *)key.start, key.len),
+        .key_len = key.len,
+        .hash = hash,
+        .val = val,
+    };
+    map->count++;
+    return true;
+}
+
+void *mp_strmap_get(struct mp_strmap *map, struct bstr key)
+{
+    struct entry *e = find_slot(map, key, hash_bstr(key));
+    return e->key ? e->val : NULL;
+}
@@ -0,0 +1,36 @@
+/*
+ * This file is part of MPlayer.
+ *
+ * MPlayer is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * MPlayer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with MPlayer; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef MPLAYER_MP_STRMAP_H
+#define MPLAYER_MP_STRMAP_H
+
+#include <stdbool.h>
+
+#include "core/bstr.h"
+
+// Hash table mapping strings to pointers. Keys are copied. Entries can't be
+// removed; talloc_free() the map to free it.
+struct mp_strmap;
+
+struct mp_strmap *mp_strmap_new(void *talloc_ctx);
+// Return false (and leave the entry alone) if the key already exists.
+bool mp_strmap_add(struct mp_strmap *map, struct bstr key, void *val);
+// Return NULL if not found.
+void *mp_strmap_get(struct mp_strmap *map, struct bstr key);
+
+#endif /* MPLAYER_MP_STRMAP_H */
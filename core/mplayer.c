@@ -58,6 +58,10 @@
 #include <signal.h>
 #include <time.h>
 #include <fcntl.h>
+
+#ifdef HAVE_PTHREADS
+#include <pthread.h>
+#endif
 #include <limits.h>
 
 #include <errno.h>
@@ -92,6 +96,7 @@
 #endif
 
 #include "audio/out/ao.h"
+#include "audio/out/mix.h"
 
 #include "core/codecs.h"
 
@@ -202,9 +207,12 @@ static const char av_desync_help_text[] = _(
 
 static void reset_subtitles(struct MPContext *mpctx);
 static void reinit_subs(struct MPContext *mpctx);
+static void prefetch_start(struct MPContext *mpctx);
+static void prefetch_discard(struct MPContext *mpctx);
 static struct track *open_external_file(struct MPContext *mpctx, char *filename,
                                         char *demuxer_name, int stream_cache,
                                         enum stream_type filter);
+static void close_mix_sources(struct MPContext *mpctx);
 
 static double get_relative_time(struct MPContext *mpctx)
 {
@@ -563,6 +571,7 @@ void uninit_player(struct MPContext *mpctx, unsigned int mask)
 
     if (mask & INITIALIZED_AO) {
         mpctx->initialized_flags &= ~INITIALIZED_AO;
+        close_mix_sources(mpctx);
         if (mpctx->mixer.ao)
             mixer_uninit(&mpctx->mixer);
         mpctx->mixer.ao = NULL;
@@ -576,6 +585,7 @@ static MP_NORETURN void exit_player(struct MPContext *mpctx,
                                     enum exit_reason how, int rc)
 {
     uninit_player(mpctx, INITIALIZED_ALL);
+    prefetch_discard(mpctx);
 
 #ifdef CONFIG_ENCODING
     encode_lavc_finish(mpctx->encode_lavc_ctx);
@@ -610,6 +620,8 @@ static MP_NORETURN void exit_player(struct MPContext *mpctx,
         mp_tmsg(MSGT_CPLAYER, MSGL_INFO, "\nExiting... (%s)\n", reason);
     }
 
+    mp_msg_flush();
+
     // must be last since e.g. mp_msg uses option values
     // that will be freed by this.
     if (mpctx->mconfig)
@@ -1249,6 +1261,44 @@ static void print_status(struct MPContext *mpctx)
     talloc_free(line);
 }
 
+/* Parse a ReplayGain ("-6.20 dB") or R128 (Q7.8 fixed point, relative to
+ * -23 LUFS) gain tag of the demuxer, and return it relative to -18 LUFS.
+ * Returns NAN if neither tag is present.
+ */
+static float get_replaygain_tag(struct demuxer *demuxer, const char *rg_tag,
+                                const char *r128_tag)
+{
+    char *end;
+    char *val = demux_info_get(demuxer, rg_tag);
+    if (val) {
+        double gain = strtod(val, &end);
+        if (end != val)
+            return gain;
+    }
+    val = demux_info_get(demuxer, r128_tag);
+    if (val) {
+        long gain = strtol(val, &end, 10);
+        if (end != val)
+            return gain / 256.0 + 5;
+    }
+    return NAN;
+}
+
+// Pass the loudness normalization tags to the filters that use them.
+static void set_replaygain_info(struct MPContext *mpctx)
+{
+    struct sh_audio *sh_audio = mpctx->sh_audio;
+    struct demuxer *demuxer = sh_audio->gsh->demuxer;
+    struct af_replaygain rg = {
+        .track_gain = get_replaygain_tag(demuxer, "REPLAYGAIN_TRACK_GAIN",
+                                         "R128_TRACK_GAIN"),
+        .album_gain = get_replaygain_tag(demuxer, "REPLAYGAIN_ALBUM_GAIN",
+                                         "R128_ALBUM_GAIN"),
+    };
+    af_control_any_rev(sh_audio->afilter,
+                       AF_CONTROL_REPLAYGAIN | AF_CONTROL_SET, &rg);
+}
+
 /**
  * \brief build a chain of audio filters that converts the input format
  * to the ao's format, taking into account the current playback_speed.
@@ -1284,9 +1334,39 @@ static int build_afilter_chain(struct MPContext *mpctx)
     result =  init_audio_filters(sh_audio, new_srate,
                                  &ao->samplerate, &ao->channels, &ao->format);
     mpctx->mixer.afilter = sh_audio->afilter;
+    if (result)
+        set_replaygain_info(mpctx);
     return result;
 }
 
+/* Apply a changed playback_speed to the running filter chain, the same way
+ * build_afilter_chain() would, but without reinitializing it. The filters
+ * switch to the new speed with the next block of audio. Returns false if the
+ * chain can't do this (e.g. there's no resampler), and must be rebuilt.
+ */
+bool update_playback_speed_filters(struct MPContext *mpctx)
+{
+    struct sh_audio *sh_audio = mpctx->sh_audio;
+    struct MPOpts *opts = &mpctx->opts;
+    if (!sh_audio || !sh_audio->afilter)
+        return false;
+    if (af_control_any_rev(sh_audio->afilter,
+                           AF_CONTROL_PLAYBACK_SPEED | AF_CONTROL_SET,
+                           &opts->playback_speed))
+        return true;
+    double new_srate = sh_audio->samplerate * opts->playback_speed;
+    if (new_srate < 8000)
+        new_srate = 8000;
+    if (new_srate > 192000)
+        new_srate = 192000;
+    if (!af_control_any_rev(sh_audio->afilter,
+                            AF_CONTROL_RESAMPLE_INPUT_RATE | AF_CONTROL_SET,
+                            &new_srate))
+        return false;
+    opts->playback_speed = new_srate / sh_audio->samplerate;
+    return true;
+}
+
 
 typedef struct mp_osd_msg mp_osd_msg_t;
 struct mp_osd_msg {
@@ -1648,6 +1728,160 @@ static void update_osd_msg(struct MPContext *mpctx)
     }
 }
 
+// Close the AO after playing all audio still buffered in it. Used when the AO
+// was kept open for gapless playback, but can't be used for the new audio.
+static void drain_audio_out(struct MPContext *mpctx)
+{
+    enum stop_play_reason orig_stop_play = mpctx->stop_play;
+    mpctx->stop_play = AT_END_OF_FILE;  // let audio uninit drain data
+    uninit_player(mpctx, INITIALIZED_VOL | INITIALIZED_AO);
+    mpctx->stop_play = orig_stop_play;
+}
+
+// Whether the decoder outputs the same format the open AO was chosen for.
+static bool ao_decoder_format_matches(struct MPContext *mpctx)
+{
+    struct sh_audio *sh_audio = mpctx->sh_audio;
+    return sh_audio->samplerate == mpctx->ao_decoder_samplerate &&
+           sh_audio->sample_format == mpctx->ao_decoder_format &&
+           mp_chmap_equals(&sh_audio->channels, &mpctx->ao_decoder_channels);
+}
+
+/* Additional audio files (--audio-mix) are decoded independently of the main
+ * audio, converted to the AO format by their own filter chain (which inserts
+ * af_lavrresample if the samplerate differs), and mixed into the AO output.
+ * They are opened and closed together with the AO, so with gapless audio they
+ * continue to play across playlist entries.
+ */
+struct mix_source {
+    char *filename;
+    struct demuxer *demuxer;
+    struct sh_audio *sh_audio;
+    struct ao_mix_stream *stream;
+    struct bstr buffer;
+    bool eof;
+};
+
+static void close_mix_source(struct MPContext *mpctx, struct mix_source *src)
+{
+    if (src->stream)
+        ao_mix_remove_stream(mpctx->ao, src->stream);
+    if (src->sh_audio)
+        uninit_audio(src->sh_audio);
+    if (src->demuxer) {
+        struct stream *stream = src->demuxer->stream;
+        free_demuxer(src->demuxer);
+        free_stream(stream);
+    }
+    talloc_free(src);
+}
+
+static void close_mix_sources(struct MPContext *mpctx)
+{
+    for (int n = 0; n < mpctx->num_mix_sources; n++)
+        close_mix_source(mpctx, mpctx->mix_sources[n]);
+    talloc_free(mpctx->mix_sources);
+    mpctx->mix_sources = NULL;
+    mpctx->num_mix_sources = 0;
+}
+
+static struct mix_source *open_mix_source(struct MPContext *mpctx,
+                                          char *filename)
+{
+    struct MPOpts *opts = &mpctx->opts;
+    struct ao *ao = mpctx->ao;
+    struct mix_source *src = talloc_zero(NULL, struct mix_source);
+    src->filename = talloc_strdup(src, filename);
+    src->buffer.start = talloc_new(src);
+
+    int file_format = 0;
+    struct stream *stream = open_stream(filename, opts, &file_format);
+    if (!stream)
+        goto error;
+    src->demuxer = demux_open_withparams(opts, stream, file_format, NULL,
+                                         -1, -1, -2, filename, NULL);
+    if (!src->demuxer) {
+        free_stream(stream);
+        goto error;
+    }
+    struct sh_stream *sh = NULL;
+    for (int n = 0; n < src->demuxer->num_streams; n++) {
+        if (src->demuxer->streams[n]->type == STREAM_AUDIO) {
+            sh = src->demuxer->streams[n];
+            break;
+        }
+    }
+    if (!sh) {
+        mp_msg(MSGT_CPLAYER, MSGL_ERR, "No audio in %s.\n", filename);
+        goto error;
+    }
+    // Only audio is read; packets of other streams would pile up
+    demuxer_switch_track(src->demuxer, STREAM_VIDEO, NULL);
+    demuxer_switch_track(src->demuxer, STREAM_SUB, NULL);
+    demuxer_switch_track(src->demuxer, STREAM_AUDIO, sh);
+    src->sh_audio = sh->audio;
+    if (!init_best_audio_codec(src->sh_audio, opts->audio_decoders))
+        goto error;
+
+    int rate = ao->samplerate, format = ao->format;
+    struct mp_chmap channels = ao->channels;
+    if (!init_audio_filters(src->sh_audio, src->sh_audio->samplerate,
+                            &rate, &channels, &format) ||
+        rate != ao->samplerate || format != ao->format ||
+        !mp_chmap_equals(&channels, &ao->channels))
+    {
+        mp_msg(MSGT_CPLAYER, MSGL_ERR, "Can't convert %s to the audio "
+               "output format.\n", filename);
+        goto error;
+    }
+    src->stream = ao_mix_add_stream(ao, filename);
+    if (!src->stream)
+        goto error;
+    ao_mix_set_volume(src->stream, mpctx->mixer.mix_volume);
+    mp_msg(MSGT_CPLAYER, MSGL_INFO, "Mixing audio from %s.\n", filename);
+    return src;
+
+error:
+    mp_msg(MSGT_CPLAYER, MSGL_ERR, "Can not mix audio from %s.\n", filename);
+    close_mix_source(mpctx, src);
+    return NULL;
+}
+
+static void open_mix_sources(struct MPContext *mpctx)
+{
+    char **files = mpctx->opts.audio_mix_files;
+    if (!files || mpctx->num_mix_sources)
+        return;
+    for (int n = 0; files[n]; n++) {
+        struct mix_source *src = open_mix_source(mpctx, files[n]);
+        if (src) {
+            MP_TARRAY_APPEND(NULL, mpctx->mix_sources, mpctx->num_mix_sources,
+                             src);
+        }
+    }
+}
+
+// Decode enough of the mixed files to cover the audio played next.
+static void fill_mix_sources(struct MPContext *mpctx)
+{
+    struct ao *ao = mpctx->ao;
+    for (int n = 0; n < mpctx->num_mix_sources; n++) {
+        struct mix_source *src = mpctx->mix_sources[n];
+        int space = ao_mix_get_space(ao, src->stream);
+        if (!src->eof && src->buffer.len < space &&
+            decode_audio(src->sh_audio, &src->buffer, space) < 0)
+        {
+            mp_msg(MSGT_CPLAYER, MSGL_V, "End of mixed audio from %s.\n",
+                   src->filename);
+            src->eof = true;
+        }
+        int len = ao_mix_write(ao, src->stream, src->buffer.start,
+                               FFMIN(space, src->buffer.len));
+        src->buffer.len -= len;
+        memmove(src->buffer.start, src->buffer.start + len, src->buffer.len);
+    }
+}
+
 void reinit_audio_chain(struct MPContext *mpctx)
 {
     struct MPOpts *opts = &mpctx->opts;
@@ -1663,11 +1897,26 @@ void reinit_audio_chain(struct MPContext *mpctx)
         mpctx->initialized_flags |= INITIALIZED_ACODEC;
     }
 
+    // With --gapless-audio=weak, an AO kept open from the previous file is
+    // reused only if the new file decodes to the same format. Otherwise it's
+    // reopened, so that the new file isn't resampled to the old format.
+    if ((mpctx->initialized_flags & INITIALIZED_AO) && opts->gapless_audio < 0
+        && !ao_decoder_format_matches(mpctx))
+    {
+        mp_msg(MSGT_CPLAYER, MSGL_V, "Audio format changed, reopening "
+               "audio output.\n");
+        drain_audio_out(mpctx);
+    }
+
     if (!(mpctx->initialized_flags & INITIALIZED_AO)) {
         mpctx->initialized_flags |= INITIALIZED_AO;
         mpctx->ao = ao_create(opts, mpctx->input);
         mpctx->ao->samplerate = opts->force_srate;
         mpctx->ao->format = opts->audio_output_format;
+        // Prefer mixing the --audio-mix files in float
+        if (opts->audio_mix_files && !mpctx->ao->format &&
+            !(mpctx->sh_audio->sample_format & AF_FORMAT_SPECIAL_MASK))
+            mpctx->ao->format = AF_FORMAT_FLOAT_NE;
         // Automatic downmix
         if (mp_chmap_is_stereo(&opts->audio_output_channels) &&
             !mp_chmap_is_stereo(&mpctx->sh_audio->channels))
@@ -1699,6 +1948,9 @@ void reinit_audio_chain(struct MPContext *mpctx)
             goto init_error;
         }
         ao->buffer.start = talloc_new(ao);
+        mpctx->ao_decoder_samplerate = mpctx->sh_audio->samplerate;
+        mpctx->ao_decoder_format = mpctx->sh_audio->sample_format;
+        mpctx->ao_decoder_channels = mpctx->sh_audio->channels;
         char *s = mp_audio_fmt_to_str(ao->samplerate, &ao->channels, ao->format);
         mp_msg(MSGT_CPLAYER, MSGL_INFO, "AO: [%s] %s\n",
                ao->driver->info->short_name, s);
@@ -1727,8 +1979,10 @@ void reinit_audio_chain(struct MPContext *mpctx)
         }
         if (opts->mixer_init_mute >= 0)
             mixer_setmute(&mpctx->mixer, opts->mixer_init_mute);
+        mpctx->mixer.mix_volume = opts->audio_mix_volume;
         mpctx->initialized_flags |= INITIALIZED_VOL;
     }
+    open_mix_sources(mpctx);
     mpctx->syncing_audio = true;
     return;
 
@@ -1896,6 +2150,8 @@ static void update_subtitles(struct MPContext *mpctx, double refpts_tl)
                    pkt.len);
             sub_decode(dec_sub, &pkt);
         }
+    } else {
+        sub_update_index(dec_sub, curpts_s);
     }
 
     if (!mpctx->osd->render_bitmap_subs || !mpctx->sh_video)
@@ -2192,7 +2448,7 @@ static int audio_start_sync(struct MPContext *mpctx, int playsize)
     int res;
 
     // Timing info may not be set without
-    res = decode_audio(sh_audio, &ao->buffer, 1);
+    res = decode_audio_skip(sh_audio, 0);
     if (res < 0)
         return res;
 
@@ -2233,18 +2489,17 @@ static int audio_start_sync(struct MPContext *mpctx, int playsize)
             break;
 
         mpctx->syncing_audio = false;
-        int a = FFMIN(-bytes, FFMAX(playsize, 20000));
-        int res = decode_audio(sh_audio, &ao->buffer, a);
         bytes += ao->buffer.len;
         if (bytes >= 0) {
             memmove(ao->buffer.start,
                     ao->buffer.start + ao->buffer.len - bytes, bytes);
             ao->buffer.len = bytes;
-            if (res < 0)
-                return res;
             return decode_audio(sh_audio, &ao->buffer, playsize);
         }
         ao->buffer.len = 0;
+        // Cut the rest from the decoder output directly, so that the dropped
+        // audio isn't filtered, then check the timing again.
+        res = decode_audio_skip(sh_audio, -bytes / bps);
         if (res < 0)
             return res;
     }
@@ -2341,11 +2596,24 @@ static int fill_audio_out_buffers(struct MPContext *mpctx, double endpts)
 
     // play audio:
 
+    fill_mix_sources(mpctx);
+
+    // Audio written now becomes audible after what's queued in the AO
+    double ao_delay = mpctx->seek_start_time ? ao_get_delay(ao) : 0;
+
     int played = write_to_ao(mpctx, ao->buffer.start, playsize, playflags,
                              written_audio_pts(mpctx));
     assert(played % unitsize == 0);
     ao->buffer_playable_size = playsize - played;
 
+    if (played > 0 && mpctx->seek_start_time) {
+        mpctx->seek_latency = (mp_time_us() - mpctx->seek_start_time) / 1e6
+                              + ao_delay;
+        mpctx->seek_start_time = 0;
+        mp_msg(MSGT_CPLAYER, MSGL_V, "Audio audible %.1f ms after seek.\n",
+               mpctx->seek_latency * 1000);
+    }
+
     if (played > 0) {
         ao->buffer.len -= played;
         memmove(ao->buffer.start, ao->buffer.start + played, ao->buffer.len);
@@ -2832,6 +3100,7 @@ static void seek_reset(struct MPContext *mpctx, bool reset_ao, bool reset_ac)
             ao_reset(mpctx->ao);
         mpctx->ao->buffer.len = mpctx->ao->buffer_playable_size;
         mpctx->sh_audio->a_buffer_len = 0;
+        mpctx->seek_start_time = mp_time_us();
     }
 
     reset_subtitles(mpctx);
@@ -3688,6 +3957,8 @@ static void run_playloop(struct MPContext *mpctx)
 
     handle_pause_on_low_cache(mpctx);
 
+    prefetch_start(mpctx);
+
     mp_cmd_t *cmd;
     while ((cmd = mp_input_get_cmd(mpctx->input, 0, 1)) != NULL) {
         /* Allow running consecutive seek commands to combine them,
@@ -3770,6 +4041,8 @@ static void run_playloop(struct MPContext *mpctx)
     }
 
     execute_queued_seek(mpctx);
+
+    mp_notify_property_changes(mpctx);
 }
 
 static int read_keys(void *ctx, int fd)
@@ -3894,7 +4167,8 @@ static void init_input(struct MPContext *mpctx)
     else if (mpctx->opts.consolecontrols)
         mp_input_add_key_fd(mpctx->input, 0, 1, read_keys, NULL, mpctx->key_fifo);
     // Set the libstream interrupt callback
-    stream_set_interrupt_callback(mp_input_check_interrupt, mpctx->input);
+    stream_set_interrupt_callback(mp_input_check_interrupt, mp_input_wait_fd,
+                                  mpctx->input);
 
 #ifdef CONFIG_COCOA
     cocoa_set_input_context(mpctx->input);
@@ -4066,6 +4340,7 @@ static void idle_loop(struct MPContext *mpctx)
                                         false)));
         run_command(mpctx, cmd);
         mp_cmd_free(cmd);
+        mp_notify_property_changes(mpctx);
     }
 }
 
@@ -4100,6 +4375,211 @@ static void stream_dump(struct MPContext *mpctx)
 
 // Start playing the current playlist entry.
 // Handle initialization and deinitialization.
+/* Prefetching of the next playlist entry (--prefetch-playlist).
+ *
+ * Shortly before the current file ends, the stream and demuxer of the next
+ * playlist entry are opened in a separate thread, so that the next file can
+ * start without waiting for that. The stream cache is enabled by the main
+ * thread once the file is played, because that forks the cache process. The
+ * thread works on a private copy of the options, because demux_open() writes
+ * to them, and the current file's options can change under its feet. The
+ * options that influence opening the file are recorded, and the prefetched
+ * file is used only if they're still the same once the next file's own
+ * options have been applied. If the prefetched file isn't needed anymore, the
+ * thread's stream operations are interrupted, so that quitting or switching
+ * to another file doesn't block on a slow network connection.
+ */
+#ifdef HAVE_PTHREADS
+struct mp_prefetch {
+    pthread_t thread;
+    bool joined;
+    struct playlist_entry *entry;
+    char *filename;
+    struct MPOpts opts;
+
+    // Options the result depends on
+    char *demuxer_name;
+    int audio_id, video_id, sub_id;
+    int user_correct_pts;
+    int extension_parsing;
+    int demuxer_probe_size;
+
+    // Set by the thread
+    struct mp_resolve_result *resolve_result;
+    struct stream *stream;
+    int file_format;
+    struct demuxer *demuxer;
+};
+
+static void *prefetch_thread(void *arg)
+{
+    struct mp_prefetch *p = arg;
+    struct MPOpts *opts = &p->opts;
+
+    char *stream_filename = p->filename;
+    p->resolve_result = resolve_url(stream_filename, opts);
+    if (p->resolve_result)
+        stream_filename = p->resolve_result->url;
+    p->file_format = DEMUXER_TYPE_UNKNOWN;
+    p->stream = open_stream(stream_filename, opts, &p->file_format);
+    if (!p->stream || p->file_format == DEMUXER_TYPE_PLAYLIST)
+        return NULL;
+    p->demuxer = demux_open(opts, p->stream, p->file_format, opts->audio_id,
+                            opts->video_id, opts->sub_id, p->filename);
+    mp_msg(MSGT_CPLAYER, MSGL_V, "Prefetching %s %s.\n", p->filename,
+           p->demuxer ? "done" : "failed");
+    return NULL;
+}
+
+// Devices can't be opened twice, and live sources shouldn't be.
+static bool prefetch_allowed(const char *filename)
+{
+    static const char *const protocols[] = {
+        "file", "http", "https", "mp_http", "ftp", "smb", "lavf", NULL
+    };
+    const char *sep = strstr(filename, "://");
+    if (!sep)
+        return strcmp(filename, "-") != 0;
+    for (int n = 0; protocols[n]; n++) {
+        if (strlen(protocols[n]) == sep - filename &&
+            strncasecmp(filename, protocols[n], sep - filename) == 0)
+            return true;
+    }
+    return false;
+}
+
+static void prefetch_start(struct MPContext *mpctx)
+{
+    struct MPOpts *opts = &mpctx->opts;
+    if (mpctx->prefetch || opts->prefetch_playlist <= 0 || !mpctx->demuxer ||
+        mpctx->stop_play || mpctx->timeline || opts->seek_to_byte ||
+        (opts->stream_dump && opts->stream_dump[0]))
+        return;
+    struct playlist_entry *next = playlist_get_next(mpctx->playlist, 1);
+    if (!next || !prefetch_allowed(next->filename))
+        return;
+    double len = get_time_length(mpctx);
+    if (len <= 0 || len - get_current_time(mpctx) > opts->prefetch_playlist)
+        return;
+
+    struct mp_prefetch *p = talloc_zero(NULL, struct mp_prefetch);
+    p->entry = next;
+    p->filename = talloc_strdup(p, next->filename);
+    p->opts = *opts;
+    p->demuxer_name = talloc_strdup(p, opts->demuxer_name);
+    p->audio_id = opts->audio_id;
+    p->video_id = opts->video_id;
+    p->sub_id = opts->sub_id;
+    p->user_correct_pts = opts->user_correct_pts;
+    p->extension_parsing = opts->extension_parsing;
+    p->demuxer_probe_size = opts->demuxer_probe_size;
+    if (pthread_create(&p->thread, NULL, prefetch_thread, p)) {
+        talloc_free(p);
+        return;
+    }
+    mp_msg(MSGT_CPLAYER, MSGL_V, "Prefetching %s.\n", p->filename);
+    mpctx->prefetch = p;
+}
+
+// Wait until the thread is done. It uses the current file's options, so
+// this must happen before leaving the file.
+static void prefetch_wait(struct MPContext *mpctx)
+{
+    struct mp_prefetch *p = mpctx->prefetch;
+    if (p && !p->joined) {
+        pthread_join(p->thread, NULL);
+        p->joined = true;
+        if (p->demuxer)
+            demux_set_opts(p->demuxer, &mpctx->opts);
+        else if (p->stream)
+            p->stream->opts = &mpctx->opts;
+    }
+}
+
+static void prefetch_discard(struct MPContext *mpctx)
+{
+    struct mp_prefetch *p = mpctx->prefetch;
+    if (!p)
+        return;
+    stream_set_background_interrupt(true);
+    prefetch_wait(mpctx);
+    stream_set_background_interrupt(false);
+    if (p->demuxer)
+        free_demuxer(p->demuxer);
+    if (p->stream)
+        free_stream(p->stream);
+    talloc_free(p->resolve_result);
+    talloc_free(p);
+    mpctx->prefetch = NULL;
+}
+
+static bool prefetch_opts_match(struct mp_prefetch *p, struct MPOpts *opts)
+{
+    return bstr_equals(bstr0(p->demuxer_name), bstr0(opts->demuxer_name)) &&
+           p->audio_id == opts->audio_id &&
+           p->video_id == opts->video_id &&
+           p->sub_id == opts->sub_id &&
+           p->user_correct_pts == opts->user_correct_pts &&
+           p->extension_parsing == opts->extension_parsing &&
+           p->demuxer_probe_size == opts->demuxer_probe_size &&
+           !opts->seek_to_byte &&
+           !(opts->stream_dump && opts->stream_dump[0]);
+}
+
+// Called when leaving the current file, whose options the thread uses.
+static void prefetch_leave_file(struct MPContext *mpctx)
+{
+    struct mp_prefetch *p = mpctx->prefetch;
+    if (!p)
+        return;
+    // Don't wait for a file that won't be played next
+    bool needed = mpctx->stop_play == AT_END_OF_FILE ||
+                  mpctx->stop_play == PT_NEXT_ENTRY ||
+                  (mpctx->stop_play == PT_CURRENT_ENTRY &&
+                   mpctx->playlist->current == p->entry);
+    if (needed) {
+        prefetch_wait(mpctx);
+    } else {
+        prefetch_discard(mpctx);
+    }
+}
+
+// Return the prefetched stream and demuxer for the file about to be played,
+// or NULL if there is nothing usable.
+static struct mp_prefetch *prefetch_get(struct MPContext *mpctx)
+{
+    struct mp_prefetch *p = mpctx->prefetch;
+    if (!p)
+        return NULL;
+    prefetch_wait(mpctx);
+    if (p->entry == mpctx->playlist->current && p->demuxer &&
+        strcmp(p->filename, mpctx->filename) == 0 &&
+        prefetch_opts_match(p, &mpctx->opts))
+    {
+        mpctx->prefetch = NULL;
+        mpctx->opts.correct_pts = p->opts.correct_pts;
+        return p;
+    }
+    mp_msg(MSGT_CPLAYER, MSGL_V, "Not using prefetched %s.\n", p->filename);
+    prefetch_discard(mpctx);
+    return NULL;
+}
+#else
+struct mp_prefetch {
+    struct mp_resolve_result *resolve_result;
+    struct stream *stream;
+    int file_format;
+    struct demuxer *demuxer;
+};
+static void prefetch_start(struct MPContext *mpctx) {}
+static void prefetch_discard(struct MPContext *mpctx) {}
+static void prefetch_leave_file(struct MPContext *mpctx) {}
+static struct mp_prefetch *prefetch_get(struct MPContext *mpctx)
+{
+    return NULL;
+}
+#endif
+
 static void play_current_file(struct MPContext *mpctx)
 {
     struct MPOpts *opts = &mpctx->opts;
@@ -4176,15 +4656,23 @@ static void play_current_file(struct MPContext *mpctx)
     assert(mpctx->sh_video == NULL);
     assert(mpctx->sh_sub == NULL);
 
-    char *stream_filename = mpctx->filename;
-    mpctx->resolve_result = resolve_url(stream_filename, opts);
-    if (mpctx->resolve_result)
-        stream_filename = mpctx->resolve_result->url;
     int file_format = DEMUXER_TYPE_UNKNOWN;
-    mpctx->stream = open_stream(stream_filename, opts, &file_format);
-    if (!mpctx->stream) { // error...
-        demux_was_interrupted(mpctx);
-        goto terminate_playback;
+    struct mp_prefetch *prefetched = prefetch_get(mpctx);
+    if (prefetched) {
+        mp_msg(MSGT_CPLAYER, MSGL_V, "Using prefetched file.\n");
+        mpctx->resolve_result = prefetched->resolve_result;
+        mpctx->stream = prefetched->stream;
+        file_format = prefetched->file_format;
+    } else {
+        char *stream_filename = mpctx->filename;
+        mpctx->resolve_result = resolve_url(stream_filename, opts);
+        if (mpctx->resolve_result)
+            stream_filename = mpctx->resolve_result->url;
+        mpctx->stream = open_stream(stream_filename, opts, &file_format);
+        if (!mpctx->stream) { // error...
+            demux_was_interrupted(mpctx);
+            goto terminate_playback;
+        }
     }
     mpctx->initialized_flags |= INITIALIZED_STREAM;
 
@@ -4221,13 +4709,21 @@ static void play_current_file(struct MPContext *mpctx)
 #ifdef CONFIG_DVBIN
 goto_enable_cache: ;
 #endif
+    // A prefetched stream is already being read by its demuxer; the cache
+    // continues from the current position.
     int res = stream_enable_cache_percent(mpctx->stream,
                                           opts->stream_cache_size,
                                           opts->stream_cache_min_percent,
                                           opts->stream_cache_seek_min_percent);
-    if (res == 0)
-        if (demux_was_interrupted(mpctx))
+    if (res == 0) {
+        if (demux_was_interrupted(mpctx)) {
+            if (prefetched) {
+                free_demuxer(prefetched->demuxer);
+                talloc_free(prefetched);
+            }
             goto terminate_playback;
+        }
+    }
 
     stream_set_capture_file(mpctx->stream, opts->stream_capture);
 
@@ -4235,9 +4731,15 @@ goto_enable_cache: ;
 
     mpctx->audio_delay = opts->audio_delay;
 
-    mpctx->demuxer = demux_open(opts, mpctx->stream, file_format,
-                                opts->audio_id, opts->video_id, opts->sub_id,
-                                mpctx->filename);
+    if (prefetched) {
+        mpctx->demuxer = prefetched->demuxer;
+        talloc_free(prefetched);
+        prefetched = NULL;
+    } else {
+        mpctx->demuxer = demux_open(opts, mpctx->stream, file_format,
+                                    opts->audio_id, opts->video_id,
+                                    opts->sub_id, mpctx->filename);
+    }
     mpctx->master_demuxer = mpctx->demuxer;
 
     if (!mpctx->demuxer) {
@@ -4442,6 +4944,8 @@ terminate_playback:  // don't jump here after ao/vo/getch initialization!
         uninitialize_parts -= INITIALIZED_AO;
     uninit_player(mpctx, uninitialize_parts);
 
+    prefetch_leave_file(mpctx);
+
     // xxx handle this as INITIALIZED_CONFIG?
     m_config_leave_file_local(mpctx->mconfig);
 
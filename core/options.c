@@ -329,6 +329,7 @@ const m_option_t mp_opts[] = {
     OPT_CHOICE_OR_INT("cache-pause", stream_cache_pause, 0,
                       0, 40, ({"no", -1})),
 #endif /* CONFIG_STREAM_CACHE */
+    OPT_FLAG("file-mmap", stream_file_mmap, 0),
     {"cdrom-device", &cdrom_device, CONF_TYPE_STRING, 0, 0, 0, NULL},
 #ifdef CONFIG_DVDREAD
     {"dvd-device", &dvd_device,  CONF_TYPE_STRING, 0, 0, 0, NULL},
@@ -346,6 +347,8 @@ const m_option_t mp_opts[] = {
     {"user", &network_username, CONF_TYPE_STRING, 0, 0, 0, NULL},
     {"passwd", &network_password, CONF_TYPE_STRING, 0, 0, 0, NULL},
     {"bandwidth", &network_bandwidth, CONF_TYPE_INT, CONF_MIN, 0, 0, NULL},
+    {"network-timeout", &network_timeout, CONF_TYPE_FLOAT, CONF_RANGE, 0.1, 3600, NULL},
+    {"network-connect-timeout", &network_connect_timeout, CONF_TYPE_FLOAT, CONF_RANGE, 0.1, 3600, NULL},
     {"http-header-fields", &network_http_header_fields, CONF_TYPE_STRING_LIST, 0, 0, 0, NULL},
     {"user-agent", &network_useragent, CONF_TYPE_STRING, 0, 0, 0, NULL},
     {"referrer", &network_referrer, CONF_TYPE_STRING, 0, 0, 0, NULL},
@@ -405,12 +408,16 @@ const m_option_t mp_opts[] = {
     // demuxer.c - select audio/sub file/demuxer
     OPT_STRING("audiofile", audio_stream, 0),
     OPT_INTRANGE("audiofile-cache", audio_stream_cache, 0, 50, 65536),
+    OPT_STRINGLIST("audio-mix", audio_mix_files, 0),
+    OPT_FLOATRANGE("audio-mix-volume", audio_mix_volume, 0, 0, 100),
     OPT_STRING("subfile", sub_stream, 0),
     OPT_STRING("demuxer", demuxer_name, 0),
     OPT_STRING("audio-demuxer", audio_demuxer_name, 0),
     OPT_STRING("sub-demuxer", sub_demuxer_name, 0),
     OPT_FLAG("extbased", extension_parsing, 0),
+    OPT_INTRANGE("demuxer-probe-size", demuxer_probe_size, 0, 0, 65536),
     OPT_FLAG("mkv-subtitle-preroll", mkv_subtitle_preroll, 0),
+    OPT_FLAG("mpg-index", mpg_index, 0),
 
     {"mf", (void *) mfopts_conf, CONF_TYPE_SUBCONFIG, 0,0,0, NULL},
 #ifdef CONFIG_RADIO
@@ -498,6 +505,8 @@ const m_option_t mp_opts[] = {
     // enable Closed Captioning display
     OPT_FLAG_CONSTANTS("overlapsub", suboverlap_enabled, 0, 0, 2),
     OPT_FLAG_STORE("sub-no-text-pp", sub_no_text_pp, 0, 1),
+    OPT_CHOICE("sub-index", sub_index, 0,
+               ({"no", 0}, {"auto", 1}, {"yes", 2})),
     OPT_CHOICE("autosub-match", sub_match_fuzziness, 0,
                ({"exact", 0}, {"fuzzy", 1}, {"all", 2})),
     OPT_INTRANGE("sub-pos", sub_pos, 0, 0, 100),
@@ -542,7 +551,10 @@ const m_option_t mp_opts[] = {
                ({"auto", -1},
                 {"no", 0},
                 {"yes", 1}, {"", 1})),
-    OPT_FLAG("gapless-audio", gapless_audio, 0),
+    OPT_CHOICE("gapless-audio", gapless_audio, M_OPT_OPTIONAL_PARAM,
+               ({"no", 0},
+                {"yes", 1}, {"", 1},
+                {"weak", -1})),
     // override audio buffer size (used only by -ao oss/win32, obsolete)
     OPT_INT("abs", ao_buffersize, 0),
 
@@ -644,6 +656,7 @@ const m_option_t mp_opts[] = {
     OPT_CHOICE_OR_INT("loop", loop_times, M_OPT_GLOBAL, 1, 10000,
                       ({"no", -1}, {"0", -1},
                        {"inf", 0})),
+    OPT_FLOATRANGE("prefetch-playlist", prefetch_playlist, 0, 0, 3600),
 
     {"playlist", NULL, CONF_TYPE_STRING, CONF_NOCFG | M_OPT_MIN, 1, 0, NULL},
     {"shuffle", NULL, CONF_TYPE_FLAG, CONF_NOCFG, 0, 0, NULL},
@@ -733,6 +746,8 @@ const struct MPOpts mp_default_opts = {
     .softvol_max = 200,
     .mixer_init_volume = -1,
     .mixer_init_mute = -1,
+    .audio_mix_volume = 100,
+    .gapless_audio = -1,
     .volstep = 3,
     .ao_buffersize = -1,
     .vo = {
@@ -792,6 +807,7 @@ const struct MPOpts mp_default_opts = {
     .sub_visibility = 1,
     .sub_pos = 100,
     .extension_parsing = 1,
+    .demuxer_probe_size = 2048,
     .audio_output_channels = MP_CHMAP_INIT_STEREO,
     .audio_output_format = -1,  // AF_FORMAT_UNKNOWN
     .playback_speed = 1.,
@@ -807,6 +823,7 @@ const struct MPOpts mp_default_opts = {
     .ass_style_override = 1,
     .use_embedded_fonts = 1,
     .suboverlap_enabled = 1,
+    .sub_index = 1,
 
     .hwdec_codecs = "all",
 
@@ -819,6 +836,7 @@ const struct MPOpts mp_default_opts = {
     },
     .input = {
         .key_fifo_size = 7,
+        .cmd_queue_size = 1000,
         .ar_delay = 200,
         .ar_rate = 40,
         .use_joystick = 1,
@@ -87,6 +87,7 @@ typedef struct MPOpts {
     char *stream_capture;
     char *stream_dump;
     int loop_times;
+    float prefetch_playlist;
     int ordered_chapters;
     int chapter_merge_threshold;
     int quiet;
@@ -96,6 +97,7 @@ typedef struct MPOpts {
     float stream_cache_min_percent;
     float stream_cache_seek_min_percent;
     int stream_cache_pause;
+    int stream_file_mmap;
     int chapterrange[2];
     int edition_id;
     int correct_pts;
@@ -149,15 +151,20 @@ typedef struct MPOpts {
     int suboverlap_enabled;
     char *sub_cp;
     int sub_no_text_pp;
+    int sub_index;
 
     char *audio_stream;
     int audio_stream_cache;
+    char **audio_mix_files;
+    float audio_mix_volume;
     char *sub_stream;
     char *demuxer_name;
     char *audio_demuxer_name;
     char *sub_demuxer_name;
     int extension_parsing;
+    int demuxer_probe_size;
     int mkv_subtitle_preroll;
+    int mpg_index;
 
     struct image_writer_opts *screenshot_image_opts;
     char *screenshot_template;
@@ -232,6 +239,7 @@ typedef struct MPOpts {
     struct input_conf {
         char *config_file;
         int key_fifo_size;
+        int cmd_queue_size;
         int ar_delay;
         int ar_rate;
         char *js_dev;
@@ -40,7 +40,9 @@
 #include "core/path.h"
 
 
-#define BUF_STEP 1024
+// Initial size of the read buffer. It's doubled whenever a line (or, while
+// probing, the part of the file kept for the other parsers) doesn't fit.
+#define BUF_SIZE_MIN (64 * 1024)
 
 #define WHITES " \n\r\t"
 
@@ -48,6 +50,7 @@ typedef struct play_tree_parser {
   struct stream *stream;
   char *buffer,*iter,*line;
   int buffer_size , buffer_end;
+  int line_size;
   int keep;
   struct playlist *pl;
 } play_tree_parser_t;
@@ -69,14 +72,50 @@ strstrip(char* str) {
     str[0] = '\0';
 }
 
+// Append more data from the stream to the buffer. Returns false on EOF or
+// if the buffer can't be enlarged.
+static bool
+play_tree_parser_fill(play_tree_parser_t* p) {
+  // Consumed lines are dropped only here, and not after every line, so that
+  // the cost of moving the rest of the buffer is paid once per read.
+  if(!p->keep && p->iter != p->buffer) {
+    p->buffer_end -= p->iter - p->buffer;
+    memmove(p->buffer,p->iter,p->buffer_end + 1);
+    p->iter = p->buffer;
+  }
+  if(p->buffer_size - p->buffer_end - 1 < p->buffer_size / 2) {
+    int r = p->iter - p->buffer;
+    if (p->buffer_size > INT_MAX / 2)
+      return false;
+    char *tmp = realloc(p->buffer, p->buffer_size * 2);
+    if (!tmp)
+      return false;
+    p->buffer = tmp;
+    p->iter = p->buffer + r;
+    p->buffer_size *= 2;
+  }
+  int r = stream_read(p->stream,p->buffer + p->buffer_end,p->buffer_size - p->buffer_end - 1);
+  if(r <= 0)
+    return false;
+  // The parsers work on C strings, so replace embedded 0 bytes
+  char *data = p->buffer + p->buffer_end;
+  for(int n = 0; n < r; n++) {
+    if(!data[n])
+      data[n] = '\n';
+  }
+  p->buffer_end += r;
+  assert(p->buffer_end < p->buffer_size);
+  p->buffer[p->buffer_end] = '\0';
+  return true;
+}
+
 static char*
 play_tree_parser_get_line(play_tree_parser_t* p) {
   char *end,*line_end;
-  int r,resize = 0;
 
   if(p->buffer == NULL) {
-    p->buffer = malloc(BUF_STEP);
-    p->buffer_size = BUF_STEP;
+    p->buffer = malloc(BUF_SIZE_MIN);
+    p->buffer_size = BUF_SIZE_MIN;
     p->buffer[0] = 0;
     p->iter = p->buffer;
   }
@@ -86,75 +125,46 @@ play_tree_parser_get_line(play_tree_parser_t* p) {
 
   assert(p->buffer_end < p->buffer_size);
   assert(!p->buffer[p->buffer_end]);
+  // Bytes after iter that are already known to contain no newline
+  int scanned = 0;
   while(1) {
-
-    if(resize) {
-      char *tmp;
-      r = p->iter - p->buffer;
+    char *scan = p->iter + scanned;
+    end = memchr(scan,'\n',p->buffer + p->buffer_end - scan);
+    if(end)
+      break;
+    scanned = p->buffer + p->buffer_end - p->iter;
+    if(p->stream->eof || !play_tree_parser_fill(p)) {
       end = p->buffer + p->buffer_end;
-      if (p->buffer_size > INT_MAX - BUF_STEP)
-        break;
-      tmp = realloc(p->buffer, p->buffer_size + BUF_STEP);
-      if (!tmp)
-        break;
-      p->buffer = tmp;
-      p->iter = p->buffer + r;
-      p->buffer_size += BUF_STEP;
-      resize = 0;
-    }
-
-    if(p->buffer_size - p->buffer_end > 1 && ! p->stream->eof) {
-      r = stream_read(p->stream,p->buffer + p->buffer_end,p->buffer_size - p->buffer_end - 1);
-      if(r > 0) {
-	p->buffer_end += r;
-	assert(p->buffer_end < p->buffer_size);
-	p->buffer[p->buffer_end] = '\0';
-	while(strlen(p->buffer + p->buffer_end - r) != r)
-	  p->buffer[p->buffer_end - r + strlen(p->buffer + p->buffer_end - r)] = '\n';
-      }
-      assert(!p->buffer[p->buffer_end]);
-    }
-
-    end = strchr(p->iter,'\n');
-    if(!end) {
-      if(p->stream->eof) {
-	end = p->buffer + p->buffer_end;
-	break;
-      }
-      resize = 1;
-      continue;
+      break;
     }
-    break;
   }
 
   line_end = (end > p->iter && *(end-1) == '\r') ? end-1 : end;
-  if(line_end - p->iter >= 0)
-    p->line = realloc(p->line, line_end - p->iter + 1);
-  else
+  if(line_end - p->iter < 0)
     return NULL;
-  if(line_end - p->iter > 0)
-    strncpy(p->line,p->iter,line_end - p->iter);
-  p->line[line_end - p->iter] = '\0';
+  int len = line_end - p->iter;
+  if(len + 1 > p->line_size) {
+    int size = len + 1 > p->line_size * 2 ? len + 1 : p->line_size * 2;
+    char *tmp = realloc(p->line, size);
+    if(!tmp)
+      return NULL;
+    p->line = tmp;
+    p->line_size = size;
+  }
+  memcpy(p->line,p->iter,len);
+  p->line[len] = '\0';
   if(end[0] != '\0')
     end++;
-
-  if(!p->keep) {
-    if(end[0] != '\0') {
-      p->buffer_end -= end-p->iter;
-      memmove(p->buffer,end,p->buffer_end);
-    } else
-      p->buffer_end = 0;
-    p->buffer[p->buffer_end] = '\0';
-    p->iter = p->buffer;
-  } else
-    p->iter = end;
+  p->iter = end;
 
   return p->line;
 }
 
 static void
 play_tree_parser_reset(play_tree_parser_t* p) {
-  p->iter = p->buffer;
+  // Without keep, the lines before iter were consumed already.
+  if(p->keep)
+    p->iter = p->buffer;
 }
 
 static void
@@ -766,6 +776,9 @@ static struct playlist *do_parse(struct stream* stream, bool forced)
   if (p.pl && !p.pl->first)
     mp_msg(MSGT_PLAYTREE,((forced==1)?MSGL_WARN:MSGL_V),"Warning: empty playlist\n");
 
+  free(p.buffer);
+  free(p.line);
+
   return p.pl;
 }
 
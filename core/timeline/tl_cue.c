@@ -178,7 +178,8 @@ static void add_source(struct MPContext *mpctx, struct demuxer *d)
     MP_TARRAY_APPEND(NULL, mpctx->sources, mpctx->num_sources, d);
 }
 
-static bool try_open(struct MPContext *mpctx, char *filename)
+static struct demuxer *try_open(struct MPContext *mpctx, struct MPOpts *opts,
+                                char *filename)
 {
     struct bstr bfilename = bstr0(filename);
     // Avoid trying to open itself or another .cue file. Best would be
@@ -186,17 +187,14 @@ static bool try_open(struct MPContext *mpctx, char *filename)
     // API doesn't allow this without opening a full demuxer.
     if (bstr_case_endswith(bfilename, bstr0(".cue"))
         || bstrcasecmp(bstr0(mpctx->demuxer->filename), bfilename) == 0)
-        return false;
+        return NULL;
 
     int format = 0;
-    struct stream *s = open_stream(filename, &mpctx->opts, &format);
+    struct stream *s = open_stream(filename, opts, &format);
     if (!s)
-        return false;
-    struct demuxer *d = demux_open(&mpctx->opts, s, format,
-                                    mpctx->opts.audio_id,
-                                    mpctx->opts.video_id,
-                                    mpctx->opts.sub_id,
-                                    filename);
+        return NULL;
+    struct demuxer *d = demux_open(opts, s, format, opts->audio_id,
+                                   opts->video_id, opts->sub_id, filename);
     // Since .bin files are raw PCM data with no headers, we have to explicitly
     // open them. Also, try to avoid to open files that are most likely not .bin
     // files, as that would only play noise. Checking the file extension is
@@ -205,25 +203,28 @@ static bool try_open(struct MPContext *mpctx, char *filename)
     //       CD sector size (2352 bytes)
     if (!d && bstr_case_endswith(bfilename, bstr0(".bin"))) {
         mp_msg(MSGT_CPLAYER, MSGL_WARN, "CUE: Opening as BIN file!\n");
-        d = demux_open(&mpctx->opts, s, DEMUXER_TYPE_RAWAUDIO,
-                       mpctx->opts.audio_id,
-                       mpctx->opts.video_id,
-                       mpctx->opts.sub_id,
-                       filename);
-    }
-    if (d) {
-        add_source(mpctx, d);
-        return true;
+        d = demux_open(opts, s, DEMUXER_TYPE_RAWAUDIO, opts->audio_id,
+                       opts->video_id, opts->sub_id, filename);
     }
+    if (d)
+        return d;
     mp_msg(MSGT_CPLAYER, MSGL_ERR, "Could not open source '%s'!\n", filename);
     free_stream(s);
-    return false;
+    return NULL;
 }
 
-static bool open_source(struct MPContext *mpctx, struct bstr filename)
+struct open_source_ctx {
+    struct MPContext *mpctx;
+    struct bstr *files;
+};
+
+// Called by timeline_open_sources(), possibly from several threads at once.
+static struct demuxer *open_source(void *octx, int index, struct MPOpts *opts)
 {
+    struct MPContext *mpctx = ((struct open_source_ctx *)octx)->mpctx;
+    struct bstr filename = ((struct open_source_ctx *)octx)->files[index];
     void *ctx = talloc_new(NULL);
-    bool res = false;
+    struct demuxer *res = NULL;
 
     struct bstr dirname = mp_dirname(mpctx->demuxer->filename);
 
@@ -233,10 +234,9 @@ static bool open_source(struct MPContext *mpctx, struct bstr filename)
                "CUE: Invalid audio filename in .cue file!\n");
     } else {
         char *fullname = mp_path_join(ctx, dirname, base_filename);
-        if (try_open(mpctx, fullname)) {
-            res = true;
+        res = try_open(mpctx, opts, fullname);
+        if (res)
             goto out;
-        }
     }
 
     // Try an audio file with the same name as the .cue file (but different
@@ -258,10 +258,9 @@ static bool open_source(struct MPContext *mpctx, struct bstr filename)
             mp_msg(MSGT_CPLAYER, MSGL_WARN, "CUE: No useful audio filename "
                     "in .cue file found, trying with '%s' instead!\n",
                     dename0);
-            if (try_open(mpctx, mp_path_join(ctx, dirname, dename))) {
-                res = true;
+            res = try_open(mpctx, opts, mp_path_join(ctx, dirname, dename));
+            if (res)
                 break;
-            }
         }
     }
     closedir(d);
@@ -367,10 +366,20 @@ void build_cue_timeline(struct MPContext *mpctx)
 
     add_source(mpctx, mpctx->demuxer);
 
+    struct demuxer **demuxers = talloc_array(ctx, struct demuxer *,
+                                             file_count);
+    struct open_source_ctx octx = { mpctx, files };
+    timeline_open_sources(mpctx, file_count, open_source, &octx, demuxers);
+    bool failed = false;
     for (size_t i = 0; i < file_count; i++) {
-        if (!open_source(mpctx, files[i]))
-            goto out;
+        // Add the opened ones anyway, so that they're freed on exit
+        if (demuxers[i])
+            add_source(mpctx, demuxers[i]);
+        else
+            failed = true;
     }
+    if (failed)
+        goto out;
 
     struct timeline_part *timeline = talloc_array_ptrtype(NULL, timeline,
                                                           track_count + 1);
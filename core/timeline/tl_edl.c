@@ -53,6 +53,22 @@ struct edl_part {
     int lineno;
 };
 
+static struct demuxer *open_edl_source(void *ctx, int index,
+                                       struct MPOpts *opts)
+{
+    struct edl_source *src = (struct edl_source *)ctx + index;
+    int format = 0;
+    struct stream *s = open_stream(src->filename, opts, &format);
+    if (!s)
+        return NULL;
+    struct demuxer *d = demux_open(opts, s, format, opts->audio_id,
+                                   opts->video_id, opts->sub_id,
+                                   src->filename);
+    if (!d)
+        free_stream(s);
+    return d;
+}
+
 static int find_edl_source(struct edl_source *sources, int num_sources,
                            struct bstr name)
 {
@@ -353,27 +369,21 @@ void build_edl_timeline(struct MPContext *mpctx)
     sources[0] = mpctx->demuxer;
     mpctx->num_sources = 1;
 
+    timeline_open_sources(mpctx, num_sources, open_edl_source, edl_ids,
+                          sources + 1);
+    bool failed = false;
     for (int i = 0; i < num_sources; i++) {
-        int format = 0;
-        struct stream *s = open_stream(edl_ids[i].filename, &mpctx->opts,
-                                       &format);
-        if (!s)
-            goto openfail;
-        struct demuxer *d = demux_open(&mpctx->opts, s, format,
-                                       mpctx->opts.audio_id,
-                                       mpctx->opts.video_id,
-                                       mpctx->opts.sub_id,
-                                       edl_ids[i].filename);
-        if (!d) {
-            free_stream(s);
-        openfail:
+        // Keep the opened ones in the list, so that they're freed on exit
+        if (sources[i + 1]) {
+            sources[mpctx->num_sources++] = sources[i + 1];
+        } else {
             mp_msg(MSGT_CPLAYER, MSGL_ERR, "EDL: Could not open source "
                    "file on line %d!\n", edl_ids[i].lineno);
-            goto out;
+            failed = true;
         }
-        sources[mpctx->num_sources] = d;
-        mpctx->num_sources++;
     }
+    if (failed)
+        goto out;
 
     // Write final timeline structure
 
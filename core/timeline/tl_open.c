@@ -0,0 +1,133 @@
+/*
+ * This file is part of mpv.
+ *
+ * mpv is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * mpv is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with mpv.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+#include <stdbool.h>
+
+#include "config.h"
+#include "talloc.h"
+
+#ifdef HAVE_PTHREADS
+#include <pthread.h>
+#endif
+
+#include "core/mp_core.h"
+#include "core/mp_msg.h"
+#include "core/options.h"
+#include "demux/demux.h"
+
+// Maximum number of sources opened at the same time
+#define TIMELINE_OPEN_THREADS 4
+
+struct open_job {
+    struct MPOpts opts;
+    struct demuxer *demuxer;
+};
+
+struct open_ctx {
+    timeline_open_fn open_fn;
+    void *fn_ctx;
+    struct open_job *jobs;
+    int num_jobs;
+#ifdef HAVE_PTHREADS
+    pthread_mutex_t lock;
+    int next_job;
+#endif
+};
+
+static void run_job(struct open_ctx *ctx, int index)
+{
+    struct open_job *job = &ctx->jobs[index];
+    job->demuxer = ctx->open_fn(ctx->fn_ctx, index, &job->opts);
+}
+
+#ifdef HAVE_PTHREADS
+static void *open_thread(void *arg)
+{
+    struct open_ctx *ctx = arg;
+    while (1) {
+        pthread_mutex_lock(&ctx->lock);
+        int index = ctx->next_job++;
+        pthread_mutex_unlock(&ctx->lock);
+        if (index >= ctx->num_jobs)
+            break;
+        run_job(ctx, index);
+    }
+    return NULL;
+}
+#endif
+
+/* Call open_fn for each index in [0, num) and store the result in
+ * demuxers[index]. With pthreads, up to TIMELINE_OPEN_THREADS sources are
+ * opened concurrently, which hides most of the per-file latency of timelines
+ * referencing many files (especially network ones).
+ *
+ * open_fn gets a private copy of mpctx->opts, because demux_open() writes to
+ * it. mpctx itself must be treated as read-only by open_fn. The returned
+ * demuxers are switched to mpctx->opts before this function returns.
+ */
+void timeline_open_sources(struct MPContext *mpctx, int num,
+                           timeline_open_fn open_fn, void *fn_ctx,
+                           struct demuxer **demuxers)
+{
+    if (num <= 0)
+        return;
+    struct open_ctx ctx = {
+        .open_fn = open_fn,
+        .fn_ctx = fn_ctx,
+        .jobs = talloc_array(NULL, struct open_job, num),
+        .num_jobs = num,
+    };
+    for (int n = 0; n < num; n++)
+        ctx.jobs[n] = (struct open_job) { .opts = mpctx->opts };
+
+    int done = 0;
+#ifdef HAVE_PTHREADS
+    pthread_mutex_init(&ctx.lock, NULL);
+    pthread_t threads[TIMELINE_OPEN_THREADS];
+    int num_threads = 0;
+    if (num > 1) {
+        for (int n = 0; n < TIMELINE_OPEN_THREADS && n < num; n++) {
+            if (pthread_create(&threads[num_threads], NULL, open_thread, &ctx))
+                break;
+            num_threads++;
+        }
+    }
+    if (num_threads) {
+        for (int n = 0; n < num_threads; n++)
+            pthread_join(threads[n], NULL);
+        done = num;
+    }
+    pthread_mutex_destroy(&ctx.lock);
+    if (num_threads)
+        mp_msg(MSGT_CPLAYER, MSGL_V, "Opened %d timeline sources using %d "
+               "threads.\n", num, num_threads);
+#endif
+    for (int n = done; n < num; n++)
+        run_job(&ctx, n);
+
+    for (int n = 0; n < num; n++) {
+        struct open_job *job = &ctx.jobs[n];
+        demuxers[n] = job->demuxer;
+        if (job->demuxer) {
+            demux_set_opts(job->demuxer, &mpctx->opts);
+            // Same as if the sources had been opened one after another
+            mpctx->opts.correct_pts = job->opts.correct_pts;
+        }
+    }
+    talloc_free(ctx.jobs);
+}
@@ -588,13 +588,35 @@ freeout:
 }
 
 if(index_mode>=2 || (priv->idx_size==0 && index_mode==1)){
-  int idx_pos = 0;
-  // build index for file:
-  stream_reset(demuxer->stream);
-  stream_seek(demuxer->stream,demuxer->movi_start);
-
-  priv->idx_size=0;
+  // Build index for file. Only the start of the file is scanned here, the
+  // rest is added when playback or seeking gets there.
+  free(priv->idx);
   priv->idx=NULL;
+  priv->idx_size=0;
+  priv->idx_alloc=0;
+  priv->idx_gen_pos=demuxer->movi_start;
+  priv->idxfix_videostream=idxfix_videostream;
+  priv->idxfix_divx=idxfix_divx;
+  avi_generate_index(demuxer,demuxer->movi_start+AVI_INDEX_STEP);
+  mp_msg(MSGT_HEADER,MSGL_V,"AVI: Generating index on demand, %d chunks so far.\n",priv->idx_size);
+}
+}
+
+/* Append the chunks starting at priv->idx_gen_pos to the index, up to the
+ * first chunk starting at or after the file position until (until<0 scans to
+ * the end of the file). Returns the number of entries added.
+ */
+int avi_generate_index(demuxer_t *demuxer, int64_t until)
+{
+  avi_priv_t *priv=demuxer->priv;
+  stream_t *s=demuxer->stream;
+  int old_size=priv->idx_size;
+  int64_t filepos=priv->idx_gen_pos;
+
+  if(!filepos)
+    return 0;
+  stream_reset(s);
+  stream_seek(s,filepos);
 
   while(1){
     int id;
@@ -602,52 +624,60 @@ if(index_mode>=2 || (priv->idx_size==0 && index_mode==1)){
     int64_t skip;
     AVIINDEXENTRY* idx;
     unsigned int c;
-    demuxer->filepos=stream_tell(demuxer->stream);
-    if(demuxer->filepos>=demuxer->movi_end && demuxer->movi_start<demuxer->movi_end) break;
-    id=stream_read_dword_le(demuxer->stream);
-    len=stream_read_dword_le(demuxer->stream);
+    filepos=stream_tell(s);
+    if(until>=0 && filepos>=until) break;
+    if(filepos>=demuxer->movi_end && demuxer->movi_start<demuxer->movi_end){
+      filepos=0;
+      break;
+    }
+    id=stream_read_dword_le(s);
+    len=stream_read_dword_le(s);
     if(id==mmioFOURCC('L','I','S','T') || id==mmioFOURCC('R', 'I', 'F', 'F')){
-      id=stream_read_dword_le(demuxer->stream); // list or RIFF type
+      id=stream_read_dword_le(s); // list or RIFF type
       continue;
     }
-    if(stream_eof(demuxer->stream)) break;
+    if(stream_eof(s)){
+      filepos=0;
+      break;
+    }
     if(!id || avi_stream_id(id)==100) goto skip_chunk; // bad ID (or padding?)
 
-    if(idx_pos>=priv->idx_size){
-//      priv->idx_size+=32;
-      priv->idx_size+=1024; // +16kB
-      priv->idx=realloc(priv->idx,priv->idx_size*sizeof(AVIINDEXENTRY));
-      if(!priv->idx){idx_pos=0; break;} // error!
+    if(priv->idx_size>=priv->idx_alloc){
+      int alloc=priv->idx_alloc?priv->idx_alloc*2:1024;
+      void *new_idx=realloc(priv->idx,alloc*sizeof(AVIINDEXENTRY));
+      if(!new_idx){filepos=0; break;} // error! keep what we have
+      priv->idx=new_idx;
+      priv->idx_alloc=alloc;
     }
-    idx=&((AVIINDEXENTRY *)priv->idx)[idx_pos++];
+    idx=&((AVIINDEXENTRY *)priv->idx)[priv->idx_size++];
     idx->ckid=id;
     idx->dwFlags=AVIIF_KEYFRAME; // FIXME
-    idx->dwFlags|=(demuxer->filepos>>16)&0xffff0000U;
-    idx->dwChunkOffset=(unsigned long)demuxer->filepos;
+    idx->dwFlags|=(filepos>>16)&0xffff0000U;
+    idx->dwChunkOffset=(unsigned long)filepos;
     idx->dwChunkLength=len;
 
-    c=stream_read_dword(demuxer->stream);
+    c=stream_read_dword(s);
 
     if(!len) idx->dwFlags&=~AVIIF_KEYFRAME;
 
     // Fix keyframes for DivX files:
-    if(idxfix_divx)
-      if(avi_stream_id(id)==idxfix_videostream){
-        switch(idxfix_divx){
-    	    case 3: c=stream_read_dword(demuxer->stream)<<5; //skip 32+5 bits for m$mpeg4v1
+    if(priv->idxfix_divx)
+      if(avi_stream_id(id)==priv->idxfix_videostream){
+        switch(priv->idxfix_divx){
+    	    case 3: c=stream_read_dword(s)<<5; //skip 32+5 bits for m$mpeg4v1
     	    case 1: if(c&0x40000000) idx->dwFlags&=~AVIIF_KEYFRAME;break; // divx 3
 	    case 2: if(c==0x1B6) idx->dwFlags&=~AVIIF_KEYFRAME;break; // divx 4
 	}
       }
 
-    // update status line:
-    { static int64_t lastpos;
+    // update status line (only when scanning the whole file at once):
+    if(until<0){ static int64_t lastpos;
       int64_t pos;
       int64_t len=demuxer->movi_end-demuxer->movi_start;
       if(len){
-          pos=100*(demuxer->filepos-demuxer->movi_start)/len; // %
+          pos=100*(filepos-demuxer->movi_start)/len; // %
       } else {
-          pos=(demuxer->filepos-demuxer->movi_start)>>20; // MB
+          pos=(filepos-demuxer->movi_start)>>20; // MB
       }
       if(pos!=lastpos){
           lastpos=pos;
@@ -655,23 +685,15 @@ if(index_mode>=2 || (priv->idx_size==0 && index_mode==1)){
 		 (unsigned long)pos, len?"%":"MB");
       }
     }
-    mp_dbg(MSGT_HEADER,MSGL_DBG2,"%08X %08X %.4s %08X %X\n",(unsigned int)demuxer->filepos,id,(char *) &id,(int)c,(unsigned int) idx->dwFlags);
-#if 0
-    { unsigned char tmp[64];
-      int i;
-      stream_read(demuxer->stream,tmp,64);
-      printf("%.4s",&id);
-      for(i=0;i<64;i++) printf(" %02X",tmp[i]);
-      printf("\n");
-    }
-#endif
+    mp_dbg(MSGT_HEADER,MSGL_DBG2,"%08X %08X %.4s %08X %X\n",(unsigned int)filepos,id,(char *) &id,(int)c,(unsigned int) idx->dwFlags);
 skip_chunk:
     skip=(len+1)&(~1UL); // total bytes in this chunk
-    stream_seek(demuxer->stream,8+demuxer->filepos+skip);
+    stream_seek(s,8+filepos+skip);
   }
-  priv->idx_size=idx_pos;
-  mp_tmsg(MSGT_HEADER,MSGL_INFO,"AVI: Generated index table for %d chunks!\n",priv->idx_size);
-  if( mp_msg_test(MSGT_HEADER,MSGL_DBG2) ) print_index(priv->idx,priv->idx_size,MSGL_DBG2);
-
-}
+  priv->idx_gen_pos=filepos;
+  if(!filepos)
+    mp_tmsg(MSGT_HEADER,until<0?MSGL_INFO:MSGL_V,"AVI: Generated index table for %d chunks!\n",priv->idx_size);
+  if( mp_msg_test(MSGT_HEADER,MSGL_DBG2) )
+    print_index((AVIINDEXENTRY *)priv->idx+old_size,priv->idx_size-old_size,MSGL_DBG2);
+  return priv->idx_size-old_size;
 }
@@ -348,6 +348,10 @@ typedef struct {
   // index stuff:
   void* idx;
   int idx_size;
+  int idx_alloc;
+  int64_t idx_gen_pos; // generated index continues here, 0 if it's complete
+  int idxfix_videostream;
+  int idxfix_divx;
   int64_t idx_pos;
   int64_t idx_pos_a;
   int64_t idx_pos_v;
@@ -376,7 +380,11 @@ typedef struct {
 
 #define AVI_IDX_OFFSET(x) ((((uint64_t)(x)->dwFlags&0xffff0000)<<16)+(x)->dwChunkOffset)
 
+// Generated indexes are extended in steps of this many bytes of the file
+#define AVI_INDEX_STEP (16*1024*1024)
+
 struct demuxer;
 void read_avi_header(struct demuxer *demuxer, int index_mode);
+int avi_generate_index(struct demuxer *demuxer, int64_t until);
 
 #endif /* MPLAYER_AVIHEADER_H */
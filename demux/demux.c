@@ -32,6 +32,7 @@
 #include "core/av_common.h"
 #include "talloc.h"
 #include "core/mp_msg.h"
+#include "osdep/timer.h"
 
 #include "stream/stream.h"
 #include "demux.h"
@@ -913,15 +914,21 @@ static struct demuxer *open_given_type(struct MPOpts *opts,
     demuxer = new_demuxer(opts, stream, desc->type, audio_id,
                           video_id, sub_id, filename);
     demuxer->params = params;
-    if (desc->check_file)
+    if (desc->check_file) {
+        int64_t start = mp_time_us();
         fformat = desc->check_file(demuxer);
-    else
+        mp_msg(MSGT_DEMUXER, MSGL_V, "Demuxer %s: check took %.3f ms\n",
+               desc->name, (mp_time_us() - start) / 1000.0);
+    } else {
         fformat = desc->type;
+    }
     if (force)
         fformat = desc->type;
     if (fformat == 0)
         goto fail;
     if (fformat == desc->type) {
+        // Only the detected demuxer reads beyond the probe data.
+        stream_probe_stop(stream);
         if (demuxer->filetype)
             mp_tmsg(MSGT_DEMUXER, MSGL_INFO, "Detected file format: %s (%s)\n",
                     demuxer->filetype, desc->shortdesc);
@@ -933,6 +940,8 @@ static struct demuxer *open_given_type(struct MPOpts *opts,
             if (!demux2) {
                 mp_tmsg(MSGT_DEMUXER, MSGL_ERR, "Opening as detected format "
                         "\"%s\" failed.\n", desc->shortdesc);
+                // Other demuxers might be tried next.
+                stream_probe_start(stream, 0);
                 goto fail;
             }
             /* At least demux_mov can return a demux_demuxers instance
@@ -976,13 +985,55 @@ static struct demuxer *open_given_type(struct MPOpts *opts,
     return NULL;
 }
 
+static struct demuxer *probe_demuxers(struct MPOpts *opts,
+                                      struct stream *stream, char *filename,
+                                      int audio_id, int video_id, int sub_id,
+                                      struct demuxer_params *params)
+{
+    struct demuxer *demuxer = NULL;
+    const struct demuxer_desc *desc;
+
+    // Test demuxers with safe file checks
+    for (int i = 0; (desc = demuxer_list[i]); i++) {
+        if (desc->safe_check) {
+            demuxer = open_given_type(opts, desc, stream, false, audio_id,
+                                      video_id, sub_id, filename, params);
+            if (demuxer)
+                return demuxer;
+        }
+    }
+
+    // Ok. We're over the stable detectable fileformats, the next ones are
+    // a bit fuzzy. So by default (extension_parsing==1) try extension-based
+    // detection first:
+    if (filename && opts->extension_parsing == 1) {
+        desc = get_demuxer_desc_from_type(demuxer_type_by_filename(filename));
+        if (desc)
+            demuxer = open_given_type(opts, desc, stream, false, audio_id,
+                                      video_id, sub_id, filename, params);
+        if (demuxer)
+            return demuxer;
+    }
+
+    // Finally try detection for demuxers with unsafe checks
+    for (int i = 0; (desc = demuxer_list[i]); i++) {
+        if (!desc->safe_check && desc->check_file) {
+            demuxer = open_given_type(opts, desc, stream, false, audio_id,
+                                      video_id, sub_id, filename, params);
+            if (demuxer)
+                return demuxer;
+        }
+    }
+
+    return NULL;
+}
+
 struct demuxer *demux_open_withparams(struct MPOpts *opts,
                                       struct stream *stream, int file_format,
                                       char *force_format, int audio_id,
                                       int video_id, int sub_id, char *filename,
                                       struct demuxer_params *params)
 {
-    struct demuxer *demuxer = NULL;
     const struct demuxer_desc *desc;
 
     int force = 0;
@@ -1021,39 +1072,15 @@ struct demuxer *demux_open_withparams(struct MPOpts *opts,
                                video_id, sub_id, filename, params);
     }
 
-    // Test demuxers with safe file checks
-    for (int i = 0; (desc = demuxer_list[i]); i++) {
-        if (desc->safe_check) {
-            demuxer = open_given_type(opts, desc, stream, false, audio_id,
-                                      video_id, sub_id, filename, params);
-            if (demuxer)
-                return demuxer;
-        }
-    }
-
-    // Ok. We're over the stable detectable fileformats, the next ones are
-    // a bit fuzzy. So by default (extension_parsing==1) try extension-based
-    // detection first:
-    if (filename && opts->extension_parsing == 1) {
-        desc = get_demuxer_desc_from_type(demuxer_type_by_filename(filename));
-        if (desc)
-            demuxer = open_given_type(opts, desc, stream, false, audio_id,
-                                      video_id, sub_id, filename, params);
-        if (demuxer)
-            return demuxer;
-    }
-
-    // Finally try detection for demuxers with unsafe checks
-    for (int i = 0; (desc = demuxer_list[i]); i++) {
-        if (!desc->safe_check && desc->check_file) {
-            demuxer = open_given_type(opts, desc, stream, false, audio_id,
-                                      video_id, sub_id, filename, params);
-            if (demuxer)
-                return demuxer;
-        }
-    }
-
-    return NULL;
+    // Read the start of the stream only once for all format checks.
+    stream_probe_start(stream, opts->demuxer_probe_size * 1024);
+    int64_t start = mp_time_us();
+    struct demuxer *demuxer = probe_demuxers(opts, stream, filename, audio_id,
+                                             video_id, sub_id, params);
+    mp_msg(MSGT_DEMUXER, MSGL_V, "Format detection took %.3f ms\n",
+           (mp_time_us() - start) / 1000.0);
+    stream_probe_stop(stream);
+    return demuxer;
 }
 
 struct demuxer *demux_open(struct MPOpts *opts, stream_t *vs, int file_format,
@@ -1064,6 +1091,25 @@ struct demuxer *demux_open(struct MPOpts *opts, stream_t *vs, int file_format,
                                  audio_id, video_id, sub_id, filename, NULL);
 }
 
+// Switch the options a demuxer and its stream use, e.g. from the private
+// copy it was opened with in a background thread to the player's.
+void demux_set_opts(struct demuxer *demuxer, struct MPOpts *opts)
+{
+    demuxer->opts = opts;
+    if (demuxer->stream)
+        demuxer->stream->opts = opts;
+    for (int n = 0; n < demuxer->num_streams; n++) {
+        struct sh_stream *sh = demuxer->streams[n];
+        sh->opts = opts;
+        if (sh->video)
+            sh->video->opts = opts;
+        if (sh->audio)
+            sh->audio->opts = opts;
+        if (sh->sub)
+            sh->sub->opts = opts;
+    }
+}
+
 void demux_flush(demuxer_t *demuxer)
 {
     ds_free_packs(demuxer->video);
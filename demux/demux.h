@@ -361,6 +361,7 @@ static inline int avi_stream_id(unsigned int id)
     return a * 10 + b;
 }
 
+void demux_set_opts(struct demuxer *demuxer, struct MPOpts *opts);
 struct demuxer *demux_open(struct MPOpts *opts, struct stream *stream,
                            int file_format, int aid, int vid, int sid,
                            char *filename);
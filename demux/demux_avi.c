@@ -208,6 +208,17 @@ static uint32_t avi_find_id(stream_t *stream) {
   return id;
 }
 
+// Add the next part of a generated index. Returns 0 if the index is complete.
+static int avi_extend_index(demuxer_t *demux)
+{
+  avi_priv_t *priv=demux->priv;
+  while(priv->idx_gen_pos){
+    if(avi_generate_index(demux,priv->idx_gen_pos+AVI_INDEX_STEP))
+      return 1;
+  }
+  return 0;
+}
+
 // return value:
 //     0 = EOF or no stream found
 //     1 = successfully read a packet
@@ -221,6 +232,8 @@ demux_stream_t *ds;
 do{
   int flags=1;
   AVIINDEXENTRY *idx=NULL;
+  if(priv->idx_pos>=priv->idx_size)
+    avi_extend_index(demux);
   if(priv->idx_size>0 && priv->idx_pos<priv->idx_size){
     int64_t pos;
 
@@ -289,6 +302,7 @@ do{
 	    demux->type=DEMUXER_TYPE_AVI_NI;
 	    demux->desc=&demuxer_desc_avi_ni;
 	    --priv->idx_pos; // hack
+	    avi_generate_index(demux,-1);
 	} else {
 	    // no index
 	    demux->type=DEMUXER_TYPE_AVI_NINI;
@@ -479,7 +493,7 @@ static demuxer_t* demux_open_avi(demuxer_t* demuxer){
       int i;
       int64_t a_pos=-1;
       int64_t v_pos=-1;
-      for(i=0;i<priv->idx_size;i++){
+      for(i=0;i<priv->idx_size || avi_extend_index(demuxer);i++){
         AVIINDEXENTRY* idx=&((AVIINDEXENTRY *)priv->idx)[i];
         demux_stream_t* ds=demux_avi_select_stream(demuxer,idx->ckid);
         int64_t pos = priv->idx_offset + AVI_IDX_OFFSET(idx);
@@ -491,6 +505,7 @@ static demuxer_t* demux_open_avi(demuxer_t* demuxer){
           v_pos=pos;
           if(a_pos!=-1) break;
         }
+        if(v_pos!=-1 && d_audio->id==-2) break; // no sound
       }
       if(v_pos==-1){
           mp_msg(MSGT_DEMUX, MSGL_ERR, "AVI_NI: %s",
@@ -505,6 +520,8 @@ static demuxer_t* demux_open_avi(demuxer_t* demuxer){
           demuxer->type=DEMUXER_TYPE_AVI_NI; // HACK!!!!
           demuxer->desc=&demuxer_desc_avi_ni; // HACK!!!!
 	  pts_from_bps=1; // force BPS sync!
+          // seeking in the separate streams needs the whole index
+          avi_generate_index(demuxer,-1);
         }
       }
   } else {
@@ -546,6 +563,11 @@ static demuxer_t* demux_open_avi(demuxer_t* demuxer){
     size_t vsamples=0;
     size_t asamples=0;
     int i;
+    // an incomplete index is good enough to estimate the bitrates, but the
+    // frame count has to come from the header then
+    if(sh_video->video.dwLength<=1)
+      avi_generate_index(demuxer,-1);
+    idx=priv->idx;
     for(i=0;i<priv->idx_size;i++){
       int id=avi_stream_id(idx[i].ckid);
       unsigned len=idx[i].dwChunkLength;
@@ -561,7 +583,7 @@ static demuxer_t* demux_open_avi(demuxer_t* demuxer){
     mp_msg(MSGT_DEMUX, MSGL_V,
            "AVI video size=%"PRId64" (%zu) audio size=%"PRId64" (%zu)\n",
            vsize, vsamples, asize, asamples);
-    priv->numberofframes=vsamples;
+    priv->numberofframes=priv->idx_gen_pos?sh_video->video.dwLength:vsamples;
     sh_video->i_bps=((float)vsize/(float)vsamples)*(float)sh_video->video.dwRate/(float)sh_video->video.dwScale;
     if(sh_audio) sh_audio->i_bps=((float)asize/(float)asamples)*(float)sh_audio->audio.dwRate/(float)sh_audio->audio.dwScale;
   } else {
@@ -627,7 +649,7 @@ static void demux_seek_avi(demuxer_t *demuxer, float rel_seek_secs,
       // find nearest video keyframe chunk pos:
       if(rel_seek_frames>0){
         // seek forward
-        while(video_chunk_pos<priv->idx_size-1){
+        while(video_chunk_pos<priv->idx_size-1 || avi_extend_index(demuxer)){
           int id=((AVIINDEXENTRY *)priv->idx)[video_chunk_pos].ckid;
           if(avi_stream_id(id)==d_video->id){  // video frame
             if((--rel_seek_frames)<0 && ((AVIINDEXENTRY *)priv->idx)[video_chunk_pos].dwFlags&AVIIF_KEYFRAME) break;
@@ -705,7 +727,7 @@ static void demux_seek_avi(demuxer_t *demuxer, float rel_seek_secs,
 	    audio_chunk_pos=0;
 
         // find audio chunk pos:
-          for(i=0;i<priv->idx_size && chunks>0;i++){
+          for(i=0;chunks>0 && (i<priv->idx_size || avi_extend_index(demuxer));i++){
             int id=((AVIINDEXENTRY *)priv->idx)[i].ckid;
             if(avi_stream_id(id)==d_audio->id){
                 len=((AVIINDEXENTRY *)priv->idx)[i].dwChunkLength;
@@ -775,8 +797,7 @@ static void demux_close_avi(demuxer_t *demuxer)
   if(!priv)
     return;
 
-  if(priv->idx_size > 0)
-    free(priv->idx);
+  free(priv->idx);
   free(priv);
 }
 
@@ -23,12 +23,24 @@
 #include <stdlib.h>
 #include <unistd.h>
 #include <math.h>
+#include <errno.h>
+#include <inttypes.h>
 
 #include "config.h"
+
+// The keyframe index needs threads and a POSIX pread() (MinGW has none)
+#if defined(HAVE_PTHREADS) && !defined(__MINGW32__)
+#define MPG_INDEX 1
+#include <pthread.h>
+#endif
+
+#include "talloc.h"
 #include "core/mp_msg.h"
 #include "core/options.h"
 
 #include "libavutil/attributes.h"
+#include "libavutil/intreadwrite.h"
+#include "core/mp_common.h"
 #include "audio/decode/dec_audio.h"
 #include "stream/stream.h"
 #include "demux.h"
@@ -49,6 +61,24 @@
 #define AUDIO_LPCM_BE   0x10001
 #define AUDIO_AAC       mmioFOURCC('M', 'P', '4', 'A')
 
+// Start code counts used to guess the format when the stream isn't a PS
+struct mpg_stats {
+  int num_elementary_packets100;
+  int num_elementary_packets101;
+  int num_elementary_packets12x;
+  int num_elementary_packets1B6;
+  int num_elementary_packetsPES;
+  int num_mpeg12_startcode;
+  int num_h264_slice; //combined slice
+  int num_h264_dpa; //DPA Slice
+  int num_h264_dpb; //DPB Slice
+  int num_h264_dpc; //DPC Slice
+  int num_h264_idr; //IDR Slice
+  int num_h264_sps;
+  int num_h264_pps;
+  int num_mp3audio_packets;
+};
+
 typedef struct mpg_demuxer {
   float last_pts;
   float first_pts;              // first pts found in stream
@@ -58,9 +88,10 @@ typedef struct mpg_demuxer {
   unsigned int es_map[0x40];	//es map of stream types (associated to the pes id) from 0xb0 to 0xef
   int num_a_streams;
   int a_stream_ids[MAX_A_STREAMS];
+  struct mpg_index *index;      // keyframe index, or NULL
+  struct mpg_stats stats;
 } mpg_demuxer_t;
 
-static int mpeg_pts_error=0;
 int64_t ps_probe = 0;
 
 static int parse_psm(demuxer_t *demux, int len) {
@@ -189,10 +220,9 @@ static demuxer_t* demux_mpg_open(demuxer_t* demuxer) {
   mpg_demuxer_t* mpg_d;
 
   if (!ds_fill_buffer(demuxer->video)) return 0;
-  mpg_d = calloc(1,sizeof(mpg_demuxer_t));
+  mpg_d = demuxer->priv;
   if(mpg_d)
   {
-    demuxer->priv = mpg_d;
     mpg_d->last_pts = -1.0;
     mpg_d->first_pts = -1.0;
 
@@ -245,19 +275,24 @@ static demuxer_t* demux_mpg_open(demuxer_t* demuxer) {
   return demuxer;
 }
 
+static void index_stop(mpg_demuxer_t *mpg_d);
+
 static void demux_close_mpg(demuxer_t* demuxer) {
   mpg_demuxer_t* mpg_d = demuxer->priv;
+  if (mpg_d)
+    index_stop(mpg_d);
   free(mpg_d);
 }
 
 
-static unsigned long long read_mpeg_timestamp(stream_t *s,int c){
+static unsigned long long read_mpeg_timestamp(stream_t *s,int c,
+                                              int *pts_error){
   unsigned int d,e;
   unsigned long long pts;
   d=stream_read_word(s);
   e=stream_read_word(s);
   if( ((c&1)!=1) || ((d&1)!=1) || ((e&1)!=1) ){
-    ++mpeg_pts_error;
+    ++*pts_error;
     return 0; // invalid pts
   }
   pts=(((uint64_t)((c>>1)&7))<<30)|((d>>1)<<15)|(e>>1);
@@ -339,6 +374,7 @@ static int demux_mpg_read_packet(demuxer_t *demux,int id){
   unsigned long long dts av_unused = 0;
   int l;
   int pes_ext2_subid=-1;
+  int pts_error=0;
   double stream_pts = MP_NOPTS_VALUE;
   demux_stream_t *ds=NULL;
   demux_packet_t* dp;
@@ -364,8 +400,6 @@ static int demux_mpg_read_packet(demuxer_t *demux,int id){
     return -2;  // invalid packet !!!!!!
   }
 
-  mpeg_pts_error=0;
-
   if(id==0x1BC) {
     parse_psm(demux, len);
     return 0;
@@ -385,16 +419,16 @@ static int demux_mpg_read_packet(demuxer_t *demux,int id){
   }
   // Read System-1 stream timestamps:
   if((c>>4)==2){
-    pts=read_mpeg_timestamp(demux->stream,c);
+    pts=read_mpeg_timestamp(demux->stream,c,&pts_error);
     set_pts=1;
     len-=4;
   } else
   if((c>>4)==3){
-    pts=read_mpeg_timestamp(demux->stream,c);
+    pts=read_mpeg_timestamp(demux->stream,c,&pts_error);
     c=stream_read_char(demux->stream);
     if((c>>4)!=1) pts=0; //printf("{ERROR4}");
     else set_pts = 1;
-    dts=read_mpeg_timestamp(demux->stream,c);
+    dts=read_mpeg_timestamp(demux->stream,c,&pts_error);
     len-=4+1+4;
   } else
   if((c>>6)==2){
@@ -412,16 +446,16 @@ static int demux_mpg_read_packet(demuxer_t *demux,int id){
     if(hdrlen>len){ mp_msg(MSGT_DEMUX,MSGL_V,"demux_mpg: invalid header length  \n"); return -1;}
     if(pts_flags==2 && hdrlen>=5){
       c=stream_read_char(demux->stream);
-      pts=read_mpeg_timestamp(demux->stream,c);
+      pts=read_mpeg_timestamp(demux->stream,c,&pts_error);
       set_pts=1;
       len-=5;hdrlen-=5;
     } else
     if(pts_flags==3 && hdrlen>=10){
       c=stream_read_char(demux->stream);
-      pts=read_mpeg_timestamp(demux->stream,c);
+      pts=read_mpeg_timestamp(demux->stream,c,&pts_error);
       set_pts=1;
       c=stream_read_char(demux->stream);
-      dts=read_mpeg_timestamp(demux->stream,c);
+      dts=read_mpeg_timestamp(demux->stream,c,&pts_error);
       len-=10;hdrlen-=10;
     }
     len-=hdrlen;
@@ -585,7 +619,7 @@ static int demux_mpg_read_packet(demuxer_t *demux,int id){
       return -1;  // invalid packet !!!!!!
     }
   }
-  if(mpeg_pts_error) mp_msg(MSGT_DEMUX,MSGL_V,"  {PTS_err:%d}  \n",mpeg_pts_error);
+  if(pts_error) mp_msg(MSGT_DEMUX,MSGL_V,"  {PTS_err:%d}  \n",pts_error);
   mp_dbg(MSGT_DEMUX,MSGL_DBG3," => len=%d\n",len);
 
 //  if(len<=0 || len>MAX_PS_PACKETSIZE) return -1;  // Invalid packet size
@@ -665,59 +699,25 @@ static int demux_mpg_read_packet(demuxer_t *demux,int id){
   return 0;
 }
 
-static int num_elementary_packets100=0;
-static int num_elementary_packets101=0;
-static int num_elementary_packets12x=0;
-static int num_elementary_packets1B6=0;
-static int num_elementary_packetsPES=0;
-static int num_mpeg12_startcode=0;
-static int num_h264_slice=0; //combined slice
-static int num_h264_dpa=0; //DPA Slice
-static int num_h264_dpb=0; //DPB Slice
-static int num_h264_dpc=0; //DPC Slice
-static int num_h264_idr=0; //IDR Slice
-static int num_h264_sps=0;
-static int num_h264_pps=0;
-
-static int num_mp3audio_packets=0;
-
-static void clear_stats(void)
-{
-  num_elementary_packets100=0;
-  num_elementary_packets101=0;
-  num_elementary_packets1B6=0;
-  num_elementary_packets12x=0;
-  num_elementary_packetsPES=0;
-  num_mpeg12_startcode=0;
-  num_h264_slice=0; //combined slice
-  num_h264_dpa=0; //DPA Slice
-  num_h264_dpb=0; //DPB Slice
-  num_h264_dpc=0; //DPC Slice
-  num_h264_idr=0; //IDR Slice
-  num_h264_sps=0;
-  num_h264_pps=0;
-  num_mp3audio_packets=0;
-}
-
 //assumes demuxer->synced < 2
-static inline void update_stats(int head)
+static inline void update_stats(struct mpg_stats *st, int head)
 {
-  if(head==0x1B6) ++num_elementary_packets1B6;
-  else if(head==0x1B3 || head==0x1B8) ++num_mpeg12_startcode;
-  else if(head==0x100) ++num_elementary_packets100;
-  else if(head==0x101) ++num_elementary_packets101;
+  if(head==0x1B6) ++st->num_elementary_packets1B6;
+  else if(head==0x1B3 || head==0x1B8) ++st->num_mpeg12_startcode;
+  else if(head==0x100) ++st->num_elementary_packets100;
+  else if(head==0x101) ++st->num_elementary_packets101;
   else if(head==0x1BD || (0x1C0<=head && head<=0x1EF))
-    num_elementary_packetsPES++;
-  else if(head>=0x120 && head<=0x12F) ++num_elementary_packets12x;
+    st->num_elementary_packetsPES++;
+  else if(head>=0x120 && head<=0x12F) ++st->num_elementary_packets12x;
   if(head>=0x100 && head<0x1B0)
   {
-    if((head&~0x60) == 0x101) ++num_h264_slice;
-    else if((head&~0x60) == 0x102) ++num_h264_dpa;
-    else if((head&~0x60) == 0x103) ++num_h264_dpb;
-    else if((head&~0x60) == 0x104) ++num_h264_dpc;
-    else if((head&~0x60) == 0x105 && head != 0x105) ++num_h264_idr;
-    else if((head&~0x60) == 0x107 && head != 0x107) ++num_h264_sps;
-    else if((head&~0x60) == 0x108 && head != 0x108) ++num_h264_pps;
+    if((head&~0x60) == 0x101) ++st->num_h264_slice;
+    else if((head&~0x60) == 0x102) ++st->num_h264_dpa;
+    else if((head&~0x60) == 0x103) ++st->num_h264_dpb;
+    else if((head&~0x60) == 0x104) ++st->num_h264_dpc;
+    else if((head&~0x60) == 0x105 && head != 0x105) ++st->num_h264_idr;
+    else if((head&~0x60) == 0x107 && head != 0x107) ++st->num_h264_sps;
+    else if((head&~0x60) == 0x108 && head != 0x108) ++st->num_h264_pps;
   }
 }
 
@@ -726,6 +726,8 @@ static int demux_mpg_probe(demuxer_t *demuxer) {
   int tmp;
   int64_t tmppos;
   int file_format = DEMUXER_TYPE_UNKNOWN;
+  mpg_demuxer_t *mpg_d;
+  struct mpg_stats *st;
 
   tmppos=stream_tell(demuxer->stream);
   tmp=stream_read_dword(demuxer->stream);
@@ -735,43 +737,48 @@ static int demux_mpg_probe(demuxer_t *demuxer) {
   }
   stream_seek(demuxer->stream,tmppos);
 
-  clear_stats();
+  // The stats are collected while syncing, before demux_mpg_open() returns
+  mpg_d = calloc(1, sizeof(mpg_demuxer_t));
+  if (!mpg_d)
+    return file_format;
+  demuxer->priv = mpg_d;
+  st = &mpg_d->stats;
 
   if(demux_mpg_open(demuxer))
     file_format=DEMUXER_TYPE_MPEG_PS;
   else {
     mp_msg(MSGT_DEMUX,MSGL_V,"MPEG packet stats: p100: %d  p101: %d p1B6: %d p12x: %d sli: %d a: %d b: %d c: %d idr: %d sps: %d pps: %d PES: %d  MP3: %d, synced: %d\n",
-     num_elementary_packets100,num_elementary_packets101,
-     num_elementary_packets1B6,num_elementary_packets12x,
-     num_h264_slice, num_h264_dpa,
-     num_h264_dpb, num_h264_dpc=0,
-     num_h264_idr, num_h264_sps=0,
-     num_h264_pps,
-     num_elementary_packetsPES,num_mp3audio_packets, demuxer->synced);
+     st->num_elementary_packets100,st->num_elementary_packets101,
+     st->num_elementary_packets1B6,st->num_elementary_packets12x,
+     st->num_h264_slice, st->num_h264_dpa,
+     st->num_h264_dpb, st->num_h264_dpc=0,
+     st->num_h264_idr, st->num_h264_sps=0,
+     st->num_h264_pps,
+     st->num_elementary_packetsPES,st->num_mp3audio_packets, demuxer->synced);
 
      //MPEG packet stats: p100: 458  p101: 458  PES: 0  MP3: 1103  (.m2v)
-     if(num_mp3audio_packets>50 && num_mp3audio_packets>2*num_elementary_packets100
-        && abs(num_elementary_packets100-num_elementary_packets101)>2)
+     if(st->num_mp3audio_packets>50 && st->num_mp3audio_packets>2*st->num_elementary_packets100
+        && abs(st->num_elementary_packets100-st->num_elementary_packets101)>2)
        return file_format;
 
       // some hack to get meaningfull error messages to our unhappy users:
-      if(num_mpeg12_startcode>=2 && num_elementary_packets100>=2 && num_elementary_packets101>=2 &&
-         abs(num_elementary_packets101+8-num_elementary_packets100)<16) {
-         if(num_elementary_packetsPES>=4 && num_elementary_packetsPES>=num_elementary_packets100-4) {
+      if(st->num_mpeg12_startcode>=2 && st->num_elementary_packets100>=2 && st->num_elementary_packets101>=2 &&
+         abs(st->num_elementary_packets101+8-st->num_elementary_packets100)<16) {
+         if(st->num_elementary_packetsPES>=4 && st->num_elementary_packetsPES>=st->num_elementary_packets100-4) {
            return file_format;
          }
          file_format=DEMUXER_TYPE_MPEG_ES; //  <-- hack is here :)
       } else
           // fuzzy mpeg4-es detection. do NOT enable without heavy testing of mpeg formats detection!
-        if(num_elementary_packets1B6>3 && num_elementary_packets12x>=1 &&
-           num_elementary_packetsPES==0 && num_elementary_packets100<=num_elementary_packets12x &&
+        if(st->num_elementary_packets1B6>3 && st->num_elementary_packets12x>=1 &&
+           st->num_elementary_packetsPES==0 && st->num_elementary_packets100<=st->num_elementary_packets12x &&
            demuxer->synced<2) {
              file_format=DEMUXER_TYPE_MPEG4_ES;
         } else
          // fuzzy h264-es detection. do NOT enable without heavy testing of mpeg formats detection!
-        if((num_h264_slice>3 || (num_h264_dpa>3 && num_h264_dpb>3 && num_h264_dpc>3)) &&
-          /* FIXME num_h264_sps>=1 && */ num_h264_pps>=1 && num_h264_idr>=1 &&
-          num_elementary_packets1B6==0 && num_elementary_packetsPES==0 &&
+        if((st->num_h264_slice>3 || (st->num_h264_dpa>3 && st->num_h264_dpb>3 && st->num_h264_dpc>3)) &&
+          /* FIXME st->num_h264_sps>=1 && */ st->num_h264_pps>=1 && st->num_h264_idr>=1 &&
+          st->num_elementary_packets1B6==0 && st->num_elementary_packetsPES==0 &&
           demuxer->synced<2) {
             file_format=DEMUXER_TYPE_H264_ES;
         } else
@@ -872,6 +879,7 @@ unsigned int head=0;
 int skipped=0;
 int max_packs=256; // 512kbyte
 int ret=0;
+struct mpg_stats *st = &((mpg_demuxer_t *)demux->priv)->stats;
 
 // System stream
 do{
@@ -889,7 +897,7 @@ do{
     head<<=8;
     if(head!=0x100){
       head|=c;
-      if(mp_check_mp3_header(head)) ++num_mp3audio_packets;
+      if(mp_check_mp3_header(head)) ++st->num_mp3audio_packets;
       ++skipped; //++demux->filepos;
       continue;
     }
@@ -909,8 +917,8 @@ do{
     if(head==0x1BB || head==0x1BD || (head>=0x1C0 && head<=0x1EF)){
       demux->synced=2;
       mp_msg(MSGT_DEMUX,MSGL_V,"system stream synced at 0x%"PRIX64" (%"PRId64")!\n",(int64_t)demux->filepos,(int64_t)demux->filepos);
-      num_elementary_packets100=0; // requires for re-sync!
-      num_elementary_packets101=0; // requires for re-sync!
+      st->num_elementary_packets100=0; // requires for re-sync!
+      st->num_elementary_packets101=0; // requires for re-sync!
     } else demux->synced=0;
   } // else
   if(demux->synced>=2){
@@ -923,19 +931,19 @@ do{
         }
       if(demux->synced==3) demux->synced=(ret==1)?2:0; // PES detect
   } else {
-    update_stats(head);
+    update_stats(st, head);
     if(head>=0x100 && head<0x1B0)
       mp_msg(MSGT_DEMUX,MSGL_DBG3,"Opps... elementary video packet found: %03X\n",head);
     else if((head>=0x1C0 && head<0x1F0) || head==0x1BD)
       mp_msg(MSGT_DEMUX,MSGL_DBG3,"Opps... PES packet found: %03X\n",head);
 
-    if(((num_elementary_packets100>50 && num_elementary_packets101>50) ||
-        (num_elementary_packetsPES>50)) && skipped>4000000){
+    if(((st->num_elementary_packets100>50 && st->num_elementary_packets101>50) ||
+        (st->num_elementary_packetsPES>50)) && skipped>4000000){
         mp_msg(MSGT_DEMUX,MSGL_V,"sync_mpeg_ps: seems to be ES/PES stream...\n");
         demux->stream->eof=1;
         break;
     }
-    if(num_mp3audio_packets>100 && num_elementary_packets100<10){
+    if(st->num_mp3audio_packets>100 && st->num_elementary_packets100<10){
         mp_msg(MSGT_DEMUX,MSGL_V,"sync_mpeg_ps: seems to be MP3 stream...\n");
         demux->stream->eof=1;
         break;
@@ -950,6 +958,251 @@ do{
   return 1;
 }
 
+#ifdef MPG_INDEX
+/* Keyframe index (--mpg-index)
+ *
+ * Seeking in program streams estimates the byte position from the bitrate,
+ * which is inaccurate with VBR video and usually needs a second attempt.
+ * Optionally, a thread scans the whole file once in the background, and
+ * records the position of each pack that contains a keyframe (MPEG-1/2
+ * sequence or GOP header, H.264 IDR slice), along with the PTS of the PES
+ * packet it is in. Seeks to a time already covered by the index go straight
+ * to the keyframe. The thread reads the file with pread() on the stream's
+ * file descriptor, and never touches the stream itself.
+ */
+
+#define INDEX_BLOCK_SIZE (1024 * 1024)
+// Bytes needed after a start code to parse a PES header up to the PTS
+#define INDEX_LOOKAHEAD 32
+
+enum mpg_index_mode {
+  INDEX_MPEG12,
+  INDEX_H264,
+};
+
+struct mpg_index_entry {
+  int64_t pos;  // start of the pack containing the keyframe
+  float pts;
+};
+
+struct mpg_index {
+  pthread_t thread;
+  pthread_mutex_t lock;
+  // Read-only while the thread runs
+  int fd;
+  int64_t start, end;
+  int video_id;
+  enum mpg_index_mode mode;
+  // Protected by lock
+  struct mpg_index_entry *entries;
+  int num_entries;
+  bool complete;
+  bool stop;
+};
+
+static uint64_t index_read_pts(const unsigned char *p)
+{
+  return (uint64_t)((p[0] >> 1) & 7) << 30 |
+         (uint64_t)(AV_RB16(p + 1) >> 1) << 15 |
+         (AV_RB16(p + 3) >> 1);
+}
+
+// Parse the PES header whose stream id byte is at p. Return the PTS in
+// seconds, or -1 if there's none.
+static float index_pes_pts(const unsigned char *p)
+{
+  const unsigned char *h = p + 3;
+  if ((h[0] >> 6) == 2) {   // MPEG-2
+    if ((h[1] & 0x80) && h[2] >= 5)
+      return index_read_pts(h + 3) / 90000.0f;
+    return -1;
+  }
+  // MPEG-1: stuffing, STD buffer size, then timestamps
+  for (int n = 0; n < 16 && h[0] == 0xFF; n++)
+    h++;
+  if ((h[0] >> 6) == 1)
+    h += 2;
+  if ((h[0] >> 4) == 2 || (h[0] >> 4) == 3)
+    return index_read_pts(h) / 90000.0f;
+  return -1;
+}
+
+static bool index_stopped(struct mpg_index *idx)
+{
+  pthread_mutex_lock(&idx->lock);
+  bool stop = idx->stop;
+  pthread_mutex_unlock(&idx->lock);
+  return stop;
+}
+
+static void *index_thread(void *arg)
+{
+  struct mpg_index *idx = arg;
+  unsigned char *buf = malloc(INDEX_BLOCK_SIZE + INDEX_LOOKAHEAD);
+  int64_t pos = idx->start;
+  uint32_t state = 0xFFFFFFFF;
+  int64_t pack_pos = -1;      // last pack header
+  int64_t pes_end = -1;       // end of the current video PES packet
+  float pes_pts = -1;         // and its PTS
+  bool pes_indexed = false;   // keyframe in that packet recorded already
+  float last_pts = -1;
+  bool failed = !buf;
+
+  while (!failed && pos < idx->end && !index_stopped(idx)) {
+    int r = pread(idx->fd, buf, INDEX_BLOCK_SIZE + INDEX_LOOKAHEAD, pos);
+    if (r < 0 && errno == EINTR)
+      continue;
+    if (r <= 0)
+      break;
+    // The lookahead bytes are processed with the next block.
+    int size = FFMIN(r, INDEX_BLOCK_SIZE);
+    for (int i = 0; i < size; i++) {
+      state = (state << 8) | buf[i];
+      if ((state & 0xFFFFFF00) != 0x100)
+        continue;
+      int code = buf[i];
+      int64_t code_pos = pos + i - 3;
+      if (code == 0xBA) {
+        pack_pos = code_pos;
+      } else if (code >= 0xBC) {
+        if (code_pos >= pes_end)
+          pes_end = -1;
+        if (code == 0xE0 + idx->video_id && i + INDEX_LOOKAHEAD <= r) {
+          pes_end = code_pos + 6 + AV_RB16(buf + i + 1);
+          pes_pts = index_pes_pts(buf + i);
+          pes_indexed = false;
+        }
+      } else if (code_pos < pes_end && !pes_indexed && pes_pts >= 0 &&
+                 pack_pos >= 0)
+      {
+        bool key = idx->mode == INDEX_H264 ? (code & 0x1F) == 5
+                                           : code == 0xB3 || code == 0xB8;
+        if (!key)
+          continue;
+        pes_indexed = true;
+        if (pes_pts < last_pts) {
+          // Timestamp reset; times can't be mapped to positions anymore.
+          mp_msg(MSGT_DEMUX, MSGL_V, "MPEG: timestamp discontinuity at "
+                 "0x%"PRIX64", not indexing.\n", code_pos);
+          failed = true;
+          break;
+        }
+        last_pts = pes_pts;
+        struct mpg_index_entry e = { .pos = pack_pos, .pts = pes_pts };
+        pthread_mutex_lock(&idx->lock);
+        MP_TARRAY_APPEND(NULL, idx->entries, idx->num_entries, e);
+        pthread_mutex_unlock(&idx->lock);
+      }
+    }
+    pos += size;
+  }
+  free(buf);
+
+  pthread_mutex_lock(&idx->lock);
+  if (failed) {
+    talloc_free(idx->entries);
+    idx->entries = NULL;
+    idx->num_entries = 0;
+  }
+  idx->complete = !failed && !idx->stop;
+  mp_msg(MSGT_DEMUX, MSGL_V, "MPEG: keyframe index %s, %d entries.\n",
+         idx->complete ? "complete" : "stopped", idx->num_entries);
+  pthread_mutex_unlock(&idx->lock);
+  return NULL;
+}
+
+static void index_start(demuxer_t *demuxer)
+{
+  mpg_demuxer_t *mpg_d = demuxer->priv;
+  sh_video_t *sh_video = demuxer->video->sh;
+  stream_t *s = demuxer->stream;
+  if (!demuxer->opts->mpg_index || !mpg_d || !sh_video ||
+      demuxer->video->id < 0 || !demuxer->seekable ||
+      s->type != STREAMTYPE_FILE || s->fd < 0 || s->end_pos <= 0)
+    return;
+  enum mpg_index_mode mode;
+  if (sh_video->format == VIDEO_H264)
+    mode = INDEX_H264;
+  else if (sh_video->format == VIDEO_MPEG4 ||
+           sh_video->format == mmioFOURCC('W', 'V', 'C', '1'))
+    return;
+  else
+    mode = INDEX_MPEG12;
+
+  struct mpg_index *idx = talloc_ptrtype(NULL, idx);
+  *idx = (struct mpg_index) {
+    .fd = s->fd,
+    .start = demuxer->movi_start,
+    .end = s->end_pos,
+    .video_id = demuxer->video->id,
+    .mode = mode,
+  };
+  pthread_mutex_init(&idx->lock, NULL);
+  if (pthread_create(&idx->thread, NULL, index_thread, idx)) {
+    pthread_mutex_destroy(&idx->lock);
+    talloc_free(idx);
+    return;
+  }
+  mp_msg(MSGT_DEMUX, MSGL_V, "MPEG: building keyframe index.\n");
+  mpg_d->index = idx;
+}
+
+static void index_stop(mpg_demuxer_t *mpg_d)
+{
+  struct mpg_index *idx = mpg_d->index;
+  if (!idx)
+    return;
+  pthread_mutex_lock(&idx->lock);
+  idx->stop = true;
+  pthread_mutex_unlock(&idx->lock);
+  pthread_join(idx->thread, NULL);
+  pthread_mutex_destroy(&idx->lock);
+  talloc_free(idx->entries);
+  talloc_free(idx);
+  mpg_d->index = NULL;
+}
+
+// Find the keyframe to seek to for the given PTS. Returns false if the index
+// doesn't cover it (yet).
+static bool index_lookup(mpg_demuxer_t *mpg_d, float pts, int flags,
+                         int64_t *pos)
+{
+  struct mpg_index *idx = mpg_d ? mpg_d->index : NULL;
+  if (!idx)
+    return false;
+  bool found = false;
+  pthread_mutex_lock(&idx->lock);
+  int num = idx->num_entries;
+  if (num && (idx->complete || pts <= idx->entries[num - 1].pts)) {
+    // Last entry with entry.pts <= pts
+    int lo = 0, hi = num;
+    while (lo < hi) {
+      int mid = lo + (hi - lo) / 2;
+      if (idx->entries[mid].pts <= pts)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+    int n = lo - 1;
+    if ((flags & SEEK_FORWARD) && (n < 0 || idx->entries[n].pts < pts))
+      n++;
+    n = FFMAX(FFMIN(n, num - 1), 0);
+    *pos = idx->entries[n].pos;
+    found = true;
+  }
+  pthread_mutex_unlock(&idx->lock);
+  return found;
+}
+#else
+static void index_start(demuxer_t *demuxer) {}
+static void index_stop(mpg_demuxer_t *mpg_d) {}
+static bool index_lookup(mpg_demuxer_t *mpg_d, float pts, int flags,
+                         int64_t *pos)
+{
+  return false;
+}
+#endif
+
 static void demux_seek_mpg(demuxer_t *demuxer, float rel_seek_secs,
                            float audio_delay, int flags)
 {
@@ -978,6 +1231,10 @@ static void demux_seek_mpg(demuxer_t *demuxer, float rel_seek_secs,
       newpts += rel_seek_secs;
     if (newpts < 0) newpts = 0;
 
+    if(!(flags & SEEK_FACTOR) && index_lookup(mpg_d, newpts, flags, &newpos)){
+	// keyframe position is known, no need to refine it
+	precision = 0;
+    } else
     if(flags&SEEK_FACTOR){
 	// float seek 0..1
 	newpos+=(demuxer->movi_end-demuxer->movi_start)*rel_seek_secs;
@@ -1172,12 +1429,12 @@ static demuxer_t* demux_mpg_ps_open(demuxer_t* demuxer)
     if(!sh_video->format && ps_probe > 0) {
         int head;
         int64_t pos = stream_tell(demuxer->stream);
+        struct mpg_stats st = {0};
 
-        clear_stats();
         do {
             head=sync_video_packet(demuxer->video);
             if(!head) break;
-            update_stats(head);
+            update_stats(&st, head);
             skip_video_packet(demuxer->video);
         } while(stream_tell(demuxer->stream) < pos + ps_probe && !demuxer->stream->eof);
 
@@ -1185,22 +1442,24 @@ static demuxer_t* demux_mpg_ps_open(demuxer_t* demuxer)
         demuxer->stream->eof=0;
         stream_seek(demuxer->stream, pos);
         mp_msg(MSGT_DEMUX,MSGL_INFO,"MPEG packet stats: p100: %d  p101: %d p1B6: %d p12x: %d sli: %d a: %d b: %d c: %d idr: %d sps: %d pps: %d\n",
-            num_elementary_packets100, num_elementary_packets101,
-            num_elementary_packets1B6, num_elementary_packets12x,
-            num_h264_slice, num_h264_dpa, num_h264_dpb, num_h264_dpc,
-            num_h264_idr, num_h264_sps, num_h264_pps);
+            st.num_elementary_packets100, st.num_elementary_packets101,
+            st.num_elementary_packets1B6, st.num_elementary_packets12x,
+            st.num_h264_slice, st.num_h264_dpa, st.num_h264_dpb, st.num_h264_dpc,
+            st.num_h264_idr, st.num_h264_sps, st.num_h264_pps);
 
-        if(num_elementary_packets1B6>3 && num_elementary_packets12x>=1 &&
-            num_elementary_packets100<=num_elementary_packets12x)
+        if(st.num_elementary_packets1B6>3 && st.num_elementary_packets12x>=1 &&
+            st.num_elementary_packets100<=st.num_elementary_packets12x)
             sh_video->format = 0x10000004;
-        else if((num_h264_slice>3 || (num_h264_dpa>3 && num_h264_dpb>3 && num_h264_dpc>3)) &&
-            num_h264_sps>=1 && num_h264_pps>=1 && num_h264_idr>=1 &&
-            num_elementary_packets1B6==0)
+        else if((st.num_h264_slice>3 || (st.num_h264_dpa>3 && st.num_h264_dpb>3 && st.num_h264_dpc>3)) &&
+            st.num_h264_sps>=1 && st.num_h264_pps>=1 && st.num_h264_idr>=1 &&
+            st.num_elementary_packets1B6==0)
                 sh_video->format = 0x10000005;
         else sh_video->format = 0x10000002;
         mp_set_video_codec_from_tag(sh_video);
     }
 
+    index_start(demuxer);
+
     return demuxer;
 }
 
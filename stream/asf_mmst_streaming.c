@@ -175,7 +175,7 @@ static void get_answer (int s)
   while (command == 0x1b) {
     int len;
 
-    len = recv (s, data, BUF_SIZE, 0) ;
+    len = network_recv (s, data, BUF_SIZE) ;
     if (!len) {
       mp_tmsg(MSGT_NETWORK,MSGL_ERR,"\nAlert! EOF\n");
       return;
@@ -195,7 +195,7 @@ static int get_data (int s, char *buf, size_t count)
 
   while (total < count) {
 
-    len = recv (s, &buf[total], count-total, 0);
+    len = network_recv (s, &buf[total], count-total);
 
     if (len<=0) {
       perror ("read error:");
@@ -574,7 +574,7 @@ int asf_mmst_streaming_start(stream_t *stream)
 // send_command(s, commandno ....)
   send_command (s, 1, 0, 0x0004000b, strlen(str)*2+2, data);
 
-  recv (s, data, BUF_SIZE, 0) ;
+  network_recv (s, data, BUF_SIZE) ;
 
   /*This sends details of the local machine IP address to a Funnel system at the server.
   * Also, the TCP or UDP transport selection is sent.
@@ -588,7 +588,7 @@ int asf_mmst_streaming_start(stream_t *stream)
   memset (data, 0, 8);
   send_command (s, 2, 0, 0, 24*2+10, data);
 
-  recv (s, data, BUF_SIZE, 0) ;
+  network_recv (s, data, BUF_SIZE) ;
 
   /* This command sends file path (at server) and file name request to the server.
   * 0x5 */
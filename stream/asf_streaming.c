@@ -726,7 +726,7 @@ static int asf_http_streaming_start( stream_t *stream, int *demuxer_type ) {
 		http_free( http_hdr );
 		http_hdr = http_new_header();
 		do {
-			i = recv( fd, buffer, BUFFER_SIZE, 0 );
+			i = network_recv( fd, buffer, BUFFER_SIZE );
 //printf("read: %d\n", i );
 			if( i<=0 ) {
 				perror("read");
@@ -68,7 +68,7 @@ static unsigned my_read(int fd, char *buffer, int len, streaming_ctrl_t *sc) {
   sc->buffer_pos += cp_len;
   pos += cp_len;
   while (pos < len) {
-    int ret = recv(fd, &buffer[pos], len - pos, 0);
+    int ret = network_recv(fd, &buffer[pos], len - pos);
     if (ret <= 0)
       break;
     pos += ret;
@@ -875,6 +875,7 @@ static int fixup_open(stream_t *stream,int seekable) {
 	{
 		stream->flags |= MP_STREAM_SEEK;
 		stream->seek = http_seek;
+		stream->close = http_close;
 	}
 	stream->streaming_ctrl->bandwidth = network_bandwidth;
 	if ((!is_icy && !is_ultravox) || scast_streaming_start(stream))
@@ -28,11 +28,17 @@
 #include <errno.h>
 #include <ctype.h>
 
+#include <libavutil/common.h>
+
 #include "config.h"
 #include "core/options.h"
 
 #include "core/mp_msg.h"
 
+#ifdef HAVE_PTHREADS
+#include <pthread.h>
+#endif
+
 #if HAVE_WINSOCK2_H
 #include <winsock2.h>
 #include <ws2tcpip.h>
@@ -54,6 +60,8 @@ char *network_username=NULL;
 char *network_password=NULL;
 int   network_bandwidth=0;
 int   network_cookies_enabled = 0;
+float network_timeout = 10;
+float network_connect_timeout = 15;
 char *network_useragent="MPlayer 1.1-4.7";
 char *network_referrer=NULL;
 char **network_http_header_fields=NULL;
@@ -169,12 +177,18 @@ URL_t *url_new_with_proxy(const char *urlstr)
 	return url_with_proxy;
 }
 
-int
-http_send_request( URL_t *url, int64_t pos ) {
+// Send a GET request for the data starting at pos. If end is larger than pos,
+// only the bytes up to (but excluding) end are requested. With keep_alive set
+// the request is sent as HTTP/1.1 asking the server to keep the connection
+// open. If fd is valid the request is written to that connection, otherwise a
+// new one is opened. Returns the socket, or -1 on error (a passed fd is not
+// closed on failure).
+static int
+http_send_range( URL_t *url, int64_t pos, int64_t end, int keep_alive, int fd ) {
 	HTTP_header_t *http_hdr;
 	URL_t *server_url;
 	char str[256];
-	int fd = -1;
+	int own_fd = -1;
 	int ret;
 	int proxy = 0;		// Boolean
 
@@ -226,7 +240,10 @@ http_send_request( URL_t *url, int64_t pos ) {
 	if( strcasecmp(url->protocol, "noicyx") )
 	    http_set_field(http_hdr, "Icy-MetaData: 1");
 
-	if(pos>0) {
+	if(end>pos) {
+	    snprintf(str, sizeof(str), "Range: bytes=%"PRId64"-%"PRId64, pos, end - 1);
+	    http_set_field(http_hdr, str);
+	} else if(pos>0) {
 	// Extend http_send_request with possibility to do partial content retrieval
 	    snprintf(str, sizeof(str), "Range: bytes=%"PRId64"-", (int64_t)pos);
 	    http_set_field(http_hdr, str);
@@ -240,7 +257,12 @@ http_send_request( URL_t *url, int64_t pos ) {
 			http_set_field(http_hdr, network_http_header_fields[i++]);
 	}
 
-	http_set_field( http_hdr, "Connection: close");
+	if (keep_alive) {
+		http_hdr->http_minor_version = 1;
+		http_set_field( http_hdr, "Connection: keep-alive");
+	} else {
+		http_set_field( http_hdr, "Connection: close");
+	}
 	if (proxy)
 		http_add_basic_proxy_authentication(http_hdr, url->username, url->password);
 	http_add_basic_authentication(http_hdr, server_url->username, server_url->password);
@@ -250,12 +272,14 @@ http_send_request( URL_t *url, int64_t pos ) {
 
 	if( proxy ) {
 		if( url->port==0 ) url->port = 8080;			// Default port for the proxy server
-		fd = connect2Server( url->hostname, url->port,1 );
+		if( fd<0 )
+			fd = own_fd = connect2Server( url->hostname, url->port,1 );
 		url_free( server_url );
 		server_url = NULL;
 	} else {
 		if( server_url->port==0 ) server_url->port = 80;	// Default port for the web server
-		fd = connect2Server( server_url->hostname, server_url->port,1 );
+		if( fd<0 )
+			fd = own_fd = connect2Server( server_url->hostname, server_url->port,1 );
 	}
 	if( fd<0 ) {
 		goto err_out;
@@ -272,13 +296,18 @@ http_send_request( URL_t *url, int64_t pos ) {
 
 	return fd;
 err_out:
-	if (fd > 0) closesocket(fd);
+	if (own_fd > 0) closesocket(own_fd);
 	http_free(http_hdr);
 	if (proxy && server_url)
 		url_free(server_url);
 	return -1;
 }
 
+int
+http_send_request( URL_t *url, int64_t pos ) {
+	return http_send_range( url, pos, -1, 0, -1 );
+}
+
 HTTP_header_t *
 http_read_response( int fd ) {
 	HTTP_header_t *http_hdr;
@@ -291,7 +320,7 @@ http_read_response( int fd ) {
 	}
 
 	do {
-		i = recv( fd, response, BUFFER_SIZE, 0 );
+		i = network_recv( fd, response, BUFFER_SIZE );
 		if( i<0 ) {
 			mp_tmsg(MSGT_NETWORK,MSGL_ERR,"Read failed.\n");
 			http_free( http_hdr );
@@ -364,52 +393,515 @@ http_authenticate(HTTP_header_t *http_hdr, URL_t *url, int *auth_retry) {
 	return 0;
 }
 
-int
-http_seek( stream_t *stream, int64_t pos ) {
-	HTTP_header_t *http_hdr = NULL;
+/* Seekable HTTP streams.
+ *
+ * The first request of a stream is the plain one sent when opening it. Once
+ * the stream is seeked, data is fetched with HTTP/1.1 Range requests on a
+ * keep-alive connection instead. A seek then reuses the socket: short forward
+ * seeks skip data that is already on its way, and the rest of a response that
+ * is nearly done is drained instead of reconnecting. The request for the
+ * next chunk is pipelined while the current one is still being read, and
+ * chunks grow as long as the stream is read linearly. When the stream is
+ * closed, an idle connection is put into a small per-server pool so that the
+ * next stream opened on the same server can use it.
+ */
+
+#define HTTP_POOL_SIZE 4
+#define HTTP_CHUNK_MIN (64 * 1024)
+#define HTTP_CHUNK_MAX (4 * 1024 * 1024)
+#define HTTP_DRAIN_MAX (64 * 1024)	// skip/drain this much instead of reconnecting
+
+typedef struct http_range {
+	stream_t *stream;
 	int fd;
-	if( stream==NULL ) return 0;
+	int64_t pos;		// stream position of the next body byte on the socket
+	int64_t start;		// start of the current response body
+	int64_t end;		// end of the current response body, -1 if unbounded
+	int64_t next;		// start of the pipelined request, -1 if none
+	int64_t next_end;
+	int64_t total;		// file size, -1 if unknown
+	int64_t chunk;		// size of the next request
+	int keep_alive;		// connection stays open after the current response
+	int no_keep_alive;	// server can't do it, use unbounded HTTP/1.0 requests
+	int broken;		// connection state unknown after an error
+	int skipping;		// don't pipeline while draining
+	pid_t pid;		// process that did the last I/O on the connection
+} http_range_t;
+
+struct http_pool_entry {
+	char *host;
+	int port;
+	int fd;
+	unsigned int age;
+};
 
-	if( stream->fd>0 ) closesocket(stream->fd); // need to reconnect to seek in http-stream
-	fd = http_send_request( stream->streaming_ctrl->url, pos );
-	if( fd<0 ) return 0;
+static struct http_pool_entry http_pool[HTTP_POOL_SIZE];
+static unsigned int http_pool_age;
+
+#ifdef HAVE_PTHREADS
+// The cache thread of each stream does its own network I/O.
+static pthread_mutex_t http_pool_mutex = PTHREAD_MUTEX_INITIALIZER;
+static void http_pool_lock(void)   { pthread_mutex_lock(&http_pool_mutex); }
+static void http_pool_unlock(void) { pthread_mutex_unlock(&http_pool_mutex); }
+#else
+static void http_pool_lock(void)   {}
+static void http_pool_unlock(void) {}
+#endif
 
-	http_hdr = http_read_response( fd );
+// The server the connection for url goes to (the proxy if one is used).
+static void
+http_server_address( URL_t *url, char **host, int *port ) {
+	*host = url->hostname;
+	*port = url->port;
+	if( *port==0 )
+		*port = strcasecmp(url->protocol, "mp_http_proxy") ? 80 : 8080;
+}
+
+// An idle keep-alive connection has nothing to read. If it is readable, the
+// server either closed it or sent something we didn't ask for.
+static int
+http_conn_idle( int fd ) {
+	struct timeval tv = {0, 0};
+	fd_set set;
+	FD_ZERO(&set);
+	FD_SET(fd, &set);
+	return select(fd + 1, &set, NULL, NULL, &tv) == 0;
+}
 
-	if( http_hdr==NULL ) return 0;
+static int
+http_pool_get( const char *host, int port ) {
+	int fd = -1;
+	http_pool_lock();
+	for (int i = 0; i < HTTP_POOL_SIZE && fd < 0; i++) {
+		struct http_pool_entry *e = &http_pool[i];
+		if (!e->host || e->port != port || strcasecmp(e->host, host))
+			continue;
+		fd = e->fd;
+		free(e->host);
+		e->host = NULL;
+		if (!http_conn_idle(fd)) {
+			closesocket(fd);
+			fd = -1;
+		}
+	}
+	http_pool_unlock();
+	if (fd >= 0)
+		mp_msg(MSGT_NETWORK, MSGL_V, "Reusing connection to %s:%d\n", host, port);
+	return fd;
+}
+
+static void
+http_pool_put( const char *host, int port, int fd ) {
+	http_pool_lock();
+	struct http_pool_entry *e = &http_pool[0];
+	for (int i = 0; i < HTTP_POOL_SIZE; i++) {
+		if (!http_pool[i].host) {
+			e = &http_pool[i];
+			break;
+		}
+		if (http_pool[i].age < e->age)
+			e = &http_pool[i];
+	}
+	if (e->host) {
+		closesocket(e->fd);
+		free(e->host);
+	}
+	e->host = strdup(host);
+	e->port = port;
+	e->fd = fd;
+	e->age = ++http_pool_age;
+	if (!e->host)
+		closesocket(fd);
+	http_pool_unlock();
+}
+
+static void
+http_drop_buffer( streaming_ctrl_t *ctrl ) {
+	free(ctrl->buffer);
+	ctrl->buffer = NULL;
+	ctrl->buffer_size = 0;
+	ctrl->buffer_pos = 0;
+}
+
+static void
+http_range_close( http_range_t *r ) {
+	if (r->fd >= 0)
+		closesocket(r->fd);
+	r->fd = -1;
+	r->stream->fd = -1;
+	r->keep_alive = 0;
+	r->broken = 0;
+	r->end = r->next = -1;
+	http_drop_buffer(r->stream->streaming_ctrl);
+}
+
+// Read data from the connection. Bytes received together with the last
+// response header are returned first.
+static int
+http_range_recv( http_range_t *r, char *buf, int size ) {
+	streaming_ctrl_t *ctrl = r->stream->streaming_ctrl;
+	if (ctrl->buffer_size) {
+		int len = FFMIN(size, (int)(ctrl->buffer_size - ctrl->buffer_pos));
+		memcpy(buf, ctrl->buffer + ctrl->buffer_pos, len);
+		ctrl->buffer_pos += len;
+		if (ctrl->buffer_pos >= ctrl->buffer_size)
+			http_drop_buffer(ctrl);
+		return len;
+	}
+	return network_recv(r->fd, buf, size);
+}
+
+static HTTP_header_t *
+http_range_read_header( http_range_t *r ) {
+	streaming_ctrl_t *ctrl = r->stream->streaming_ctrl;
+	HTTP_header_t *http_hdr = http_new_header();
+	char buf[BUFFER_SIZE];
+
+	if (!http_hdr)
+		return NULL;
+	// With pipelining, the start of this header may already be buffered.
+	if (ctrl->buffer_size) {
+		http_response_append(http_hdr, ctrl->buffer + ctrl->buffer_pos,
+				     ctrl->buffer_size - ctrl->buffer_pos);
+		http_drop_buffer(ctrl);
+	}
+	while (!http_is_header_entire(http_hdr)) {
+		int len = network_recv(r->fd, buf, sizeof(buf));
+		if (len <= 0) {
+			http_free(http_hdr);
+			return NULL;
+		}
+		http_response_append(http_hdr, buf, len);
+	}
+	if (http_response_parse(http_hdr) < 0 ||
+	    (http_hdr->body_size > 0 &&
+	     streaming_bufferize(ctrl, http_hdr->body, http_hdr->body_size) < 0))
+	{
+		http_free(http_hdr);
+		return NULL;
+	}
+	return http_hdr;
+}
+
+// Read the response header for a request of data starting at pos.
+static int
+http_range_response( http_range_t *r, int64_t pos ) {
+	HTTP_header_t *http_hdr = http_range_read_header(r);
+	int64_t start = 0, last = -1, total = -1;
+	char *field;
+	int res = -1;
+
+	if (!http_hdr)
+		return -1;
+	if (mp_msg_test(MSGT_NETWORK, MSGL_DBG2))
+		http_debug_hdr(http_hdr);
+
+	field = http_get_field(http_hdr, "Transfer-Encoding");
+	if (field && strcasecmp(field, "identity")) {
+		mp_msg(MSGT_NETWORK, MSGL_V, "Server uses %s transfer encoding, "
+		       "disabling keep-alive.\n", field);
+		r->no_keep_alive = 1;
+		goto out;
+	}
+	switch (http_hdr->status_code) {
+	case 206:
+		field = http_get_field(http_hdr, "Content-Range");
+		if (!field || sscanf(field, "bytes %"SCNd64"-%"SCNd64"/%"SCNd64,
+				     &start, &last, &total) < 2)
+		{
+			mp_msg(MSGT_NETWORK, MSGL_ERR, "Invalid Content-Range: %s\n",
+			       field ? field : "(none)");
+			goto out;
+		}
+		break;
+	case 200:
+		if (pos == 0) {
+			field = http_get_field(http_hdr, "Content-Length");
+			if (field)
+				last = strtoll(field, NULL, 10) - 1;
+			break;
+		}
+		// fall through: the server ignored the Range header
+	default:
+		mp_tmsg(MSGT_NETWORK,MSGL_ERR,"Server returns %d: %s\n", http_hdr->status_code, http_hdr->reason_phrase );
+		goto out;
+	}
+	if (start != pos) {
+		mp_msg(MSGT_NETWORK, MSGL_ERR, "Server returned data at %"PRId64
+		       " instead of %"PRId64".\n", start, pos);
+		goto out;
+	}
 
-	if( mp_msg_test(MSGT_NETWORK,MSGL_V) )
-		http_debug_hdr( http_hdr );
+	r->pos = r->start = pos;
+	r->end = last >= 0 ? last + 1 : -1;
+	if (total >= 0)
+		r->total = total;
+	field = http_get_field(http_hdr, "Connection");
+	if (field)
+		r->keep_alive = strcasecmp(field, "close") != 0;
+	else
+		r->keep_alive = http_hdr->http_minor_version >= 1;
+	// Without a known length, the response ends when the connection does.
+	if (r->end < 0)
+		r->keep_alive = 0;
+	if (!r->keep_alive && !r->no_keep_alive) {
+		mp_msg(MSGT_NETWORK, MSGL_V, "Server closes connections, "
+		       "disabling keep-alive.\n");
+		r->no_keep_alive = 1;
+	}
+	r->broken = 0;
+	r->pid = getpid();
+	res = 0;
+out:
+	http_free(http_hdr);
+	return res;
+}
 
-	switch( http_hdr->status_code ) {
-		case 200:
-		case 206: // OK
-			mp_msg(MSGT_NETWORK,MSGL_V,"Content-Type: [%s]\n", http_get_field(http_hdr, "Content-Type") );
-			mp_msg(MSGT_NETWORK,MSGL_V,"Content-Length: [%s]\n", http_get_field(http_hdr, "Content-Length") );
-			if( http_hdr->body_size>0 ) {
-				if( streaming_bufferize( stream->streaming_ctrl, http_hdr->body, http_hdr->body_size )<0 ) {
-					http_free( http_hdr );
-					return -1;
-				}
+// Request data starting at pos. The current connection is used if it is
+// idle, otherwise a pooled or a new one.
+static int
+http_range_request( http_range_t *r, int64_t pos ) {
+	URL_t *url = r->stream->streaming_ctrl->url;
+	char *host;
+	int port;
+
+	http_server_address(url, &host, &port);
+	for (int attempt = 0; attempt < 3; attempt++) {
+		int keep_alive = !r->no_keep_alive;
+		int64_t end = -1;
+		int reused;
+
+		if (r->fd >= 0 && (!r->keep_alive || r->broken || r->next >= 0 ||
+				   r->pos != r->end))
+			http_range_close(r);
+		if (r->fd < 0 && keep_alive && attempt == 0)
+			r->fd = http_pool_get(host, port);
+		reused = r->fd >= 0;
+
+		if (keep_alive) {
+			end = pos + r->chunk;
+			if (r->total >= 0 && end > r->total)
+				end = r->total;
+		}
+		mp_msg(MSGT_NETWORK, MSGL_DBG2, "HTTP request %"PRId64"-%"PRId64
+		       " (%s connection)\n", pos, end, reused ? "reused" : "new");
+		int fd = http_send_range(url, pos, end, keep_alive, r->fd);
+		if (fd >= 0) {
+			r->fd = r->stream->fd = fd;
+			if (http_range_response(r, pos) == 0) {
+				r->chunk = FFMIN(r->chunk * 2, HTTP_CHUNK_MAX);
+				return 0;
 			}
+		}
+		http_range_close(r);
+		// Retry if an idle connection was closed by the server in the
+		// meantime, or if keep-alive has just been disabled.
+		if (!reused && keep_alive == !r->no_keep_alive)
 			break;
-		default:
-			mp_tmsg(MSGT_NETWORK,MSGL_ERR,"Server returns %d: %s\n", http_hdr->status_code, http_hdr->reason_phrase );
-			closesocket( fd );
-			fd = -1;
 	}
-	stream->fd = fd;
+	return -1;
+}
+
+// Queue the request for the next chunk behind the current one, so that its
+// data follows without waiting for a round trip.
+static void
+http_range_pipeline( http_range_t *r ) {
+	int64_t end;
+
+	if (!r->keep_alive || r->broken || r->skipping || r->next >= 0 ||
+	    r->end < 0 || (r->total >= 0 && r->end >= r->total) ||
+	    r->pos - r->start < (r->end - r->start) / 2)
+		return;
+	end = r->end + r->chunk;
+	if (r->total >= 0 && end > r->total)
+		end = r->total;
+	if (http_send_range(r->stream->streaming_ctrl->url, r->end, end, 1, r->fd) < 0) {
+		// the current response can still be read, but not reuse the socket
+		r->keep_alive = 0;
+		return;
+	}
+	r->next = r->end;
+	r->next_end = end;
+	r->chunk = FFMIN(r->chunk * 2, HTTP_CHUNK_MAX);
+}
 
-	if( http_hdr ) {
-		http_free( http_hdr );
-		stream->streaming_ctrl->data = NULL;
+static int
+http_range_read( int fd, char *buffer, int size, streaming_ctrl_t *ctrl ) {
+	http_range_t *r = ctrl->data;
+	int len;
+
+	if (r->broken)
+		return 0;
+	if (r->fd < 0 || r->pos == r->end) {
+		int res = -1;
+		if (r->total >= 0 && r->pos >= r->total) {
+			ctrl->status = streaming_stopped_e;
+			return 0;
+		}
+		if (r->fd >= 0 && r->next == r->pos) {
+			r->next = -1;
+			res = http_range_response(r, r->pos);
+		}
+		if (res < 0)
+			res = http_range_request(r, r->pos);
+		if (res < 0) {
+			r->broken = 1;
+			return 0;
+		}
 	}
 
-	stream->pos=pos;
+	if (r->end >= 0 && size > r->end - r->pos)
+		size = r->end - r->pos;
+	len = http_range_recv(r, buffer, size);
+	if (len < 0) {
+		if (errno != EINTR)
+			mp_msg(MSGT_NETWORK,MSGL_ERR,"http_range_read error : %s\n",strerror(errno));
+		r->broken = 1;
+		return 0;
+	}
+	if (len == 0) {
+		if (r->end < 0) {
+			ctrl->status = streaming_stopped_e;
+			http_range_close(r);
+			r->total = r->pos;
+		} else {
+			r->broken = 1;
+		}
+		return 0;
+	}
+	r->pos += len;
+	r->pid = getpid();
+	http_range_pipeline(r);
+	return len;
+}
 
+// Read and discard size bytes from the connection.
+static int
+http_range_skip( http_range_t *r, int64_t size ) {
+	streaming_ctrl_t *ctrl = r->stream->streaming_ctrl;
+	char buf[16 * 1024];
+
+	r->skipping = 1;
+	while (size > 0) {
+		int len = http_range_read(r->fd, buf, FFMIN(size, sizeof(buf)), ctrl);
+		if (len <= 0)
+			break;
+		size -= len;
+	}
+	r->skipping = 0;
+	return size > 0 ? -1 : 0;
+}
+
+static http_range_t *
+http_range_get( stream_t *stream ) {
+	streaming_ctrl_t *ctrl = stream->streaming_ctrl;
+	http_range_t *r = ctrl->data;
+
+	if (!r) {
+		// Take over the connection the stream was opened with.
+		r = calloc(1, sizeof(*r));
+		if (!r)
+			return NULL;
+		r->fd = stream->fd;
+		r->pos = r->start = stream->pos;
+		r->end = r->next = r->next_end = -1;
+		r->total = stream->end_pos > 0 ? stream->end_pos : -1;
+		r->chunk = HTTP_CHUNK_MIN;
+		ctrl->data = r;
+		ctrl->streaming_read = http_range_read;
+	}
+	r->stream = stream;
+	return r;
+}
+
+int
+http_seek( stream_t *stream, int64_t pos ) {
+	http_range_t *r;
+	int64_t left;
+
+	if( stream==NULL ) return 0;
+	r = http_range_get(stream);
+	if (!r)
+		return 0;
+	stream->streaming_ctrl->status = streaming_playing_e;
+
+	// Skip forward if the data is already on its way.
+	if (r->fd >= 0 && !r->broken && pos >= r->pos &&
+	    pos - r->pos <= HTTP_DRAIN_MAX &&
+	    (r->end < 0 || pos < r->end || (r->next == r->end && pos < r->next_end)) &&
+	    http_range_skip(r, pos - r->pos) == 0)
+	{
+		stream->pos = pos;
+		return 1;
+	}
+
+	// Finish reading what's still in flight if that's cheaper than a new
+	// connection.
+	if (r->fd >= 0 && r->keep_alive && !r->broken && r->end >= 0) {
+		left = r->end - r->pos;
+		if (r->next >= 0)
+			left += r->next_end - r->next;
+		if (left > 0 && left <= HTTP_DRAIN_MAX)
+			http_range_skip(r, left);
+	}
+
+	r->chunk = HTTP_CHUNK_MIN;
+	if (http_range_request(r, pos) < 0) {
+		r->broken = 1;
+		return 0;
+	}
+	stream->pos = pos;
 	return 1;
 }
 
+void
+http_close( stream_t *stream ) {
+	streaming_ctrl_t *ctrl = stream->streaming_ctrl;
+	http_range_t *r = ctrl ? ctrl->data : NULL;
+	char *host;
+	int port;
+
+	if (!r || r->fd < 0)
+		return;
+	// With a forked cache, this process might not be the one that used the
+	// connection last, so its state would be stale.
+	if (r->keep_alive && !r->broken && r->pos == r->end && r->next < 0 &&
+	    r->pid == getpid() && !ctrl->buffer_size && http_conn_idle(r->fd))
+	{
+		http_server_address(ctrl->url, &host, &port);
+		http_pool_put(host, port, r->fd);
+	} else {
+		closesocket(r->fd);
+	}
+	r->fd = -1;
+	stream->fd = -1;
+}
+
+/* recv() that waits at most network_timeout seconds for data, and returns
+ * early with errno set to EINTR if the user aborts. */
+int
+network_recv( int fd, void *buf, int size ) {
+	while (1) {
+		int res = stream_wait_fd(fd, false, network_timeout * 1000);
+		if (res < 0) {
+			errno = EINTR;
+			return -1;
+		}
+		if (res == 0) {
+			mp_tmsg(MSGT_NETWORK,MSGL_ERR,"Network read timeout.\n");
+			errno = ETIMEDOUT;
+			return -1;
+		}
+#ifdef MSG_DONTWAIT
+		res = recv(fd, buf, size, MSG_DONTWAIT);
+		if (res < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+			continue;
+		return res;
+#else
+		return recv(fd, buf, size, 0);
+#endif
+	}
+}
 
 int
 streaming_bufferize( streaming_ctrl_t *streaming_ctrl, char *buffer, int size) {
@@ -447,9 +939,10 @@ nop_streaming_read( int fd, char *buffer, int size, streaming_ctrl_t *stream_ctr
 
 	if( len<size ) {
 		int ret;
-		ret = recv( fd, buffer+len, size-len, 0 );
+		ret = network_recv( fd, buffer+len, size-len );
 		if( ret<0 ) {
-			mp_msg(MSGT_NETWORK,MSGL_ERR,"nop_streaming_read error : %s\n",strerror(errno));
+			if (errno != EINTR)
+				mp_msg(MSGT_NETWORK,MSGL_ERR,"nop_streaming_read error : %s\n",strerror(errno));
 			ret = 0;
 		} else if (ret == 0)
 			stream_ctrl->status = streaming_stopped_e;
@@ -69,6 +69,8 @@ extern int   network_bandwidth;
 extern char *network_useragent;
 extern char *network_referrer;
 extern int   network_cookies_enabled;
+extern float network_timeout;
+extern float network_connect_timeout;
 extern char *cookies_file;
 
 extern int network_prefer_ipv4;
@@ -78,6 +80,7 @@ extern int reuse_socket;
 streaming_ctrl_t *streaming_ctrl_new(void);
 int streaming_bufferize( streaming_ctrl_t *streaming_ctrl, char *buffer, int size);
 
+int network_recv( int fd, void *buf, int size );
 int nop_streaming_read( int fd, char *buffer, int size, streaming_ctrl_t *stream_ctrl );
 int nop_streaming_seek( int fd, int64_t pos, streaming_ctrl_t *stream_ctrl );
 void streaming_ctrl_free( streaming_ctrl_t *streaming_ctrl );
@@ -90,5 +93,6 @@ URL_t* check4proxies(const URL_t *url);
 URL_t *url_new_with_proxy(const char *urlstr);
 
 int http_seek(stream_t *stream, int64_t pos);
+void http_close(stream_t *stream);
 
 #endif /* MPLAYER_NETWORK_H */
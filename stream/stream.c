@@ -19,12 +19,14 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <errno.h>
 
 #include <sys/types.h>
 #include <sys/stat.h>
 #ifndef __MINGW32__
 #include <sys/ioctl.h>
 #include <sys/wait.h>
+#include <sys/select.h>
 #endif
 #include <fcntl.h>
 #include <strings.h>
@@ -37,6 +39,10 @@
 
 #include "config.h"
 
+#ifdef HAVE_PTHREADS
+#include <pthread.h>
+#endif
+
 #if HAVE_WINSOCK2_H
 #include <winsock2.h>
 #endif
@@ -62,7 +68,17 @@ int dvd_title = 0;
 
 struct input_ctx;
 static int (*stream_check_interrupt_cb)(struct input_ctx *ctx, int time);
+static int (*stream_wait_fd_cb)(struct input_ctx *ctx, int fd, bool for_write,
+                                int time);
 static struct input_ctx *stream_check_interrupt_ctx;
+// The input context can be used only by the thread that set the callbacks.
+static pid_t stream_interrupt_pid;
+#ifdef HAVE_PTHREADS
+static pthread_t stream_interrupt_thread;
+#endif
+// Set to abort blocking operations in other threads (see
+// stream_set_background_interrupt()).
+static volatile bool stream_background_interrupt;
 
 extern const stream_info_t stream_info_vcd;
 extern const stream_info_t stream_info_cdda;
@@ -293,12 +309,13 @@ static int stream_reconnect(stream_t *s)
         return 0;
     int64_t pos = s->pos;
     for (int retry = 0; retry < MAX_RECONNECT_RETRIES; retry++) {
+        // Stop retrying if the user wants to do something else.
+        if (stream_check_interrupt(retry ? RECONNECT_SLEEP_MS : 0))
+            return 0;
+
         mp_msg(MSGT_STREAM, MSGL_WARN,
                "Connection lost! Attempting to reconnect...\n");
 
-        if (retry)
-            mp_sleep_us(RECONNECT_SLEEP_MS * 1000);
-
         s->eof = 1;
         stream_reset(s);
 
@@ -393,8 +410,133 @@ eof_out:
     return len;
 }
 
+/* While probing, everything read from the start of the stream is kept in a
+ * buffer, so that the format checks of all demuxers can re-read it without
+ * seeking back and re-reading the underlying stream. The underlying stream
+ * is always positioned right after the buffered data. Once probing stops,
+ * the buffered data is still used for re-reads, until the first access
+ * outside of it.
+ */
+#define STREAM_PROBE_READ_SIZE (32 * 1024)
+
+struct stream_probe {
+    unsigned char *buf;
+    int len, max_len;
+    int64_t start;
+    bool eof;       // underlying stream ended inside of the buffer
+    bool active;    // probing; read more data into the buffer if needed
+};
+
+void stream_probe_start(stream_t *s, int max_size)
+{
+    if (s->probe) {
+        s->probe->active = true;
+        return;
+    }
+    // The cache already avoids re-reading; sector based streams may need
+    // special seeking.
+    if (max_size <= 0 || s->cache_pid || s->sector_size ||
+        (s->type != STREAMTYPE_FILE && s->type != STREAMTYPE_STREAM) ||
+        s->mode != STREAM_READ)
+        return;
+    stream_seek(s, s->start_pos);
+    if (stream_tell(s) != s->start_pos)
+        return;
+    s->probe = talloc_ptrtype(s, s->probe);
+    *s->probe = (struct stream_probe) {
+        .max_len = max_size,
+        .start = s->pos,
+        .active = true,
+    };
+    // Make the data already in s->buffer part of the probe buffer.
+    if (s->buf_len) {
+        s->probe->start -= s->buf_len;
+        s->probe->buf = talloc_memdup(s->probe, s->buffer, s->buf_len);
+        s->probe->len = s->buf_len;
+    }
+}
+
+void stream_probe_stop(stream_t *s)
+{
+    if (s->probe)
+        s->probe->active = false;
+}
+
+static void stream_probe_drop(stream_t *s)
+{
+    struct stream_probe *p = s->probe;
+    mp_msg(MSGT_STREAM, MSGL_DBG2, "stream: dropping %d bytes probe buffer\n",
+           p->len);
+    s->pos = p->start + p->len;
+    if (p->eof)
+        s->eof = 1;
+    talloc_free(p);
+    s->probe = NULL;
+}
+
+// Read more data into the probe buffer, until the given position is covered.
+static void stream_probe_extend(stream_t *s, int64_t pos)
+{
+    struct stream_probe *p = s->probe;
+    while (p->active && !p->eof && pos >= p->start + p->len &&
+           p->len < p->max_len)
+    {
+        int size = FFMIN(STREAM_PROBE_READ_SIZE, p->max_len - p->len);
+        p->buf = talloc_realloc_size(p, p->buf, p->len + size);
+        int64_t old_pos = s->pos;
+        s->pos = p->start + p->len;
+        int len = stream_read_internal(s, p->buf + p->len, size);
+        s->pos = old_pos;
+        if (len <= 0) {
+            p->eof = true;
+            break;
+        }
+        p->len += len;
+    }
+}
+
+// Whether the (logical) position can be accessed without leaving the buffer.
+static bool stream_probe_contains(stream_t *s, int64_t pos)
+{
+    struct stream_probe *p = s->probe;
+    stream_probe_extend(s, pos);
+    return pos >= p->start && (pos < p->start + p->len ||
+                               (pos == p->start + p->len && p->eof));
+}
+
+// Fill s->buffer from the probe buffer, or from the stream if the position
+// is outside of it. Like stream_fill_buffer(), returns the number of bytes
+// now buffered, and 0 at EOF.
+static int stream_probe_fill(stream_t *s)
+{
+    struct stream_probe *p = s->probe;
+    int64_t pos = s->pos;
+    if (!stream_probe_contains(s, pos)) {
+        stream_probe_drop(s);
+        // Normally we continue reading right after the buffered data.
+        // stream_seek_internal() returns -1 if the stream is at pos now.
+        if (s->pos != pos && stream_seek_internal(s, pos) != -1)
+            return 0;
+        return stream_fill_buffer(s);
+    }
+    int64_t offset = pos - p->start;
+    int len = FFMIN(p->len - offset, STREAM_BUFFER_SIZE);
+    if (len <= 0) {
+        s->eof = 1;
+        return 0;
+    }
+    memcpy(s->buffer, p->buf + offset, len);
+    s->pos += len;
+    s->buf_pos = 0;
+    s->buf_len = len;
+    s->eof = 0;
+    return len;
+}
+
 int stream_fill_buffer(stream_t *s)
 {
+    if (s->probe)
+        return stream_probe_fill(s);
     int len = stream_read_internal(s, s->buffer, STREAM_BUFFER_SIZE);
     if (len <= 0)
         return 0;
@@ -405,12 +547,28 @@ int stream_fill_buffer(stream_t *s)
     return len;
 }
 
+// Whether large reads can skip s->buffer and go to the destination directly.
+static bool stream_can_read_direct(stream_t *s)
+{
+    return s->type == STREAMTYPE_FILE && !s->cache_pid && !s->probe &&
+           !s->capture_file && !s->sector_size;
+}
+
 int stream_read(stream_t *s, char *mem, int total)
 {
     int len = total;
     while (len > 0) {
         int x;
         x = s->buf_len - s->buf_pos;
+        if (x == 0 && len >= STREAM_BUFFER_SIZE && stream_can_read_direct(s)) {
+            s->buf_pos = s->buf_len = 0;
+            x = stream_read_internal(s, mem, len);
+            if (x <= 0)
+                return total - len;                      // EOF
+            mem += x;
+            len -= x;
+            continue;
+        }
         if (x == 0) {
             if (!cache_stream_fill_buffer(s))
                 return total - len;                      // EOF
@@ -522,7 +680,14 @@ int stream_seek_long(stream_t *s, int64_t pos)
     }
     pos -= newpos;
 
-    res = stream_seek_internal(s, newpos);
+    if (s->probe && !stream_probe_contains(s, newpos))
+        stream_probe_drop(s);
+    if (s->probe) {
+        s->pos = newpos;
+        res = -1;
+    } else {
+        res = stream_seek_internal(s, newpos);
+    }
     if (res >= 0)
         return res;
 
@@ -671,17 +836,78 @@ void free_stream(stream_t *s)
 }
 
 void stream_set_interrupt_callback(int (*cb)(struct input_ctx *, int),
+                                   int (*wait_cb)(struct input_ctx *, int,
+                                                  bool, int),
                                    struct input_ctx *ctx)
 {
     stream_check_interrupt_cb = cb;
+    stream_wait_fd_cb = wait_cb;
     stream_check_interrupt_ctx = ctx;
+    stream_interrupt_pid = getpid();
+#ifdef HAVE_PTHREADS
+    stream_interrupt_thread = pthread_self();
+#endif
+}
+
+static bool stream_in_input_thread(void)
+{
+    if (getpid() != stream_interrupt_pid)
+        return false;
+#ifdef HAVE_PTHREADS
+    if (!pthread_equal(pthread_self(), stream_interrupt_thread))
+        return false;
+#endif
+    return true;
+}
+
+void stream_set_background_interrupt(bool interrupt)
+{
+    stream_background_interrupt = interrupt;
+}
+
+bool stream_background_interrupted(void)
+{
+    return stream_background_interrupt && !stream_in_input_thread();
+}
+
+int stream_wait_fd(int fd, bool for_write, int timeout)
+{
+    int64_t deadline = mp_time_us() + timeout * (int64_t)1000;
+    while (1) {
+        int left = FFMAX(deadline - mp_time_us(), 0) / 1000;
+        int res;
+        if (stream_wait_fd_cb && stream_in_input_thread()) {
+            res = stream_wait_fd_cb(stream_check_interrupt_ctx, fd, for_write,
+                                    left);
+        } else {
+            if (stream_background_interrupt)
+                return -1;
+            // Wake up regularly to check for interruption
+            int wait = FFMIN(left, 100);
+            struct timeval tv = { wait / 1000, (wait % 1000) * 1000 };
+            fd_set set;
+            FD_ZERO(&set);
+            FD_SET(fd, &set);
+            res = select(fd + 1, for_write ? NULL : &set,
+                         for_write ? &set : NULL, NULL, &tv);
+            // Let the caller run into the error.
+            if (res < 0 && errno != EINTR)
+                return 1;
+            res = res > 0;
+        }
+        if (res)
+            return res;
+        if (left <= 0)
+            return 0;
+    }
 }
 
 int stream_check_interrupt(int time)
 {
-    if (!stream_check_interrupt_cb) {
-        mp_sleep_us(time * 1000);
-        return 0;
+    if (!stream_check_interrupt_cb || !stream_in_input_thread()) {
+        if (!stream_background_interrupt)
+            mp_sleep_us(time * 1000);
+        return stream_background_interrupt;
     }
     return stream_check_interrupt_cb(stream_check_interrupt_ctx, time);
 }
@@ -189,6 +189,9 @@ typedef struct stream {
 
     FILE *capture_file;
     char *capture_filename;
+
+    // Data read while detecting the file format, see stream_probe_start()
+    struct stream_probe *probe;
 } stream_t;
 
 #ifdef CONFIG_NETWORKING
@@ -325,6 +328,8 @@ struct bstr stream_read_complete(struct stream *s, void *talloc_ctx,
                                  int max_size, int padding_bytes);
 void stream_reset(stream_t *s);
 int stream_control(stream_t *s, int cmd, void *arg);
+void stream_probe_start(stream_t *s, int max_size);
+void stream_probe_stop(stream_t *s);
 void stream_update_size(stream_t *s);
 void free_stream(stream_t *s);
 stream_t *open_stream(const char *filename, struct MPOpts *options,
@@ -334,12 +339,26 @@ struct demux_stream;
 
 /// Set the callback to be used by libstream to check for user
 /// interruption during long blocking operations (cache filling, etc).
+/// wait_cb waits for a fd like stream_wait_fd() while checking for
+/// interruption.
 struct input_ctx;
 void stream_set_interrupt_callback(int (*cb)(struct input_ctx *, int),
+                                   int (*wait_cb)(struct input_ctx *, int,
+                                                  bool, int),
                                    struct input_ctx *ctx);
 /// Call the interrupt checking callback if there is one and
 /// wait for time milliseconds
 int stream_check_interrupt(int time);
+/// Make stream_check_interrupt() and stream_wait_fd() report interruption in
+/// all threads except the one that set the interrupt callback (used to abort
+/// opening files in the background).
+void stream_set_background_interrupt(bool interrupt);
+/// Return true if the calling thread is interrupted by the above.
+bool stream_background_interrupted(void);
+/// Wait until fd is readable (writable if for_write is set) for at most
+/// timeout milliseconds. Returns 1 if it is, 0 on timeout, -1 if the user
+/// interrupted the wait.
+int stream_wait_fd(int fd, bool for_write, int timeout);
 /// Internal read function bypassing the stream buffer
 int stream_read_internal(stream_t *s, void *buf, int len);
 /// Internal seek function bypassing the stream buffer
@@ -25,13 +25,39 @@
 #include <unistd.h>
 #include <errno.h>
 
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
+
+#include <libavutil/common.h>
+
 #include "osdep/io.h"
 
+#include "talloc.h"
 #include "core/mp_msg.h"
+#include "core/options.h"
 #include "stream.h"
 #include "core/m_option.h"
 #include "core/m_struct.h"
 
+// Reads start with this size, and double with each sequential read, up to
+// FILE_BUFFER_MAX. Seeking resets the size.
+#define FILE_BUFFER_MIN (64 * 1024)
+#define FILE_BUFFER_MAX (1024 * 1024)
+// Amount of data the kernel is asked to read ahead of the current position.
+#define FILE_READAHEAD (8 * 1024 * 1024)
+
+struct priv {
+  // Buffered data, corresponds to [s->pos - buf_pos, s->pos - buf_pos + buf_len)
+  char *buf;
+  int buf_size, buf_pos, buf_len;
+  // Position up to which readahead has been requested.
+  int64_t advised_pos;
+  // If non-NULL, the file is mapped and read from memory.
+  unsigned char *map;
+  int64_t map_size;
+};
+
 static struct stream_priv_s {
   char* filename;
   char *filename2;
@@ -53,7 +79,124 @@ static const struct m_struct_st stream_opts = {
   stream_opts_fields
 };
 
+static void advise_readahead(stream_t *s, int64_t pos) {
+  struct priv *p = s->priv;
+  if (s->type != STREAMTYPE_FILE || pos + FILE_READAHEAD / 2 < p->advised_pos)
+    return;
+#ifdef HAVE_SYS_MMAN_H
+  if (p->map) {
+    if (pos < p->map_size) {
+      int64_t page = sysconf(_SC_PAGESIZE);
+      int64_t start = pos / page * page;
+      madvise(p->map + start, FFMIN(FILE_READAHEAD, p->map_size - start),
+              MADV_WILLNEED);
+    }
+    p->advised_pos = pos + FILE_READAHEAD;
+    return;
+  }
+#endif
+#ifdef HAVE_POSIX_FADVISE
+  posix_fadvise(s->fd, pos, FILE_READAHEAD, POSIX_FADV_WILLNEED);
+#endif
+  p->advised_pos = pos + FILE_READAHEAD;
+}
+
+static void unmap_file(stream_t *s) {
+#ifdef HAVE_SYS_MMAN_H
+  struct priv *p = s->priv;
+  if (p->map)
+    munmap(p->map, p->map_size);
+  p->map = NULL;
+  p->map_size = 0;
+#endif
+}
+
+static bool map_file(stream_t *s) {
+#ifdef HAVE_SYS_MMAN_H
+  struct priv *p = s->priv;
+  struct stat st;
+  if (fstat(s->fd, &st) || !S_ISREG(st.st_mode) || st.st_size <= 0 ||
+      st.st_size != (size_t)st.st_size)
+    return false;
+  if (p->map && st.st_size == p->map_size)
+    return true;
+  unmap_file(s);
+  void *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, s->fd, 0);
+  if (map == MAP_FAILED) {
+    mp_msg(MSGT_STREAM, MSGL_V, "[file] mmap failed: %s\n", strerror(errno));
+    return false;
+  }
+  p->map = map;
+  p->map_size = st.st_size;
+  madvise(p->map, p->map_size, MADV_SEQUENTIAL);
+  return true;
+#else
+  return false;
+#endif
+}
+
+static int fill_mapped(stream_t *s, char *buffer, int max_len) {
+  struct priv *p = s->priv;
+  // The file might have grown since it was mapped.
+  if (s->pos >= p->map_size && !map_file(s)) {
+    // Continue with normal reads.
+    unmap_file(s);
+    if (lseek(s->fd, s->pos, SEEK_SET) < 0)
+      return -1;
+    return -2;
+  }
+  if (s->pos >= p->map_size) {
+    s->eof = 1;
+    return -1;
+  }
+  int len = FFMIN(max_len, p->map_size - s->pos);
+  memcpy(buffer, p->map + s->pos, len);
+  advise_readahead(s, s->pos + len);
+  return len;
+}
+
 static int fill_buffer(stream_t *s, char* buffer, int max_len){
+  struct priv *p = s->priv;
+  if (p->map) {
+    int r = fill_mapped(s, buffer, max_len);
+    if (r != -2)
+      return r;
+  }
+  if (p->buf_pos == p->buf_len) {
+    p->buf_pos = p->buf_len = 0;
+    char *dst = p->buf;
+    int size = p->buf_size;
+    // Large reads bypass the buffer.
+    if (max_len >= p->buf_size) {
+      dst = buffer;
+      size = max_len;
+    }
+    int r = read(s->fd, dst, size);
+    // We are certain this is EOF, do not retry
+    if (max_len && r == 0) s->eof = 1;
+    if (r <= 0)
+      return -1;
+    advise_readahead(s, s->pos + r);
+    if (dst == buffer)
+      return r;
+    p->buf_len = r;
+    // Sequential reading: use larger reads next time.
+    if (r == p->buf_size && p->buf_size < FILE_BUFFER_MAX) {
+      p->buf_size = FFMIN(p->buf_size * 2, FILE_BUFFER_MAX);
+      // Data is still needed, so don't use talloc_realloc().
+      char *buf = talloc_size(p, p->buf_size);
+      memcpy(buf, p->buf, r);
+      talloc_free(p->buf);
+      p->buf = buf;
+    }
+  }
+  int len = FFMIN(max_len, p->buf_len - p->buf_pos);
+  memcpy(buffer, p->buf + p->buf_pos, len);
+  p->buf_pos += len;
+  return len;
+}
+
+static int fill_buffer_unbuffered(stream_t *s, char* buffer, int max_len){
   int r = read(s->fd,buffer,max_len);
   // We are certain this is EOF, do not retry
   if (max_len && r == 0) s->eof = 1;
@@ -74,11 +217,35 @@ static int write_buffer(stream_t *s, char* buffer, int len) {
 }
 
 static int seek(stream_t *s,int64_t newpos) {
+  struct priv *p = s->priv;
+  if (p) {
+    // Seeking within the buffered data doesn't need any I/O.
+    int64_t buf_start = s->pos - p->buf_pos;
+    if (newpos >= buf_start && newpos < buf_start + p->buf_len) {
+      p->buf_pos = newpos - buf_start;
+      s->pos = newpos;
+      return 1;
+    }
+    p->buf_pos = p->buf_len = 0;
+    if (p->buf_size > FILE_BUFFER_MIN) {
+      talloc_free(p->buf);
+      p->buf_size = FILE_BUFFER_MIN;
+      p->buf = talloc_size(p, p->buf_size);
+    }
+    p->advised_pos = 0;
+    if (p->map) {
+      s->pos = newpos;
+      advise_readahead(s, newpos);
+      return 1;
+    }
+  }
   s->pos = newpos;
   if(lseek(s->fd,s->pos,SEEK_SET)<0) {
     s->eof=1;
     return 0;
   }
+  if (p)
+    advise_readahead(s, newpos);
   return 1;
 }
 
@@ -102,8 +269,10 @@ static int control(stream_t *s, int cmd, void *arg) {
     case STREAM_CTRL_GET_SIZE: {
       off_t size;
 
+      // Don't use s->pos; the fd is ahead of it when reading is buffered.
+      off_t cur = lseek(s->fd, 0, SEEK_CUR);
       size = lseek(s->fd, 0, SEEK_END);
-      lseek(s->fd, s->pos, SEEK_SET);
+      lseek(s->fd, cur, SEEK_SET);
       if(size != (off_t)-1) {
         *(uint64_t*)arg = size;
         return 1;
@@ -113,6 +282,11 @@ static int control(stream_t *s, int cmd, void *arg) {
   return STREAM_UNSUPPORTED;
 }
 
+static void close_f(stream_t *s) {
+  if (s->priv)
+    unmap_file(s);
+}
+
 static int open_f(stream_t *stream,int mode, void* opts, int* file_format) {
   int f;
   mode_t m = 0;
@@ -207,11 +381,28 @@ static int open_f(stream_t *stream,int mode, void* opts, int* file_format) {
   mp_msg(MSGT_OPEN,MSGL_V,"[file] File size is %"PRId64" bytes\n", (int64_t)len);
 
   stream->fd = f;
-  stream->fill_buffer = fill_buffer;
+  stream->fill_buffer = fill_buffer_unbuffered;
   stream->write_buffer = write_buffer;
   stream->control = control;
   stream->read_chunk = 64*1024;
 
+  if (mode == STREAM_READ) {
+    struct priv *priv = talloc_zero(stream, struct priv);
+    priv->buf_size = FILE_BUFFER_MIN;
+    priv->buf = talloc_size(priv, priv->buf_size);
+    stream->priv = priv;
+    stream->fill_buffer = fill_buffer;
+    stream->close = close_f;
+    if (stream->type == STREAMTYPE_FILE) {
+#ifdef HAVE_POSIX_FADVISE
+      posix_fadvise(f, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+      if (stream->opts && stream->opts->stream_file_mmap && map_file(stream))
+        mp_msg(MSGT_OPEN, MSGL_V, "[file] Using mmap\n");
+      advise_readahead(stream, 0);
+    }
+  }
+
   m_struct_free(&stream_opts,opts);
   return STREAM_OK;
 }
@@ -87,16 +87,8 @@ static const struct m_struct_st stream_opts = {
 
 // Check if there is something to read on a fd. This avoid hanging
 // forever if the network stop responding.
-static int fd_can_read(int fd,int timeout) {
-  fd_set fds;
-  struct timeval tv;
-
-  FD_ZERO(&fds);
-  FD_SET(fd,&fds);
-  tv.tv_sec = timeout;
-  tv.tv_usec = 0;
-
-  return select(fd+1, &fds, NULL, NULL, &tv) > 0;
+static int fd_can_read(int fd,float timeout) {
+  return stream_wait_fd(fd, false, timeout * 1000) > 0;
 }
 
 /*
@@ -170,7 +162,7 @@ static int readline(char *buf,int max,struct stream_priv_s *ctl)
 	break;
       }
 
-      if(!fd_can_read(ctl->handle, 15)) {
+      if(!fd_can_read(ctl->handle, network_timeout)) {
         mp_msg(MSGT_OPEN,MSGL_ERR, "[ftp] read timed out\n");
         retval = -1;
         break;
@@ -322,7 +314,7 @@ static int fill_buffer(stream_t *s, char* buffer, int max_len){
   if(s->fd < 0 && !FtpOpenData(s,s->pos))
     return -1;
 
-  if(!fd_can_read(s->fd, 15)) {
+  if(!fd_can_read(s->fd, network_timeout)) {
     mp_msg(MSGT_OPEN,MSGL_ERR, "[ftp] read timed out\n");
     return -1;
   }
@@ -114,6 +114,11 @@ static int control(stream_t *s, int cmd, void *arg)
 
 static const char * const prefix[] = { "lavf://", "ffmpeg://" };
 
+static int interrupt_cb(void *ctx)
+{
+    return stream_background_interrupted();
+}
+
 static int open_f(stream_t *stream, int mode, void *opts, int *file_format)
 {
     int flags = 0;
@@ -181,7 +186,10 @@ static int open_f(stream_t *stream, int mode, void *opts, int *file_format)
         av_dict_set(&dict, "headers", cust_headers, 0);
 #endif
 
-    int err = avio_open2(&avio, filename, flags, NULL, &dict);
+    AVIOInterruptCB cb = {
+        .callback = interrupt_cb,
+    };
+    int err = avio_open2(&avio, filename, flags, &cb, &dict);
     if (err < 0) {
         if (err == AVERROR_PROTOCOL_NOT_FOUND)
             mp_msg(MSGT_OPEN, MSGL_ERR, "[ffmpeg] Protocol not found. Make sure"
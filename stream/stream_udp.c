@@ -24,11 +24,114 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
 
+#include "core/mp_msg.h"
 #include "stream.h"
+#include "network.h"
 #include "url.h"
 #include "udp.h"
 
+// Datagrams are received in batches, so that a high-rate stream doesn't need
+// one syscall per datagram and the socket buffer is emptied quickly.
+#define UDP_BATCH 32
+#define UDP_SLOT_SIZE 8192
+
+struct udp_priv {
+  int num;      // number of datagrams in buf
+  int cur;      // datagram being read
+  int cur_pos;  // read position in it
+  int len[UDP_BATCH];
+  int truncated;
+  char buf[UDP_BATCH][UDP_SLOT_SIZE];
+};
+
+static int
+udp_receive (int fd, struct udp_priv *p)
+{
+  int res;
+
+  p->num = p->cur = p->cur_pos = 0;
+  for (;;)
+  {
+    res = stream_wait_fd (fd, false, network_timeout * 1000);
+    if (res <= 0)
+    {
+      if (res == 0)
+        mp_msg (MSGT_NETWORK, MSGL_ERR, "Timeout! No data from UDP stream\n");
+      return -1;
+    }
+#ifdef HAVE_RECVMMSG
+    struct mmsghdr msgs[UDP_BATCH];
+    struct iovec iov[UDP_BATCH];
+    memset (msgs, 0, sizeof (msgs));
+    for (int i = 0; i < UDP_BATCH; i++)
+    {
+      iov[i].iov_base = p->buf[i];
+      iov[i].iov_len = UDP_SLOT_SIZE;
+      msgs[i].msg_hdr.msg_iov = &iov[i];
+      msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+    res = recvmmsg (fd, msgs, UDP_BATCH, MSG_DONTWAIT, NULL);
+    for (int i = 0; i < res; i++)
+    {
+      p->len[i] = msgs[i].msg_len;
+      if (msgs[i].msg_hdr.msg_flags & MSG_TRUNC)
+        p->truncated++;
+    }
+#else
+    res = recv (fd, p->buf[0], UDP_SLOT_SIZE, 0);
+    if (res > 0)
+    {
+      p->len[0] = res;
+      res = 1;
+    }
+#endif
+    if (res > 0)
+      break;
+    if (res < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+    {
+      mp_msg (MSGT_NETWORK, MSGL_ERR, "UDP receive error: %s\n",
+              strerror (errno));
+      return -1;
+    }
+  }
+  if (p->truncated == 1)
+    mp_msg (MSGT_NETWORK, MSGL_WARN,
+            "UDP datagrams larger than %d bytes are truncated\n",
+            UDP_SLOT_SIZE);
+  p->num = res;
+  return 0;
+}
+
+static int
+udp_streaming_read (int fd, char *buffer, int size,
+                    streaming_ctrl_t *streaming_ctrl)
+{
+  struct udp_priv *p = streaming_ctrl->data;
+  int len = 0;
+
+  if (p->cur >= p->num && udp_receive (fd, p) < 0)
+    return 0;
+
+  // Return as much as is buffered, without waiting for more.
+  while (len < size && p->cur < p->num)
+  {
+    int copy = p->len[p->cur] - p->cur_pos;
+    if (copy > size - len)
+      copy = size - len;
+    memcpy (buffer + len, p->buf[p->cur] + p->cur_pos, copy);
+    len += copy;
+    p->cur_pos += copy;
+    if (p->cur_pos >= p->len[p->cur])
+    {
+      p->cur++;
+      p->cur_pos = 0;
+    }
+  }
+  return len;
+}
+
 static int
 udp_streaming_start (stream_t *stream)
 {
@@ -49,7 +152,13 @@ udp_streaming_start (stream_t *stream)
     stream->fd = fd;
   }
 
-  streaming_ctrl->streaming_read = nop_streaming_read;
+  if (!streaming_ctrl->data)
+  {
+    streaming_ctrl->data = calloc (1, sizeof (struct udp_priv));
+    if (!streaming_ctrl->data)
+      return -1;
+  }
+  streaming_ctrl->streaming_read = udp_streaming_read;
   streaming_ctrl->streaming_seek = nop_streaming_seek;
   streaming_ctrl->status = streaming_playing_e;
   stream->streaming = false;
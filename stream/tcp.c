@@ -77,9 +77,7 @@ connect2Server_with_af(char *host, int port, int af,int verb) {
 	int socket_server_fd;
 	int err;
         socklen_t err_len;
-	int ret,count = 0;
-	fd_set set;
-	struct timeval tv;
+	int ret;
 	union {
 		struct sockaddr_in four;
 #ifdef HAVE_AF_INET6
@@ -117,10 +115,10 @@ connect2Server_with_af(char *host, int port, int af,int verb) {
 #if defined(SO_RCVTIMEO) && defined(SO_SNDTIMEO)
 #if HAVE_WINSOCK2_H
 	/* timeout in milliseconds */
-	to = 10 * 1000;
+	to = network_timeout * 1000;
 #else
-	to.tv_sec = 10;
-	to.tv_usec = 0;
+	to.tv_sec = network_timeout;
+	to.tv_usec = (network_timeout - to.tv_sec) * 1000000;
 #endif
 	setsockopt(socket_server_fd, SOL_SOCKET, SO_RCVTIMEO, &to, sizeof(to));
 	setsockopt(socket_server_fd, SOL_SOCKET, SO_SNDTIMEO, &to, sizeof(to));
@@ -211,26 +209,16 @@ connect2Server_with_af(char *host, int port, int af,int verb) {
 			return TCP_ERROR_PORT;
 		}
 	}
-	tv.tv_sec = 0;
-	tv.tv_usec = 500000;
-	FD_ZERO( &set );
-	FD_SET( socket_server_fd, &set );
 	// When the connection will be made, we will have a writeable fd
-	while((ret = select(socket_server_fd+1, NULL, &set, NULL, &tv)) == 0) {
-	      if(count > 30 || stream_check_interrupt(500)) {
-		if(count > 30)
+	ret = stream_wait_fd(socket_server_fd, true, network_connect_timeout * 1000);
+	if (ret <= 0) {
+		if (ret == 0)
 		  mp_tmsg(MSGT_NETWORK,MSGL_ERR,"connection timeout\n");
 		else
 		  mp_msg(MSGT_NETWORK,MSGL_V,"Connection interrupted by user\n");
+		closesocket(socket_server_fd);
 		return TCP_ERROR_TIMEOUT;
-	      }
-	      count++;
-	      FD_ZERO( &set );
-	      FD_SET( socket_server_fd, &set );
-	      tv.tv_sec = 0;
-	      tv.tv_usec = 500000;
 	}
-	if (ret < 0) mp_tmsg(MSGT_NETWORK,MSGL_ERR,"Select failed.\n");
 
 	// Turn back the socket as blocking
 #if !HAVE_WINSOCK2_H
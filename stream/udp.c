@@ -55,10 +55,8 @@ udp_open_socket (URL_t *url)
   int socket_server_fd, rxsockbufsz;
   int err;
   socklen_t err_len;
-  fd_set set;
   struct sockaddr_in server_address;
   struct ip_mreq mcast;
-  struct timeval tv;
   struct hostent *hp;
   int reuse=reuse_socket;
 
@@ -142,8 +140,9 @@ udp_open_socket (URL_t *url)
   }
 #endif /* HAVE_WINSOCK2_H */
 
-  /* Increase the socket rx buffer size to maximum -- this is UDP */
-  rxsockbufsz = 240 * 1024;
+  /* Increase the socket rx buffer size to maximum -- this is UDP, and
+   * datagrams arriving while the player is busy are lost otherwise */
+  rxsockbufsz = 4 * 1024 * 1024;
   if (setsockopt (socket_server_fd, SOL_SOCKET, SO_RCVBUF,
                   &rxsockbufsz, sizeof (rxsockbufsz)))
   {
@@ -165,17 +164,10 @@ udp_open_socket (URL_t *url)
     }
   }
 
-  tv.tv_sec = 1; /* 1 second timeout */
-  tv.tv_usec = 0;
-
-  FD_ZERO (&set);
-  FD_SET (socket_server_fd, &set);
-
-  err = select (socket_server_fd + 1, &set, NULL, NULL, &tv);
+  err = stream_wait_fd (socket_server_fd, false, network_timeout * 1000);
   if (err < 0)
   {
-    mp_msg (MSGT_NETWORK, MSGL_FATAL,
-            "Select failed: %s\n", strerror (errno));
+    mp_msg (MSGT_NETWORK, MSGL_V, "Interrupted by user\n");
     closesocket (socket_server_fd);
     return -1;
   }
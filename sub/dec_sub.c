@@ -58,6 +58,10 @@ struct dec_sub {
 
     struct sd *sd[MAX_NUM_SD];
     int num_sd;
+
+    // Set if subtitles are read from an indexed subreader.c file
+    struct sub_data *sub_data;
+    int index_pos;          // next index entry to decode (-1 after reset)
 };
 
 struct dec_sub *sub_create(struct MPOpts *opts)
@@ -126,56 +130,68 @@ static void print_chain(struct dec_sub *sub)
     mp_msg(MSGT_OSD, MSGL_V, "\n");
 }
 
-// Subtitles read with subreader.c
-static void read_sub_data(struct dec_sub *sub, struct sub_data *subdata)
+// Pass one subtitle read with subreader.c to the decoder
+static void decode_sub_data_entry(struct dec_sub *sub, struct sub_data *subdata,
+                                  subtitle *st, char **temp)
 {
-    assert(sub_accept_packets_in_advance(sub));
-    char *temp = NULL;
+    // subdata is in 10 ms ticks, pts is in seconds
+    double t = subdata->sub_uses_time ? 0.01 : (1 / subdata->fallback_fps);
 
-    struct sd *sd = sub_get_last_sd(sub);
-
-    sd->no_remove_duplicates = true;
+    int len = 0;
+    for (int j = 0; j < st->lines; j++)
+        len += st->text[j] ? strlen(st->text[j]) : 0;
 
-    for (int i = 0; i < subdata->sub_num; i++) {
-        subtitle *st = &subdata->subtitles[i];
-        // subdata is in 10 ms ticks, pts is in seconds
-        double t = subdata->sub_uses_time ? 0.01 : (1 / subdata->fallback_fps);
+    len += 2 * st->lines;   // '\N', including the one after the last line
+    len += 6;               // {\anX}
+    len += 1;               // '\0'
 
-        int len = 0;
-        for (int j = 0; j < st->lines; j++)
-            len += st->text[j] ? strlen(st->text[j]) : 0;
+    if (talloc_get_size(*temp) < len) {
+        talloc_free(*temp);
+        *temp = talloc_array(NULL, char, len);
+    }
 
-        len += 2 * st->lines;   // '\N', including the one after the last line
-        len += 6;               // {\anX}
-        len += 1;               // '\0'
+    char *p = *temp;
+    char *end = p + len;
 
-        if (talloc_get_size(temp) < len) {
-            talloc_free(temp);
-            temp = talloc_array(NULL, char, len);
-        }
+    if (st->alignment)
+        p += snprintf(p, end - p, "{\\an%d}", st->alignment);
 
-        char *p = temp;
-        char *end = p + len;
+    for (int j = 0; j < st->lines; j++)
+        p += snprintf(p, end - p, "%s\\N", st->text[j]);
 
-        if (st->alignment)
-            p += snprintf(p, end - p, "{\\an%d}", st->alignment);
+    if (st->lines > 0)
+        p -= 2;             // remove last "\N"
+    *p = 0;
 
-        for (int j = 0; j < st->lines; j++)
-            p += snprintf(p, end - p, "%s\\N", st->text[j]);
+    struct demux_packet pkt = {0};
+    pkt.pts = st->start * t;
+    pkt.duration = (st->end - st->start) * t;
+    pkt.buffer = *temp;
+    pkt.len = strlen(*temp);
 
-        if (st->lines > 0)
-            p -= 2;             // remove last "\N"
-        *p = 0;
+    sub_decode(sub, &pkt);
+}
 
-        struct demux_packet pkt = {0};
-        pkt.pts = st->start * t;
-        pkt.duration = (st->end - st->start) * t;
-        pkt.buffer = temp;
-        pkt.len = strlen(temp);
+// Subtitles read with subreader.c
+static void read_sub_data(struct dec_sub *sub, struct sub_data *subdata)
+{
+    assert(sub_accept_packets_in_advance(sub));
+    char *temp = NULL;
 
-        sub_decode(sub, &pkt);
+    if (subdata->index) {
+        // Decoded incrementally by sub_update_index()
+        sub->sub_data = subdata;
+        sub->index_pos = -1;
+        return;
     }
 
+    struct sd *sd = sub_get_last_sd(sub);
+
+    sd->no_remove_duplicates = true;
+
+    for (int i = 0; i < subdata->sub_num; i++)
+        decode_sub_data_entry(sub, subdata, &subdata->subtitles[i], &temp);
+
     // Hack for broken FFmpeg packet format: make sd_ass keep the subtitle
     // events on reset(), even though broken FFmpeg ASS packets were received
     // (from sd_lavc_conv.c). Normally, these events are removed on seek/reset,
@@ -188,6 +204,41 @@ static void read_sub_data(struct dec_sub *sub, struct sub_data *subdata)
     talloc_free(temp);
 }
 
+// How far ahead of the playback position indexed subtitles are decoded.
+#define SUB_INDEX_PRELOAD 10.0
+
+// Decode the subtitles from an indexed subreader.c file that become visible
+// between pts and pts + SUB_INDEX_PRELOAD, and drop those that ended before
+// pts. No-op for other subtitles.
+void sub_update_index(struct dec_sub *sub, double pts)
+{
+    struct sub_data *subdata = sub->sub_data;
+    if (!subdata || pts == MP_NOPTS_VALUE)
+        return;
+
+    double t = subdata->sub_uses_time ? 0.01 : (1 / subdata->fallback_fps);
+    char *temp = NULL;
+
+    if (sub->index_pos < 0)
+        sub->index_pos = sub_index_find(subdata, pts);
+
+    while (sub->index_pos < subdata->sub_num) {
+        subtitle *st = sub_index_get(subdata, sub->index_pos);
+        if (st->start * t > pts + SUB_INDEX_PRELOAD)
+            break;
+        if (st->lines)
+            decode_sub_data_entry(sub, subdata, st, &temp);
+        sub->index_pos++;
+    }
+
+    // Only the subtitles around the playback position are kept decoded
+    struct sd *sd = sub_get_last_sd(sub);
+    if (sd && sd->driver->prune_events)
+        sd->driver->prune_events(sd, pts);
+
+    talloc_free(temp);
+}
+
 static int sub_init_decoder(struct dec_sub *sub, struct sd *sd)
 {
     sd->driver = NULL;
@@ -310,10 +361,15 @@ char *sub_get_text(struct dec_sub *sub, double pts)
 
 void sub_reset(struct dec_sub *sub)
 {
+    sub->index_pos = -1;
     for (int n = 0; n < sub->num_sd; n++) {
         if (sub->sd[n]->driver->reset)
             sub->sd[n]->driver->reset(sub->sd[n]);
     }
+    // Indexed subtitles are decoded again from the new position
+    struct sd *sd = sub_get_last_sd(sub);
+    if (sub->sub_data && sd && sd->driver->prune_events)
+        sd->driver->prune_events(sd, MP_NOPTS_VALUE);
 }
 
 #define MAX_PACKETS 10
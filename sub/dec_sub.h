@@ -29,6 +29,7 @@ bool sub_is_initialized(struct dec_sub *sub);
 
 bool sub_accept_packets_in_advance(struct dec_sub *sub);
 void sub_decode(struct dec_sub *sub, struct demux_packet *packet);
+void sub_update_index(struct dec_sub *sub, double pts);
 void sub_get_bitmaps(struct dec_sub *sub, struct mp_osd_res dim, double pts,
                      struct sub_bitmaps *res);
 bool sub_has_get_text(struct dec_sub *sub);
@@ -54,6 +54,9 @@ struct sd_functions {
     void (*uninit)(struct sd *sd);
 
     void (*fix_events)(struct sd *sd);
+    // Remove events that ended before pts (all events if pts is
+    // MP_NOPTS_VALUE). Used for subtitles that are decoded incrementally.
+    void (*prune_events)(struct sd *sd, double pts);
 
     // decoder
     void (*get_bitmaps)(struct sd *sd, struct mp_osd_res dim, double pts,
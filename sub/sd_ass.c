@@ -279,6 +279,28 @@ static void fix_events(struct sd *sd)
     ctx->flush_on_seek = false;
 }
 
+static void prune_events(struct sd *sd, double pts)
+{
+    struct sd_ass_priv *ctx = sd->priv;
+    ASS_Track *track = ctx->ass_track;
+    long long ipts = pts * 1000 + 0.5;
+    bool keep = false;
+    int n_kept = 0;
+    for (int i = 0; i < track->n_events; i++) {
+        ASS_Event *event = &track->events[i];
+        keep = pts != MP_NOPTS_VALUE && event->Start + event->Duration >= ipts;
+        if (keep) {
+            track->events[n_kept++] = *event;
+        } else {
+            ass_free_event(track, i);
+        }
+    }
+    track->n_events = n_kept;
+    // The incomplete event is always the last one
+    if (!keep)
+        ctx->incomplete_event = false;
+}
+
 static void reset(struct sd *sd)
 {
     struct sd_ass_priv *ctx = sd->priv;
@@ -308,6 +330,7 @@ const struct sd_functions sd_ass = {
     .get_bitmaps = get_bitmaps,
     .get_text = get_text,
     .fix_events = fix_events,
+    .prune_events = prune_events,
     .reset = reset,
     .uninit = uninit,
 };
@@ -24,6 +24,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <inttypes.h>
 #include <sys/types.h>
 #include <dirent.h>
 #include <ctype.h>
@@ -32,6 +33,7 @@
 #include "core/mp_msg.h"
 #include "subreader.h"
 #include "core/mp_common.h"
+#include "core/mp_talloc.h"
 #include "core/options.h"
 #include "stream/stream.h"
 #include "libavutil/common.h"
@@ -1220,6 +1222,213 @@ static const char* guess_cp(stream_t *st, const char *preferred_language, const
 #undef MAX_GUESS_BUFFER_SIZE
 #endif
 
+// Number of decoded subtitles cached by the indexed reader.
+#define SUB_INDEX_WINDOW 64
+// With --sub-index=auto, files at least this large are indexed.
+#define SUB_INDEX_AUTO_SIZE (16 * 1024 * 1024)
+
+struct sub_index_entry {
+    int64_t pos;            // file offset at which reading the subtitle starts
+    unsigned long start;
+    unsigned long end;
+};
+
+// Used instead of a fully loaded subtitle array for large files: only the
+// timing and file offset of each subtitle are kept, and the text is read and
+// recoded when it's needed.
+struct sub_index {
+    stream_t *fd;
+    const struct subreader *srp;
+    struct readline_args args;
+#ifdef CONFIG_ICONV
+    iconv_t icdsc;
+#endif
+
+    struct sub_index_entry *entries;
+    int num_entries;
+    unsigned long max_duration;
+
+    // Ring buffer with decoded subtitles for the entries starting at win_first
+    subtitle window[SUB_INDEX_WINDOW];
+    int win_first, win_num;
+};
+
+// Only formats whose readers keep no state between subtitles can be indexed,
+// because the reader is restarted at arbitrary subtitles.
+static bool sub_index_supported(int sub_format)
+{
+    switch (sub_format) {
+    case SUB_MICRODVD:
+    case SUB_SUBRIP:
+    case SUB_SUBVIEWER:
+    case SUB_SUBVIEWER2:
+    case SUB_VPLAYER:
+    case SUB_RT:
+    case SUB_SSA:
+    case SUB_MPL2:
+        return true;
+    }
+    return false;
+}
+
+static void free_subtitle_text(subtitle *sub)
+{
+    for (int i = 0; i < SUB_MAX_TEXT; i++) {
+        free(sub->text[i]);
+        sub->text[i] = NULL;
+    }
+    sub->lines = 0;
+}
+
+static int cmp_index_entry(const void *a, const void *b)
+{
+    const struct sub_index_entry *e1 = a, *e2 = b;
+    if (e1->start != e2->start)
+        return e1->start < e2->start ? -1 : 1;
+    return e1->pos < e2->pos ? -1 : (e1->pos > e2->pos);
+}
+
+// Read the whole file once, but keep only the timing and file position of
+// each subtitle. Returns NULL on errors.
+static struct sub_index *sub_build_index(stream_t *fd,
+                                         const struct subreader *srp,
+                                         struct readline_args *args)
+{
+    struct sub_index *idx = talloc_zero(NULL, struct sub_index);
+    subtitle sub = {0};
+
+    while (1) {
+        int64_t pos = stream_tell(fd);
+        subtitle *res = srp->read(fd, &sub, args);
+        if (!res)
+            break;
+        if (res == ERR) {
+            free_subtitle_text(&sub);
+            talloc_free(idx);
+            return NULL;
+        }
+        struct sub_index_entry e = { pos, sub.start, sub.end };
+        MP_TARRAY_APPEND(idx, idx->entries, idx->num_entries, e);
+        free_subtitle_text(&sub);
+        memset(&sub, 0, sizeof(sub));
+    }
+
+    qsort(idx->entries, idx->num_entries, sizeof(idx->entries[0]),
+          cmp_index_entry);
+    return idx;
+}
+
+// Same as adjust_subs_time(), but operating on the index entries.
+static void adjust_index_time(struct sub_index *idx, float subtime, float fps,
+                              float sub_fps, int block, int sub_uses_time)
+{
+    unsigned long subfms = (sub_uses_time ? 100 : fps) * subtime;
+    unsigned long overlap = (sub_uses_time ? 100 : fps) / 5; // 0.2s
+
+    for (int n = 0; n < idx->num_entries; n++) {
+        struct sub_index_entry *e = &idx->entries[n];
+        struct sub_index_entry *next =
+            n + 1 < idx->num_entries ? &idx->entries[n + 1] : NULL;
+        if (e->end <= e->start)
+            e->end = e->start + subfms;
+        if (block && next) {
+            if (e->end > next->start && e->end <= next->start + overlap) {
+                unsigned delta = e->end - next->start, half = delta / 2;
+                e->end -= half + 1;
+                next->start += delta - half;
+            }
+            if (e->end >= next->start) {
+                e->end = next->start - 1;
+                if (e->end - e->start > subfms)
+                    e->end = e->start + subfms;
+            }
+        }
+        if (sub_uses_time && sub_fps) {
+            e->start *= sub_fps / fps;
+            e->end   *= sub_fps / fps;
+        }
+        idx->max_duration = FFMAX(idx->max_duration, e->end - e->start);
+    }
+}
+
+static void sub_index_decode(struct sub_index *idx, int n, subtitle *dest)
+{
+    struct sub_index_entry *e = &idx->entries[n];
+
+    memset(dest, 0, sizeof(*dest));
+    if (stream_tell(idx->fd) != e->pos) {
+        stream_reset(idx->fd);
+        stream_seek(idx->fd, e->pos);
+    }
+    subtitle *sub = idx->srp->read(idx->fd, dest, &idx->args);
+    if (!sub || sub == ERR) {
+        mp_msg(MSGT_SUBREADER, MSGL_WARN, "SUB: Could not reread subtitle "
+               "at position %"PRId64".\n", e->pos);
+        free_subtitle_text(dest);
+        return;
+    }
+#ifdef CONFIG_ICONV
+    subcp_recode(idx->icdsc, dest);
+#endif
+    if (!idx->args.opts->sub_no_text_pp && idx->srp->post)
+        idx->srp->post(dest);
+    dest->start = e->start;
+    dest->end = e->end;
+}
+
+// Return the first index entry that might still be visible at pts (seconds).
+int sub_index_find(sub_data *subd, double pts)
+{
+    struct sub_index *idx = subd->index;
+    double t = subd->sub_uses_time ? 0.01 : (1 / subd->fallback_fps);
+    double target = pts / t - idx->max_duration;
+    int lo = 0, hi = idx->num_entries;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (idx->entries[mid].start < target)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+// Return the decoded subtitle for index entry n. The returned subtitle has
+// lines==0 if it couldn't be read. It's valid only until the next call.
+subtitle *sub_index_get(sub_data *subd, int n)
+{
+    struct sub_index *idx = subd->index;
+    if (n < 0 || n >= idx->num_entries)
+        return NULL;
+    if (n < idx->win_first || n > idx->win_first + idx->win_num) {
+        // Not contiguous with the cached window (e.g. after seeking)
+        for (int i = 0; i < idx->win_num; i++)
+            free_subtitle_text(&idx->window[(idx->win_first + i) % SUB_INDEX_WINDOW]);
+        idx->win_first = n;
+        idx->win_num = 0;
+    }
+    if (n == idx->win_first + idx->win_num) {
+        if (idx->win_num == SUB_INDEX_WINDOW) {
+            free_subtitle_text(&idx->window[idx->win_first % SUB_INDEX_WINDOW]);
+            idx->win_first++;
+            idx->win_num--;
+        }
+        sub_index_decode(idx, n, &idx->window[n % SUB_INDEX_WINDOW]);
+        idx->win_num++;
+    }
+    return &idx->window[n % SUB_INDEX_WINDOW];
+}
+
+static void sub_index_destroy(struct sub_index *idx)
+{
+    for (int i = 0; i < idx->win_num; i++)
+        free_subtitle_text(&idx->window[(idx->win_first + i) % SUB_INDEX_WINDOW]);
+    free_stream(idx->fd);
+#ifdef CONFIG_ICONV
+    subcp_close(idx->icdsc);
+#endif
+}
+
 static int sub_destroy(void *ptr);
 
 sub_data* sub_read_file(char *filename, float fps, struct MPOpts *opts)
@@ -1288,6 +1497,43 @@ sub_data* sub_read_file(char *filename, float fps, struct MPOpts *opts)
     }
 #endif
 
+    // see below for the overlap handling
+    int overlap = (opts->suboverlap_enabled == 2) ||
+        ((opts->suboverlap_enabled) && ((sub_format == SUB_JACOSUB) || (sub_format == SUB_SSA)));
+
+    if (sub_index_supported(sub_format) && (opts->sub_index == 2 ||
+        (opts->sub_index == 1 && fd->end_pos >= SUB_INDEX_AUTO_SIZE)))
+    {
+        struct sub_index *idx = sub_build_index(fd, srp, &args);
+        if (!idx || !idx->num_entries) {
+            talloc_free(idx);
+#ifdef CONFIG_ICONV
+            subcp_close(icdsc);
+#endif
+            free_stream(fd);
+            return NULL;
+        }
+        mp_msg(MSGT_SUBREADER, MSGL_V, "SUB: Indexed %i subtitles.\n",
+               idx->num_entries);
+        idx->fd = fd;
+        idx->srp = srp;
+        idx->args = args;
+#ifdef CONFIG_ICONV
+        idx->icdsc = icdsc;
+#endif
+        // Overlapping subtitles are not merged; sd_ass can display them.
+        adjust_index_time(idx, 6.0, fps, opts->sub_fps, !overlap, uses_time);
+        subt_data = talloc_zero(NULL, sub_data);
+        talloc_set_destructor(subt_data, sub_destroy);
+        subt_data->codec = srp->codec_name ? srp->codec_name : "text";
+        subt_data->filename = strdup(filename);
+        subt_data->sub_uses_time = uses_time;
+        subt_data->sub_num = idx->num_entries;
+        subt_data->fallback_fps = fps;
+        subt_data->index = talloc_steal(subt_data, idx);
+        return subt_data;
+    }
+
     sub_num=0;n_max=32;
     first=malloc(n_max*sizeof(subtitle));
     if (!first)
@@ -1382,8 +1628,7 @@ sub_data* sub_read_file(char *filename, float fps, struct MPOpts *opts)
     // the user didn't forced no-overlapsub and the format is Jacosub or Ssa.
     // this is because usually overlapping subtitles are found in these formats,
     // while in others they are probably result of bad timing
-if ((opts->suboverlap_enabled == 2) ||
-    ((opts->suboverlap_enabled) && ((sub_format == SUB_JACOSUB) || (sub_format == SUB_SSA)))) {
+if (overlap) {
     adjust_subs_time(first, 6.0, fps, opts->sub_fps, 0, sub_num, uses_time);/*~6 secs AST*/
 // here we manage overlapping subtitles
     sub_orig = sub_num;
@@ -1611,6 +1856,11 @@ static int sub_destroy(void *ptr)
 {
     sub_data *subd = ptr;
     int i, j;
+    if (subd->index) {
+        sub_index_destroy(subd->index);
+        free( subd->filename );
+        return 0;
+    }
     for (i = 0; i < subd->sub_num; i++)
         for (j = 0; j < subd->subtitles[i].lines; j++)
             free( subd->subtitles[i].text[j] );
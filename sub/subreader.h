@@ -63,6 +63,8 @@ typedef struct subtitle {
     unsigned char alignment;
 } subtitle;
 
+struct sub_index;
+
 typedef struct sub_data {
     const char *codec;
     subtitle *subtitles;
@@ -71,9 +73,15 @@ typedef struct sub_data {
     int sub_num;          // number of subtitle structs
     int sub_errs;
     double fallback_fps;
+    // If set, subtitles is NULL, and sub_num is the number of index entries.
+    // The subtitles are decoded on demand with sub_index_get().
+    struct sub_index *index;
 } sub_data;
 
 struct MPOpts;
 sub_data* sub_read_file (char *filename, float pts, struct MPOpts *opts);
 
+int sub_index_find(sub_data *subd, double pts);
+subtitle *sub_index_get(sub_data *subd, int n);
+
 #endif /* MPLAYER_SUBREADER_H */